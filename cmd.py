@@ -179,14 +179,16 @@ def build(key):
                     "-I", "./src",
                     "-DDEBUG_INSTRUCTION_CYCLE",
                     "./src/common/convert.c",
+                    "./src/common/log.c",
                     "./src/algorithm/hashtable.c",
                     "./src/algorithm/trie.c",
                     "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
                     "./src/hardware/cpu/isa.c",
                     "./src/hardware/cpu/mmu.c",
                     "./src/hardware/memory/dram.c",
                     "./src/tests/test_run_isa.c",
-                    "-o", "./bin/run_isa"
+                    "-lpthread", "-o", "./bin/run_isa"
                 ]
             ],
         "int" : [
@@ -196,22 +198,41 @@ def build(key):
                     "-I", "./src",
                     "-DDEBUG_INSTRUCTION_CYCLE",
                     # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
                     "-DUSE_NAVIE_VA2PA",
                     "./src/common/convert.c",
+                    "./src/common/log.c",
                     "./src/algorithm/hashtable.c",
                     "./src/algorithm/trie.c",
                     "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
                     "./src/hardware/cpu/isa.c",
                     "./src/hardware/cpu/mmu.c",
                     "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
                     # "./src/hardware/cpu/sram.c",
                     "./src/hardware/cpu/interrupt.c",
                     "./src/hardware/memory/dram.c",
                     # "./src/hardware/memory/swap.c",
                     "./src/process/syscall.c",
                     "./src/process/schedule.c",
+                    "./src/process/loader.c",
                     "./src/tests/test_run_isa.c",
-                    "-o", "./bin/run_isa"
+                    "-lpthread", "-o", "./bin/run_isa"
                 ]
             ],
         "ctx" : [
@@ -221,24 +242,92 @@ def build(key):
                     "-I", "./src",
                     "-DDEBUG_INSTRUCTION_CYCLE",
                     # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
                     # "-DUSE_NAVIE_VA2PA",
                     "-DUSE_PAGETABLE_VA2PA",
                     "./src/common/convert.c",
+                    "./src/common/log.c",
                     "./src/algorithm/hashtable.c",
                     "./src/algorithm/trie.c",
                     "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
                     "./src/hardware/cpu/isa.c",
                     "./src/hardware/cpu/mmu.c",
                     "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
                     # "./src/hardware/cpu/sram.c",
                     "./src/hardware/cpu/interrupt.c",
                     "./src/hardware/memory/dram.c",
                     "./src/hardware/memory/swap.c",
                     "./src/process/syscall.c",
                     "./src/process/schedule.c",
+                    "./src/process/loader.c",
                     "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
                     "./src/tests/test_context.c",
-                    "-o", "./bin/ctx"
+                    "-lpthread", "-o", "./bin/ctx"
+                ]
+            ],
+        "ckpt" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_checkpoint.c",
+                    "-lpthread", "-o", "./bin/ckpt"
                 ]
             ],
         "pgf" : [
@@ -248,26 +337,914 @@ def build(key):
                     "-I", "./src",
                     "-DDEBUG_INSTRUCTION_CYCLE",
                     # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
                     # "-DUSE_NAVIE_VA2PA",
                     "-DUSE_PAGETABLE_VA2PA",
                     "./src/common/convert.c",
+                    "./src/common/log.c",
                     "./src/algorithm/hashtable.c",
                     "./src/algorithm/trie.c",
                     "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
                     "./src/hardware/cpu/isa.c",
                     "./src/hardware/cpu/mmu.c",
                     "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
                     # "./src/hardware/cpu/sram.c",
                     "./src/hardware/cpu/interrupt.c",
                     "./src/hardware/memory/dram.c",
                     "./src/hardware/memory/swap.c",
                     "./src/process/syscall.c",
                     "./src/process/schedule.c",
+                    "./src/process/loader.c",
                     "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
                     "./src/tests/test_pagefault.c",
-                    "-o", "./bin/pgf"
+                    "-lpthread", "-o", "./bin/pgf"
+                ]
+            ],
+        "loader" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/test_loader.c",
+                    "-lpthread", "-o", "./bin/loader"
+                ]
+            ],
+        "machine" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_machine.c",
+                    "-lpthread", "-o", "./bin/machine"
+                ]
+            ],
+        "string" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_string.c",
+                    "-lpthread", "-o", "./bin/string"
+                ]
+            ],
+        "jit" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_BLOCK_CACHE",
+                    "-DUSE_JIT",
+                    "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_jit.c",
+                    "-lpthread", "-o", "./bin/jit"
+                ]
+            ],
+        "softmmu" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_softmmu.c",
+                    "-lpthread", "-o", "./bin/softmmu"
+                ]
+            ],
+        "tlb" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_tlb.c",
+                    "-lpthread", "-o", "./bin/tlb"
+                ]
+            ],
+        "tlb_hierarchy" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_PAGE_WALK_CACHE",
+                    "-DUSE_TLB_HIERARCHY",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_tlb.c",
+                    "-lpthread", "-o", "./bin/tlb_hierarchy"
+                ]
+            ],
+        "hugepage" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    # "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_hugepage.c",
+                    "-lpthread", "-o", "./bin/hugepage"
+                ]
+            ],
+        "smp" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_SMP",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/smp.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_smp.c",
+                    "-lpthread", "-o", "./bin/smp"
                 ]
             ],
+        "prof" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    # "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    # "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_profile.c",
+                    "-lpthread", "-o", "./bin/prof"
+                ]
+            ],
+        "trace" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_trace.c",
+                    "-lpthread", "-o", "./bin/trace"
+                ]
+            ],
+        "cycle" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    # "-DDEBUG_INSTRUCTION_CYCLE",
+                    "-DUSE_SRAM_CACHE",
+                    "-DUSE_DECODE_CACHE",
+                    # "-DUSE_BLOCK_CACHE",
+                    # "-DUSE_JIT",
+                    # "-DUSE_SOFTMMU",
+                    # "-DUSE_HUGE_PAGE",
+                    # "-DUSE_PAGE_WALK_CACHE",
+                    # "-DUSE_TLB_HIERARCHY",
+                    # "-DUSE_SWITCH_DISPATCH",
+                    # "-DUSE_PROFILER",
+                    # "-DUSE_TRACE",
+                    "-DUSE_CYCLE_MODEL",
+                    # "-DUSE_NAVIE_VA2PA",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/tests/test_cycle.c",
+                    "-lpthread", "-o", "./bin/cycle"
+                ]
+            ],
+        "replay" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_SRAM_CACHE",
+                    "-DUSE_TRACE",
+                    # "-DUSE_CYCLE_MODEL",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    # the geometry to compare
+                    # "-DTLB_CACHE_INDEX_LENGTH=4",
+                    # "-DNUM_TLB_CACHE_LINE_PER_SET=8",
+                    # "-DSRAM_CACHE_INDEX_LENGTH=6",
+                    # "-DNUM_CACHE_LINE_PER_SET=8",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/mains/trace_replay.c",
+                    "-lpthread", "-o", "./bin/replay"
+                ]
+            ],
+        "bench" : [
+                # optimized, one binary for each configuration to compare
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_NAVIE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_navie"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_pagetable"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_tlb"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_PAGE_WALK_CACHE",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_pwc"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_TLB_HARDWARE",
+                    "-DUSE_SRAM_CACHE",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_sram"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_SOFTMMU",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_softmmu"
+                ],
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-O2", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "-DUSE_DECODE_CACHE",
+                    "-DUSE_PAGETABLE_VA2PA",
+                    "-DUSE_BLOCK_CACHE",
+                    "-DUSE_JIT",
+                    "-DUSE_SOFTMMU",
+                    "./src/common/convert.c",
+                    "./src/common/log.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/isa.c",
+                    "./src/hardware/cpu/mmu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/hardware/cpu/profile.c",
+                    "./src/hardware/cpu/trace.c",
+                    "./src/hardware/cpu/cycle.c",
+                    "./src/hardware/cpu/jit.c",
+                    "./src/hardware/cpu/sram.c",
+                    "./src/hardware/cpu/interrupt.c",
+                    "./src/hardware/memory/dram.c",
+                    "./src/hardware/memory/swap.c",
+                    "./src/process/syscall.c",
+                    "./src/process/schedule.c",
+                    "./src/process/loader.c",
+                    "./src/process/pagefault.c",
+                    "./src/process/checkpoint.c",
+                    "./src/tests/fixture.c",
+                    "./src/mains/bench.c",
+                    "-lpthread", "-o", "./bin/bench_jit"
+                ],
+            ],
         "inst" : [
                 [
                     "/usr/bin/gcc-7", 
@@ -278,11 +1255,28 @@ def build(key):
                     "./src/algorithm/hashtable.c",
                     "./src/algorithm/trie.c",
                     "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
                     "./src/hardware/cpu/inst.c",
                     "./src/tests/test_inst.c",
                     "-o", "./bin/test_inst"
                 ],
             ],
+        "decode" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-function", "-Wno-unused-variable",
+                    "-I", "./src",
+                    "./src/common/convert.c",
+                    "./src/algorithm/hashtable.c",
+                    "./src/algorithm/trie.c",
+                    "./src/algorithm/array.c",
+                    "./src/hardware/cpu/cpu.c",
+                    "./src/hardware/cpu/inst.c",
+                    "./src/hardware/cpu/decode.c",
+                    "./src/tests/test_decode.c",
+                    "-o", "./bin/test_decode"
+                ],
+            ],
         "link" : [
                 [
                     "/usr/bin/gcc-7", 
@@ -419,6 +1413,16 @@ def build(key):
                     "-o", "./bin/convert"
                 ],
             ],
+        "log" : [
+                [
+                    "/usr/bin/gcc-7", 
+                    "-Wall", "-g", "-O0", "-Werror", "-std=gnu99", "-Wno-unused-but-set-variable", "-Wno-unused-variable", "-Wno-unused-function",
+                    "-I", "./src",
+                    "./src/common/log.c",
+                    "./src/tests/test_log.c",
+                    "-lpthread", "-o", "./bin/log"
+                ],
+            ],
     }
 
     if not key in gcc_map:
@@ -431,6 +1435,7 @@ def run(key):
     assert(os.path.isdir("./bin/"))
     bin_map = {
         "inst" : ["./bin/test_inst"],
+        "decode" : ["./bin/test_decode"],
         "isa" : ["./bin/run_isa"],
         "int" : ["./bin/run_isa"],
         "elf" : ["./bin/elf"],
@@ -442,8 +1447,23 @@ def run(key):
         "bst" : ["./bin/bst"],
         "malloc" : ["./bin/malloc"],
         "convert" : ["./bin/convert"],
+        "log" : ["./bin/log"],
         "ctx" : ["./bin/ctx"],
+        "ckpt" : ["./bin/ckpt"],
         "pgf" : ["./bin/pgf"],
+        "loader" : ["./bin/loader"],
+        "machine" : ["./bin/machine"],
+        "string" : ["./bin/string"],
+        "jit" : ["./bin/jit"],
+        "softmmu" : ["./bin/softmmu"],
+        "tlb" : ["./bin/tlb"],
+        "tlb_hierarchy" : ["./bin/tlb_hierarchy"],
+        "hugepage" : ["./bin/hugepage"],
+        "smp" : ["./bin/smp"],
+        "prof" : ["./bin/prof"],
+        "trace" : ["./bin/trace"],
+        "cycle" : ["./bin/cycle"],
+        "replay" : ["./bin/replay", "./bin/trace.bin"],
     }
     if not key in bin_map:
         print("input the correct binary key:", bin_map.keys())
@@ -461,9 +1481,25 @@ def debug(key):
         "bst" : [gdb, "./bin/bst"],
         "rbt" : [gdb, "./bin/rbt"],
         "trie" : [gdb, "./bin/trie"],
+        "log" : [gdb, "./bin/log"],
         "inst" : [gdb, "./bin/test_inst"],
+        "decode" : [gdb, "./bin/test_decode"],
         "ctx" : [gdb, "./bin/ctx"],
+        "ckpt" : [gdb, "./bin/ckpt"],
         "pgf" : [gdb, "./bin/pgf"],
+        "loader" : [gdb, "./bin/loader"],
+        "machine" : [gdb, "./bin/machine"],
+        "string" : [gdb, "./bin/string"],
+        "jit" : [gdb, "./bin/jit"],
+        "softmmu" : [gdb, "./bin/softmmu"],
+        "tlb" : [gdb, "./bin/tlb"],
+        "tlb_hierarchy" : [gdb, "./bin/tlb_hierarchy"],
+        "hugepage" : [gdb, "./bin/hugepage"],
+        "smp" : [gdb, "./bin/smp"],
+        "prof" : [gdb, "./bin/prof"],
+        "trace" : [gdb, "./bin/trace"],
+        "cycle" : [gdb, "./bin/cycle"],
+        "replay" : [gdb, "--args", "./bin/replay", "./bin/trace.bin"],
     }
     if not key in bin_map:
         print("input the correct binary key:", bin_map.keys())
@@ -519,6 +1555,37 @@ def cache_verify():
         print(" ".join(a))
         subprocess.run(a)
 
+def bench():
+    # the throughput of every configuration on the guest workloads,
+    # the results are appended to ./files/bench.csv to track regressions
+    build("bench")
+    configs = ["navie", "pagetable", "tlb", "pwc", "sram", "softmmu", "jit"]
+    workloads = sys.argv[2:]
+    commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"],
+        capture_output=True, text=True).stdout.strip()
+    date = subprocess.run(["date", "+%Y-%m-%d %H:%M:%S"],
+        capture_output=True, text=True).stdout.strip()
+    history = "./files/bench.csv"
+    new_history = not os.path.isfile(history)
+    with open(history, "a") as f:
+        if new_history:
+            f.write("date,commit,config,workload,instructions,seconds,mips\n")
+        for config in configs:
+            result = subprocess.run(["./bin/bench_" + config] + workloads,
+                capture_output=True, text=True)
+            # the page fault handler prints its own logs
+            for line in result.stdout.splitlines():
+                fields = line.split()
+                if len(fields) != 5 or not fields[2].isdigit():
+                    continue
+                print(line)
+                f.write(",".join([date, commit] + fields) + "\n")
+            if result.returncode != 0:
+                print("bench_" + config, "failed:", result.returncode)
+    # clean the swap pages written by the page fault workload
+    for page in Path("./files/swap/").glob("page-*"):
+        page.unlink()
+
 # main
 assert(len(sys.argv) >= 2)
 operation = sys.argv[1].lower()
@@ -545,3 +1612,5 @@ elif operation == "format":
     format_code()
 elif operation == "csim":
     cache_verify()
+elif operation == "bench":
+    bench()
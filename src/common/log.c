@@ -0,0 +1,190 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "headers/log.h"
+
+/*======================================*/
+/*      logging into ring buffer        */
+/*======================================*/
+
+// The ring is a bounded lock-free queue: any thread (core or machine)
+// can log, one thread flushes at a time.
+//
+// The producer reserves the slot at log_head by CAS, when the slot is
+// free for this turn. Then it fills the slot and publishes it by writing
+// the sequence. The consumer prints the slots in order till an
+// unpublished one, and frees each slot for the next turn of the ring.
+// The producer filling the ring to the high-water mark flushes it, so
+// the ring is drained without the flusher thread. When the ring is still
+// full, e.g. flushed by a slow thread, the record is dropped instead of
+// waiting.
+
+#define LOG_RING_LENGTH (12)
+#define LOG_RING_SIZE (1 << LOG_RING_LENGTH)
+#define LOG_RING_HIGH_WATER (LOG_RING_SIZE / 4 * 3)
+
+typedef struct
+{
+    // the sequence minus the index of slot, so the zeroed ring is empty:
+    //  turn == pos - index:        free for the producer of pos
+    //  turn == pos - index + 1:    published for the consumer of pos
+    uint64_t    turn;
+    log_level_t level;
+    const char  *format;
+    uint64_t    args[LOG_MAX_ARGS];
+} log_slot_t;
+
+log_level_t log_level = LOG_INFO;
+uint64_t log_mask = LOG_ALL;
+
+static log_slot_t log_ring[LOG_RING_SIZE];
+static uint64_t log_head = 0;
+static uint64_t log_tail = 0;
+static uint64_t log_dropped = 0;
+
+// only one thread flushes
+static int log_flushing = 0;
+static int log_registered = 0;
+
+static pthread_t flusher;
+static int flusher_running = 0;
+
+void log_record(log_level_t level, const char *format, uint64_t *args, int num_args)
+{
+    assert(num_args <= LOG_MAX_ARGS);
+
+    if (log_registered == 0 && __sync_bool_compare_and_swap(&log_registered, 0, 1))
+    {
+        // the records left are printed at exit
+        atexit(&log_flush);
+    }
+
+    uint64_t pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+    log_slot_t *slot;
+    while (1)
+    {
+        uint64_t index = pos & (LOG_RING_SIZE - 1);
+        slot = &log_ring[index];
+        uint64_t sequence = __atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) + index;
+
+        if (sequence == pos)
+        {
+            // free: try to reserve it, or pos is updated to the latest head
+            if (__atomic_compare_exchange_n(&log_head, &pos, pos + 1, 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (sequence < pos)
+        {
+            // not consumed in the last turn: full
+            __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        {
+            // reserved by another producer
+            pos = __atomic_load_n(&log_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->level = level;
+    slot->format = format;
+    for (int i = 0; i < num_args; ++ i)
+    {
+        slot->args[i] = args[i];
+    }
+    __atomic_store_n(&slot->turn, pos - (pos & (LOG_RING_SIZE - 1)) + 1, __ATOMIC_RELEASE);
+
+    // the records not flushed yet, log_tail may pass pos when flushed meanwhile
+    int64_t pending = pos + 1 - __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE);
+    if (pending >= LOG_RING_HIGH_WATER)
+    {
+        log_flush();
+    }
+}
+
+void log_flush()
+{
+    if (__sync_lock_test_and_set(&log_flushing, 1) == 1)
+    {
+        // flushed by another thread now
+        return;
+    }
+
+    while (1)
+    {
+        uint64_t index = log_tail & (LOG_RING_SIZE - 1);
+        log_slot_t *slot = &log_ring[index];
+        if (__atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) + index != log_tail + 1)
+        {
+            // not published yet
+            break;
+        }
+
+        // the arguments not used by the format are ignored by printf
+        printf(slot->format, slot->args[0], slot->args[1], slot->args[2], slot->args[3]);
+
+        // free the slot for the next turn
+        __atomic_store_n(&slot->turn, log_tail + LOG_RING_SIZE - index, __ATOMIC_RELEASE);
+        __atomic_store_n(&log_tail, log_tail + 1, __ATOMIC_RELEASE);
+    }
+
+    uint64_t dropped = __atomic_exchange_n(&log_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped > 0)
+    {
+        printf("[log] %lu records dropped: the ring is full\n", dropped);
+    }
+    fflush(stdout);
+
+    __sync_lock_release(&log_flushing);
+}
+
+static void *flusher_thread(void *period)
+{
+    while (__atomic_load_n(&flusher_running, __ATOMIC_ACQUIRE) == 1)
+    {
+        log_flush();
+        usleep((uint64_t)period);
+    }
+    log_flush();
+    return NULL;
+}
+
+int log_start_flusher(uint64_t period_us)
+{
+    assert(flusher_running == 0);
+    flusher_running = 1;
+    int error = pthread_create(&flusher, NULL, &flusher_thread, (void *)period_us);
+    if (error != 0)
+    {
+        // the ring is still flushed on demand and at exit
+        flusher_running = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void log_stop_flusher()
+{
+    if (flusher_running == 0)
+    {
+        return;
+    }
+    __atomic_store_n(&flusher_running, 0, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+}
@@ -0,0 +1,24 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdint.h>
+#include "headers/cpu.h"
+
+// the registers of the CPU declared in cpu.h
+// each host thread has its own copy, i.e., its own core
+
+CORE_LOCAL cpu_reg_t cpu_reg;
+CORE_LOCAL cpu_flags_t cpu_flags;
+CORE_LOCAL cpu_pc_t cpu_pc;
+CORE_LOCAL tss_s0_t tr_global_tss;
+CORE_LOCAL cpu_cr_t cpu_controls;
+CORE_LOCAL inst_encoding_t cpu_inst_encoding;
+CORE_LOCAL uint64_t mmu_vaddr_pagefault;
+CORE_LOCAL uint64_t mmu_generation = 0;
@@ -0,0 +1,115 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/common.h"
+#include "headers/cycle.h"
+
+#ifdef USE_CYCLE_MODEL
+/*======================================*/
+/*      simulated cycle cost model      */
+/*======================================*/
+
+// The instructions are executed functionally, the time is estimated by
+// adding the latency of each hardware event to the cycle count:
+//
+//  cycles = instructions * CPI_base + sum(event count * event latency)
+//
+// As the average memory access time, each access through the cache costs
+// the hit time CYCLE_CACHE_HIT, and each missing line adds the penalty:
+// CYCLE_CACHE_MISS, CYCLE_BUS_READ for the line transfer, and
+// CYCLE_CACHE_EVICTION if the victim is dirty.
+// A translation costs CYCLE_TLB_HIT, or CYCLE_TLB_MISS plus one
+// CYCLE_PAGE_WALK for each level of page table read. With the TLB
+// hierarchy, the L1 miss hit by STLB adds CYCLE_STLB_HIT.
+//
+// The default latencies are of a desktop CPU around 3GHz.
+
+MACHINE_LOCAL uint64_t cycle_latency[NUM_CYCLE_EVENT] = {
+    [CYCLE_INSTRUCTION]     = 1,
+    [CYCLE_DRAM_ACCESS]     = 100,
+    [CYCLE_CACHE_HIT]       = 4,
+    [CYCLE_CACHE_MISS]      = 4,
+    [CYCLE_CACHE_EVICTION]  = 100,
+    [CYCLE_BUS_READ]        = 100,
+    [CYCLE_TLB_HIT]         = 1,
+    [CYCLE_TLB_MISS]        = 2,
+    [CYCLE_STLB_HIT]        = 7,
+    [CYCLE_PAGE_WALK]       = 25,
+    [CYCLE_SWAP_IN]         = 30000000,
+    [CYCLE_SWAP_OUT]        = 30000000,
+};
+
+static const char *cycle_event_name[NUM_CYCLE_EVENT] = {
+    [CYCLE_INSTRUCTION]     = "instruction",
+    [CYCLE_DRAM_ACCESS]     = "dram access",
+    [CYCLE_CACHE_HIT]       = "cache hit",
+    [CYCLE_CACHE_MISS]      = "cache miss",
+    [CYCLE_CACHE_EVICTION]  = "cache eviction",
+    [CYCLE_BUS_READ]        = "bus read",
+    [CYCLE_TLB_HIT]         = "tlb hit",
+    [CYCLE_TLB_MISS]        = "tlb miss",
+    [CYCLE_STLB_HIT]        = "stlb hit",
+    [CYCLE_PAGE_WALK]       = "page walk",
+    [CYCLE_SWAP_IN]         = "swap in",
+    [CYCLE_SWAP_OUT]        = "swap out",
+};
+
+// the total of this core, and the total at the last accounting
+static CORE_LOCAL cycle_stat_t core_stat;
+static CORE_LOCAL cycle_stat_t accounted_stat;
+
+void cycle_charge(cycle_event_t event)
+{
+    uint64_t latency = cycle_latency[event];
+    core_stat.cycles += latency;
+    core_stat.count[event] += 1;
+    core_stat.event_cycles[event] += latency;
+}
+
+void cycle_read_stat(cycle_stat_t *stat)
+{
+    memcpy(stat, &core_stat, sizeof(cycle_stat_t));
+}
+
+void cycle_account(cycle_stat_t *stat)
+{
+    stat->cycles += core_stat.cycles - accounted_stat.cycles;
+    for (int i = 0; i < NUM_CYCLE_EVENT; ++ i)
+    {
+        stat->count[i] += core_stat.count[i] - accounted_stat.count[i];
+        stat->event_cycles[i] += core_stat.event_cycles[i] - accounted_stat.event_cycles[i];
+    }
+    memcpy(&accounted_stat, &core_stat, sizeof(cycle_stat_t));
+}
+
+void cycle_report(FILE *stream, cycle_stat_t *stat)
+{
+    uint64_t instructions = stat->count[CYCLE_INSTRUCTION];
+    double cpi = instructions == 0 ? 0.0 : (double)stat->cycles / instructions;
+
+    fprintf(stream, "cycles %lu    instructions %lu    CPI %.3f\n",
+        stat->cycles, instructions, cpi);
+    for (int i = 0; i < NUM_CYCLE_EVENT; ++ i)
+    {
+        if (stat->count[i] == 0)
+        {
+            continue;
+        }
+        fprintf(stream, "    %-16s count %-10lu cycles %-12lu CPI %.3f\n",
+            cycle_event_name[i], stat->count[i], stat->event_cycles[i],
+            instructions == 0 ? 0.0 : (double)stat->event_cycles[i] / instructions);
+    }
+}
+#endif
@@ -0,0 +1,451 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/common.h"
+#include "headers/instruction.h"
+
+/*======================================*/
+/*      x86-64 machine code decoder     */
+/*======================================*/
+
+// The decoder of the binary x86-64 instructions, the counterpart of the
+// assembly parser in inst.c. It produces the same inst_t, so the decoded
+// instructions are executed by the same handlers.
+//
+// Only the subset implemented in isa.c is supported, with 64-bit operand
+// size (REX.W) except `mov $imm32,%r32`, which zero-extends to 64 bits:
+//
+//  +---------------+---------------------------+-----------------------+
+//  | opcode        | instruction               | handler               |
+//  +---------------+---------------------------+-----------------------+
+//  | 89 /r         | mov  r64, r/m64           | MOV_REG_REG/REG_MEM   |
+//  | 8b /r         | mov  r/m64, r64           | MOV_REG_REG/MEM_REG   |
+//  | c7 /0 id      | mov  imm32, r64           | MOV_IMM_REG           |
+//  | b8+r id/io    | mov  imm32/imm64, r       | MOV_IMM_REG           |
+//  | 50+r          | push r64                  | PUSH_REG              |
+//  | 58+r          | pop  r64                  | POP_REG               |
+//  | c9            | leave                     | LEAVE                 |
+//  | e8 cd         | call rel32                | CALL                  |
+//  | c3            | ret                       | RET                   |
+//  | 01 /r         | add  r64, r64             | ADD_REG_REG           |
+//  | 83 /5 ib      | sub  imm8, r64            | SUB_IMM_REG           |
+//  | 81 /5 id      | sub  imm32, r64           | SUB_IMM_REG           |
+//  | 83 /7 ib      | cmp  imm8, m64            | CMP_IMM_MEM           |
+//  | 81 /7 id      | cmp  imm32, m64           | CMP_IMM_MEM           |
+//  | 75 cb         | jne  rel8                 | JNE                   |
+//  | 0f 85 cd      | jne  rel32                | JNE                   |
+//  | eb cb         | jmp  rel8                 | JMP                   |
+//  | e9 cd         | jmp  rel32                | JMP                   |
+//  | 8d /r         | lea  m, r64               | LEA_MEM_REG           |
+//  | cd ib         | int  imm8                 | INT_IMM               |
+//  | f3 a4         | rep movsb                 | REP_MOVSB             |
+//  | f3 a5         | rep movsq                 | REP_MOVSQ             |
+//  | f3 aa         | rep stosb                 | REP_STOSB             |
+//  | f3 ab         | rep stosq                 | REP_STOSQ             |
+//  +---------------+---------------------------+-----------------------+
+//
+// The relative targets of call and jumps, and the rip-relative memory
+// operands, are resolved to absolute addresses in decoding by the virtual
+// address of the instruction, as the text ISA uses absolute addresses.
+
+// the longest x86-64 instruction
+#define MAX_INSTRUCTION_BYTE (15)
+
+// legacy prefix: repeat the string operation %rcx times
+#define PREFIX_REP (0xf3)
+
+// REX prefix: 0100WRXB
+#define REX_W (0x8)
+#define REX_R (0x4)
+#define REX_X (0x2)
+#define REX_B (0x1)
+
+typedef struct
+{
+    uint8_t *code;      // the machine code of the instruction
+    uint64_t length;    // the number of bytes consumed
+    uint64_t size;      // the number of bytes fetched in code
+    uint64_t vaddr;     // the virtual address of code[0]
+    // fetch the bytes in the next page when the instruction crosses it
+    void (*read_next_page)(uint64_t vaddr, uint8_t *buf, uint64_t size);
+    int rep;            // 1 if there is the REP prefix
+    uint8_t rex;        // 0 if there is no REX prefix
+    int rip_relative;   // the memory operand is rip-relative
+} decoder_t;
+
+// register number in ModRM, SIB and opcode to register address
+static uint64_t register_address(int number)
+{
+    switch (number)
+    {
+        case 0: return (uint64_t)&(cpu_reg.rax);
+        case 1: return (uint64_t)&(cpu_reg.rcx);
+        case 2: return (uint64_t)&(cpu_reg.rdx);
+        case 3: return (uint64_t)&(cpu_reg.rbx);
+        case 4: return (uint64_t)&(cpu_reg.rsp);
+        case 5: return (uint64_t)&(cpu_reg.rbp);
+        case 6: return (uint64_t)&(cpu_reg.rsi);
+        case 7: return (uint64_t)&(cpu_reg.rdi);
+        case 8: return (uint64_t)&(cpu_reg.r8);
+        case 9: return (uint64_t)&(cpu_reg.r9);
+        case 10: return (uint64_t)&(cpu_reg.r10);
+        case 11: return (uint64_t)&(cpu_reg.r11);
+        case 12: return (uint64_t)&(cpu_reg.r12);
+        case 13: return (uint64_t)&(cpu_reg.r13);
+        case 14: return (uint64_t)&(cpu_reg.r14);
+        case 15: return (uint64_t)&(cpu_reg.r15);
+        default: assert(0);
+    }
+}
+
+static uint8_t next_byte(decoder_t *d)
+{
+    assert(d->length < MAX_INSTRUCTION_BYTE);
+    if (d->length == d->size)
+    {
+        // only the instruction crossing the page boundary
+        // translates and reads the next page
+        assert(d->read_next_page != NULL);
+        d->read_next_page(d->vaddr + d->size, &d->code[d->size], MAX_INSTRUCTION_BYTE - d->size);
+        d->size = MAX_INSTRUCTION_BYTE;
+    }
+    uint8_t b = d->code[d->length];
+    d->length += 1;
+    return b;
+}
+
+// little-endian immediate number or displacement, sign-extended to 64 bits
+static uint64_t next_signed(decoder_t *d, int size)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++ i)
+    {
+        value |= (uint64_t)next_byte(d) << (i * 8);
+    }
+
+    if (size < 8 && ((value >> (size * 8 - 1)) & 0x1) == 1)
+    {
+        value |= ~(uint64_t)0 << (size * 8);
+    }
+    return value;
+}
+
+static void set_register_operand(od_t *od, int number)
+{
+    od->type = OD_REG;
+    od->value = register_address(number);
+}
+
+static void set_immediate_operand(od_t *od, uint64_t imm)
+{
+    od->type = OD_IMM;
+    od->value = imm;
+}
+
+// the target of call and jumps, as `callq 0x400000` in assembly,
+// the relative displacement is resolved to the address at last
+static void set_target_operand(od_t *od, uint64_t rel)
+{
+    od->type = OD_MEM;
+    od->value = rel;
+}
+
+// decode ModRM (and SIB, displacement) to the r/m operand
+// return the reg field of ModRM, extended by REX.R
+static int decode_modrm(decoder_t *d, od_t *rm)
+{
+    uint8_t modrm = next_byte(d);
+    int mod = (modrm >> 6) & 0x3;
+    int reg = ((modrm >> 3) & 0x7) | ((d->rex & REX_R) ? 8 : 0);
+    int base = modrm & 0x7;
+
+    if (mod == 3)
+    {
+        // register operand
+        set_register_operand(rm, base | ((d->rex & REX_B) ? 8 : 0));
+        return reg;
+    }
+
+    // memory operand: disp(base, index, scale)
+    rm->type = OD_MEM;
+    rm->value = 0;
+    rm->reg1 = 0;
+    rm->reg2 = 0;
+    rm->scal = 0;
+
+    if (base == 4)
+    {
+        // SIB follows
+        uint8_t sib = next_byte(d);
+        int index = ((sib >> 3) & 0x7) | ((d->rex & REX_X) ? 8 : 0);
+        base = sib & 0x7;
+
+        // index 4 (%rsp) means no index
+        if (index != 4)
+        {
+            rm->reg2 = register_address(index);
+            rm->scal = 1 << ((sib >> 6) & 0x3);
+        }
+
+        if (base == 5 && mod == 0)
+        {
+            // no base, disp32
+            rm->value = next_signed(d, 4);
+            return reg;
+        }
+    }
+    else if (base == 5 && mod == 0)
+    {
+        // rip-relative: disp32(%rip)
+        // resolved when the length of the instruction is known
+        rm->value = next_signed(d, 4);
+        d->rip_relative = 1;
+        return reg;
+    }
+
+    rm->reg1 = register_address(base | ((d->rex & REX_B) ? 8 : 0));
+
+    if (mod == 1)
+    {
+        rm->value = next_signed(d, 1);
+    }
+    else if (mod == 2)
+    {
+        rm->value = next_signed(d, 4);
+    }
+    return reg;
+}
+
+// decode the instruction at `code`, which is at virtual address `vaddr`
+// `size` bytes are fetched in code, which should hold MAX_INSTRUCTION_BYTE
+// return the length of the instruction in bytes
+uint64_t decode_instruction(uint8_t *code, uint64_t size, uint64_t vaddr, inst_t *inst,
+    void (*read_next_page)(uint64_t vaddr, uint8_t *buf, uint64_t size))
+{
+    decoder_t decoder =
+    {
+        .code = code,
+        .size = size < MAX_INSTRUCTION_BYTE ? size : MAX_INSTRUCTION_BYTE,
+        .vaddr = vaddr,
+        .read_next_page = read_next_page,
+    };
+    decoder_t *d = &decoder;
+    memset(inst, 0, sizeof(inst_t));
+
+    uint8_t opcode = next_byte(d);
+    if (opcode == PREFIX_REP)
+    {
+        // the legacy prefix is before REX
+        d->rep = 1;
+        opcode = next_byte(d);
+    }
+    if ((opcode & 0xf0) == 0x40)
+    {
+        // REX prefix
+        d->rex = opcode;
+        opcode = next_byte(d);
+    }
+
+    int digit = 0;
+    switch (opcode)
+    {
+        case 0x89:
+            // mov r64, r/m64
+            assert(d->rex & REX_W);
+            inst->opcode = INST_MOV;
+            set_register_operand(&inst->src, decode_modrm(d, &inst->dst));
+            inst->handler = inst->dst.type == OD_REG ? HANDLER_MOV_REG_REG : HANDLER_MOV_REG_MEM;
+            break;
+        case 0x8b:
+            // mov r/m64, r64
+            assert(d->rex & REX_W);
+            inst->opcode = INST_MOV;
+            set_register_operand(&inst->dst, decode_modrm(d, &inst->src));
+            inst->handler = inst->src.type == OD_REG ? HANDLER_MOV_REG_REG : HANDLER_MOV_MEM_REG;
+            break;
+        case 0xc7:
+            // mov imm32, r64: sign-extended immediate
+            assert(d->rex & REX_W);
+            inst->opcode = INST_MOV;
+            digit = decode_modrm(d, &inst->dst) & 0x7;
+            assert(digit == 0 && inst->dst.type == OD_REG);
+            set_immediate_operand(&inst->src, next_signed(d, 4));
+            inst->handler = HANDLER_MOV_IMM_REG;
+            break;
+        case 0xb8: case 0xb9: case 0xba: case 0xbb:
+        case 0xbc: case 0xbd: case 0xbe: case 0xbf:
+            // mov imm64, r64 with REX.W
+            // mov imm32, r32 without REX.W, which zero-extends to r64
+            inst->opcode = INST_MOV;
+            set_register_operand(&inst->dst, (opcode & 0x7) | ((d->rex & REX_B) ? 8 : 0));
+            if (d->rex & REX_W)
+            {
+                set_immediate_operand(&inst->src, next_signed(d, 8));
+            }
+            else
+            {
+                set_immediate_operand(&inst->src, next_signed(d, 4) & 0xffffffff);
+            }
+            inst->handler = HANDLER_MOV_IMM_REG;
+            break;
+        case 0x50: case 0x51: case 0x52: case 0x53:
+        case 0x54: case 0x55: case 0x56: case 0x57:
+            // push r64
+            inst->opcode = INST_PUSH;
+            set_register_operand(&inst->src, (opcode & 0x7) | ((d->rex & REX_B) ? 8 : 0));
+            inst->handler = HANDLER_PUSH_REG;
+            break;
+        case 0x58: case 0x59: case 0x5a: case 0x5b:
+        case 0x5c: case 0x5d: case 0x5e: case 0x5f:
+            // pop r64
+            inst->opcode = INST_POP;
+            set_register_operand(&inst->src, (opcode & 0x7) | ((d->rex & REX_B) ? 8 : 0));
+            inst->handler = HANDLER_POP_REG;
+            break;
+        case 0xc9:
+            inst->opcode = INST_LEAVE;
+            inst->handler = HANDLER_LEAVE;
+            break;
+        case 0xc3:
+            inst->opcode = INST_RET;
+            inst->handler = HANDLER_RET;
+            break;
+        case 0xe8:
+            // call rel32
+            inst->opcode = INST_CALL;
+            set_target_operand(&inst->src, next_signed(d, 4));
+            inst->handler = HANDLER_CALL;
+            break;
+        case 0x01:
+            // add r64, r64
+            assert(d->rex & REX_W);
+            inst->opcode = INST_ADD;
+            set_register_operand(&inst->src, decode_modrm(d, &inst->dst));
+            assert(inst->dst.type == OD_REG);
+            inst->handler = HANDLER_ADD_REG_REG;
+            break;
+        case 0x81:
+        case 0x83:
+            // group 1 with immediate: /5 sub, /7 cmp
+            assert(d->rex & REX_W);
+            digit = decode_modrm(d, &inst->dst) & 0x7;
+            set_immediate_operand(&inst->src, next_signed(d, opcode == 0x83 ? 1 : 4));
+            if (digit == 5 && inst->dst.type == OD_REG)
+            {
+                inst->opcode = INST_SUB;
+                inst->handler = HANDLER_SUB_IMM_REG;
+            }
+            else if (digit == 7 && inst->dst.type == OD_MEM)
+            {
+                inst->opcode = INST_CMP;
+                inst->handler = HANDLER_CMP_IMM_MEM;
+            }
+            break;
+        case 0x75:
+            // jne rel8
+            inst->opcode = INST_JNE;
+            set_target_operand(&inst->src, next_signed(d, 1));
+            inst->handler = HANDLER_JNE;
+            break;
+        case 0x0f:
+            // jne rel32: the second opcode byte
+            opcode = next_byte(d);
+            assert(opcode == 0x85);
+            inst->opcode = INST_JNE;
+            set_target_operand(&inst->src, next_signed(d, 4));
+            inst->handler = HANDLER_JNE;
+            break;
+        case 0xeb:
+            // jmp rel8
+            inst->opcode = INST_JMP;
+            set_target_operand(&inst->src, next_signed(d, 1));
+            inst->handler = HANDLER_JMP;
+            break;
+        case 0xe9:
+            // jmp rel32
+            inst->opcode = INST_JMP;
+            set_target_operand(&inst->src, next_signed(d, 4));
+            inst->handler = HANDLER_JMP;
+            break;
+        case 0x8d:
+            // lea m, r64
+            assert(d->rex & REX_W);
+            inst->opcode = INST_LEA;
+            set_register_operand(&inst->dst, decode_modrm(d, &inst->src));
+            assert(inst->src.type == OD_MEM);
+            inst->handler = HANDLER_LEA_MEM_REG;
+            break;
+        case 0xcd:
+            // int imm8
+            inst->opcode = INST_INT;
+            set_immediate_operand(&inst->src, next_byte(d));
+            inst->handler = HANDLER_INT_IMM;
+            break;
+        case 0xa4:
+            // rep movsb
+            assert(d->rep == 1);
+            inst->opcode = INST_MOVSB;
+            inst->handler = HANDLER_REP_MOVSB;
+            break;
+        case 0xa5:
+            // rep movsq
+            assert(d->rep == 1 && (d->rex & REX_W));
+            inst->opcode = INST_MOVSQ;
+            inst->handler = HANDLER_REP_MOVSQ;
+            break;
+        case 0xaa:
+            // rep stosb
+            assert(d->rep == 1);
+            inst->opcode = INST_STOSB;
+            inst->handler = HANDLER_REP_STOSB;
+            break;
+        case 0xab:
+            // rep stosq
+            assert(d->rep == 1 && (d->rex & REX_W));
+            inst->opcode = INST_STOSQ;
+            inst->handler = HANDLER_REP_STOSQ;
+            break;
+        default:
+            break;
+    }
+    assert(inst->handler != HANDLER_ILLEGAL);
+    // only the string operations take the REP prefix
+    assert(d->rep == 0 || (INST_MOVSB <= inst->opcode && inst->opcode <= INST_STOSQ));
+
+    // the address of the next instruction
+    uint64_t next_rip = vaddr + d->length;
+
+    if (inst->handler == HANDLER_CALL ||
+        inst->handler == HANDLER_JNE ||
+        inst->handler == HANDLER_JMP)
+    {
+        // relative target to absolute target
+        inst->src.value += next_rip;
+    }
+
+    if (d->rip_relative == 1)
+    {
+        if (inst->src.type == OD_MEM)
+        {
+            inst->src.value += next_rip;
+        }
+        if (inst->dst.type == OD_MEM)
+        {
+            inst->dst.value += next_rip;
+        }
+    }
+
+    return d->length;
+}
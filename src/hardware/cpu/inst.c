@@ -16,131 +16,223 @@
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/algorithm.h"
+#include "headers/address.h"
 #include "headers/instruction.h"
 
 /*======================================*/
 /*      parse assembly instruction      */
 /*======================================*/
 
-// the implementation of ISA
-extern void mov_handler             (od_t *src_od, od_t *dst_od);
-extern void push_handler            (od_t *src_od, od_t *dst_od);
-extern void pop_handler             (od_t *src_od, od_t *dst_od);
-extern void leave_handler           (od_t *src_od, od_t *dst_od);
-extern void call_handler            (od_t *src_od, od_t *dst_od);
-extern void ret_handler             (od_t *src_od, od_t *dst_od);
-extern void add_handler             (od_t *src_od, od_t *dst_od);
-extern void sub_handler             (od_t *src_od, od_t *dst_od);
-extern void cmp_handler             (od_t *src_od, od_t *dst_od);
-extern void jne_handler             (od_t *src_od, od_t *dst_od);
-extern void jmp_handler             (od_t *src_od, od_t *dst_od);
-extern void lea_handler             (od_t *src_od, od_t *dst_od);
-extern void int_handler             (od_t *src_od, od_t *dst_od);
-
-static trie_node_t *register_mapping = NULL;
-static trie_node_t *operator_mapping = NULL;
-static void lazy_initialize_trie()
+// The names of registers and operators are looked up by perfect hashing.
+// A name (at most 8 chars) is packed into a 64-bit key char by char while
+// scanning, and the multiplicative hash of the keys has no collision in
+// the table. The multipliers are searched offline for the names below,
+// and the collision-free property is checked in initialization.
+// So each name costs one multiplication and one comparison.
+
+#define REGISTER_HASH_BITS (8)
+#define REGISTER_HASH_MULTIPLIER (0x9a56f68390fbf6bdul)
+#define OPERATOR_HASH_BITS (5)
+#define OPERATOR_HASH_MULTIPLIER (0x25f9672969617063ul)
+
+typedef struct
+{
+    uint64_t key;   // the packed name, 0 if the slot is empty
+    uint64_t value;
+} lexicon_entry_t;
+
+typedef struct
+{
+    char *name;
+    uint64_t value;
+} lexicon_word_t;
+
+static CORE_LOCAL lexicon_entry_t register_lexicon[(1 << REGISTER_HASH_BITS)];
+static CORE_LOCAL lexicon_entry_t operator_lexicon[(1 << OPERATOR_HASH_BITS)];
+static CORE_LOCAL int lexicon_initialized = 0;
+
+// no name is packed to it, since the chars of names are ASCII
+#define TOKEN_TOO_LONG (0xfffffffffffffffful)
+
+static inline uint64_t pack_token(uint64_t key, int length, char c)
+{
+    if (length >= 8)
+    {
+        // longer than any name in the lexicons, reported in looking up
+        return TOKEN_TOO_LONG;
+    }
+    return key | ((uint64_t)(uint8_t)c << (length * 8));
+}
+
+static inline uint64_t hash_token(uint64_t key, uint64_t multiplier, int bits)
 {
-    // initialize the register mapping
-    if (register_mapping == NULL)
+    return (key * multiplier) >> (64 - bits);
+}
+
+static void lexicon_insert(lexicon_entry_t *lexicon, uint64_t multiplier, int bits,
+    lexicon_word_t *words, int count)
+{
+    for (int i = 0; i < count; ++ i)
     {
-        register_mapping = trie_construct();
-        register_mapping = trie_insert(register_mapping, "%rax",   (uint64_t)&(cpu_reg.rax)    );
-        register_mapping = trie_insert(register_mapping, "%eax",   (uint64_t)&(cpu_reg.eax)    );
-        register_mapping = trie_insert(register_mapping, "%ax",    (uint64_t)&(cpu_reg.ax)     );
-        register_mapping = trie_insert(register_mapping, "%ah",    (uint64_t)&(cpu_reg.ah)     );
-        register_mapping = trie_insert(register_mapping, "%al",    (uint64_t)&(cpu_reg.al)     );
-        register_mapping = trie_insert(register_mapping, "%rbx",   (uint64_t)&(cpu_reg.rbx)    );
-        register_mapping = trie_insert(register_mapping, "%ebx",   (uint64_t)&(cpu_reg.ebx)    );
-        register_mapping = trie_insert(register_mapping, "%bx",    (uint64_t)&(cpu_reg.bx)     );
-        register_mapping = trie_insert(register_mapping, "%bh",    (uint64_t)&(cpu_reg.bh)     );
-        register_mapping = trie_insert(register_mapping, "%bl",    (uint64_t)&(cpu_reg.bl)     );
-        register_mapping = trie_insert(register_mapping, "%rcx",   (uint64_t)&(cpu_reg.rcx)    );
-        register_mapping = trie_insert(register_mapping, "%ecx",   (uint64_t)&(cpu_reg.ecx)    );
-        register_mapping = trie_insert(register_mapping, "%cx",    (uint64_t)&(cpu_reg.cx)     );
-        register_mapping = trie_insert(register_mapping, "%ch",    (uint64_t)&(cpu_reg.ch)     );
-        register_mapping = trie_insert(register_mapping, "%cl",    (uint64_t)&(cpu_reg.cl)     );
-        register_mapping = trie_insert(register_mapping, "%rdx",   (uint64_t)&(cpu_reg.rdx)    );
-        register_mapping = trie_insert(register_mapping, "%edx",   (uint64_t)&(cpu_reg.edx)    );
-        register_mapping = trie_insert(register_mapping, "%dx",    (uint64_t)&(cpu_reg.dx)     );
-        register_mapping = trie_insert(register_mapping, "%dh",    (uint64_t)&(cpu_reg.dh)     );
-        register_mapping = trie_insert(register_mapping, "%dl",    (uint64_t)&(cpu_reg.dl)     );
-        register_mapping = trie_insert(register_mapping, "%rsi",   (uint64_t)&(cpu_reg.rsi)    );
-        register_mapping = trie_insert(register_mapping, "%esi",   (uint64_t)&(cpu_reg.esi)    );
-        register_mapping = trie_insert(register_mapping, "%si",    (uint64_t)&(cpu_reg.si)     );
-        register_mapping = trie_insert(register_mapping, "%sih",   (uint64_t)&(cpu_reg.sih)    );
-        register_mapping = trie_insert(register_mapping, "%sil",   (uint64_t)&(cpu_reg.sil)    );
-        register_mapping = trie_insert(register_mapping, "%rdi",   (uint64_t)&(cpu_reg.rdi)    );
-        register_mapping = trie_insert(register_mapping, "%edi",   (uint64_t)&(cpu_reg.edi)    );
-        register_mapping = trie_insert(register_mapping, "%di",    (uint64_t)&(cpu_reg.di)     );
-        register_mapping = trie_insert(register_mapping, "%dih",   (uint64_t)&(cpu_reg.dih)    );
-        register_mapping = trie_insert(register_mapping, "%dil",   (uint64_t)&(cpu_reg.dil)    );
-        register_mapping = trie_insert(register_mapping, "%rbp",   (uint64_t)&(cpu_reg.rbp)    );
-        register_mapping = trie_insert(register_mapping, "%ebp",   (uint64_t)&(cpu_reg.ebp)    );
-        register_mapping = trie_insert(register_mapping, "%bp",    (uint64_t)&(cpu_reg.bp)     );
-        register_mapping = trie_insert(register_mapping, "%bph",   (uint64_t)&(cpu_reg.bph)    );
-        register_mapping = trie_insert(register_mapping, "%bpl",   (uint64_t)&(cpu_reg.bpl)    );
-        register_mapping = trie_insert(register_mapping, "%rsp",   (uint64_t)&(cpu_reg.rsp)    );
-        register_mapping = trie_insert(register_mapping, "%esp",   (uint64_t)&(cpu_reg.esp)    );
-        register_mapping = trie_insert(register_mapping, "%sp",    (uint64_t)&(cpu_reg.sp)     );
-        register_mapping = trie_insert(register_mapping, "%sph",   (uint64_t)&(cpu_reg.sph)    );
-        register_mapping = trie_insert(register_mapping, "%spl",   (uint64_t)&(cpu_reg.spl)    );
-        register_mapping = trie_insert(register_mapping, "%r8",    (uint64_t)&(cpu_reg.r8)     );
-        register_mapping = trie_insert(register_mapping, "%r8d",   (uint64_t)&(cpu_reg.r8d)    );
-        register_mapping = trie_insert(register_mapping, "%r8w",   (uint64_t)&(cpu_reg.r8w)    );
-        register_mapping = trie_insert(register_mapping, "%r8b",   (uint64_t)&(cpu_reg.r8b)    );
-        register_mapping = trie_insert(register_mapping, "%r9",    (uint64_t)&(cpu_reg.r9)     );
-        register_mapping = trie_insert(register_mapping, "%r9d",   (uint64_t)&(cpu_reg.r9d)    );
-        register_mapping = trie_insert(register_mapping, "%r9w",   (uint64_t)&(cpu_reg.r9w)    );
-        register_mapping = trie_insert(register_mapping, "%r9b",   (uint64_t)&(cpu_reg.r9b)    );
-        register_mapping = trie_insert(register_mapping, "%r10",   (uint64_t)&(cpu_reg.r10)    );
-        register_mapping = trie_insert(register_mapping, "%r10d",  (uint64_t)&(cpu_reg.r10d)   );
-        register_mapping = trie_insert(register_mapping, "%r10w",  (uint64_t)&(cpu_reg.r10w)   );
-        register_mapping = trie_insert(register_mapping, "%r10b",  (uint64_t)&(cpu_reg.r10b)   );
-        register_mapping = trie_insert(register_mapping, "%r11",   (uint64_t)&(cpu_reg.r11)    );
-        register_mapping = trie_insert(register_mapping, "%r11d",  (uint64_t)&(cpu_reg.r11d)   );
-        register_mapping = trie_insert(register_mapping, "%r11w",  (uint64_t)&(cpu_reg.r11w)   );
-        register_mapping = trie_insert(register_mapping, "%r11b",  (uint64_t)&(cpu_reg.r11b)   );
-        register_mapping = trie_insert(register_mapping, "%r12",   (uint64_t)&(cpu_reg.r12)    );
-        register_mapping = trie_insert(register_mapping, "%r12d",  (uint64_t)&(cpu_reg.r12d)   );
-        register_mapping = trie_insert(register_mapping, "%r12w",  (uint64_t)&(cpu_reg.r12w)   );
-        register_mapping = trie_insert(register_mapping, "%r12b",  (uint64_t)&(cpu_reg.r12b)   );
-        register_mapping = trie_insert(register_mapping, "%r13",   (uint64_t)&(cpu_reg.r13)    );
-        register_mapping = trie_insert(register_mapping, "%r13d",  (uint64_t)&(cpu_reg.r13d)   );
-        register_mapping = trie_insert(register_mapping, "%r13w",  (uint64_t)&(cpu_reg.r13w)   );
-        register_mapping = trie_insert(register_mapping, "%r13b",  (uint64_t)&(cpu_reg.r13b)   );
-        register_mapping = trie_insert(register_mapping, "%r14",   (uint64_t)&(cpu_reg.r14)    );
-        register_mapping = trie_insert(register_mapping, "%r14d",  (uint64_t)&(cpu_reg.r14d)   );
-        register_mapping = trie_insert(register_mapping, "%r14w",  (uint64_t)&(cpu_reg.r14w)   );
-        register_mapping = trie_insert(register_mapping, "%r14b",  (uint64_t)&(cpu_reg.r14b)   );
-        register_mapping = trie_insert(register_mapping, "%r15",   (uint64_t)&(cpu_reg.r15)    );
-        register_mapping = trie_insert(register_mapping, "%r15d",  (uint64_t)&(cpu_reg.r15d)   );
-        register_mapping = trie_insert(register_mapping, "%r15w",  (uint64_t)&(cpu_reg.r15w)   );
-        register_mapping = trie_insert(register_mapping, "%r15b",  (uint64_t)&(cpu_reg.r15b)   );
+        uint64_t key = 0;
+        for (int j = 0; j < strlen(words[i].name); ++ j)
+        {
+            key = pack_token(key, j, words[i].name[j]);
+        }
+
+        lexicon_entry_t *e = &lexicon[hash_token(key, multiplier, bits)];
+        // perfect hashing: no collision is allowed
+        assert(e->key == 0);
+        e->key = key;
+        e->value = words[i].value;
     }
+}
 
-    // initialize the operator mapping
-    if (operator_mapping == NULL)
+static void lazy_initialize_lexicon()
+{
+    if (lexicon_initialized == 1)
     {
-        operator_mapping = trie_construct();
-        operator_mapping = trie_insert(operator_mapping, "movq",   (uint64_t)&mov_handler    );
-        operator_mapping = trie_insert(operator_mapping, "mov",    (uint64_t)&mov_handler    );
-        operator_mapping = trie_insert(operator_mapping, "push",   (uint64_t)&push_handler   );
-        operator_mapping = trie_insert(operator_mapping, "pushq",   (uint64_t)&push_handler   );
-        operator_mapping = trie_insert(operator_mapping, "pop",    (uint64_t)&pop_handler    );
-        operator_mapping = trie_insert(operator_mapping, "leaveq", (uint64_t)&leave_handler  );
-        operator_mapping = trie_insert(operator_mapping, "callq",  (uint64_t)&call_handler   );
-        operator_mapping = trie_insert(operator_mapping, "retq",   (uint64_t)&ret_handler    );
-        operator_mapping = trie_insert(operator_mapping, "add",    (uint64_t)&add_handler    );
-        operator_mapping = trie_insert(operator_mapping, "sub",    (uint64_t)&sub_handler    );
-        operator_mapping = trie_insert(operator_mapping, "cmpq",   (uint64_t)&cmp_handler    );
-        operator_mapping = trie_insert(operator_mapping, "jne",    (uint64_t)&jne_handler    );
-        operator_mapping = trie_insert(operator_mapping, "jmp",    (uint64_t)&jmp_handler    );
-        operator_mapping = trie_insert(operator_mapping, "lea",    (uint64_t)&lea_handler    );
-        operator_mapping = trie_insert(operator_mapping, "int",    (uint64_t)&int_handler    );
+        return;
     }
+
+    lexicon_word_t registers[] = {
+        {"%rax",    (uint64_t)&(cpu_reg.rax)  },
+        {"%eax",    (uint64_t)&(cpu_reg.eax)  },
+        {"%ax",     (uint64_t)&(cpu_reg.ax)   },
+        {"%ah",     (uint64_t)&(cpu_reg.ah)   },
+        {"%al",     (uint64_t)&(cpu_reg.al)   },
+        {"%rbx",    (uint64_t)&(cpu_reg.rbx)  },
+        {"%ebx",    (uint64_t)&(cpu_reg.ebx)  },
+        {"%bx",     (uint64_t)&(cpu_reg.bx)   },
+        {"%bh",     (uint64_t)&(cpu_reg.bh)   },
+        {"%bl",     (uint64_t)&(cpu_reg.bl)   },
+        {"%rcx",    (uint64_t)&(cpu_reg.rcx)  },
+        {"%ecx",    (uint64_t)&(cpu_reg.ecx)  },
+        {"%cx",     (uint64_t)&(cpu_reg.cx)   },
+        {"%ch",     (uint64_t)&(cpu_reg.ch)   },
+        {"%cl",     (uint64_t)&(cpu_reg.cl)   },
+        {"%rdx",    (uint64_t)&(cpu_reg.rdx)  },
+        {"%edx",    (uint64_t)&(cpu_reg.edx)  },
+        {"%dx",     (uint64_t)&(cpu_reg.dx)   },
+        {"%dh",     (uint64_t)&(cpu_reg.dh)   },
+        {"%dl",     (uint64_t)&(cpu_reg.dl)   },
+        {"%rsi",    (uint64_t)&(cpu_reg.rsi)  },
+        {"%esi",    (uint64_t)&(cpu_reg.esi)  },
+        {"%si",     (uint64_t)&(cpu_reg.si)   },
+        {"%sih",    (uint64_t)&(cpu_reg.sih)  },
+        {"%sil",    (uint64_t)&(cpu_reg.sil)  },
+        {"%rdi",    (uint64_t)&(cpu_reg.rdi)  },
+        {"%edi",    (uint64_t)&(cpu_reg.edi)  },
+        {"%di",     (uint64_t)&(cpu_reg.di)   },
+        {"%dih",    (uint64_t)&(cpu_reg.dih)  },
+        {"%dil",    (uint64_t)&(cpu_reg.dil)  },
+        {"%rbp",    (uint64_t)&(cpu_reg.rbp)  },
+        {"%ebp",    (uint64_t)&(cpu_reg.ebp)  },
+        {"%bp",     (uint64_t)&(cpu_reg.bp)   },
+        {"%bph",    (uint64_t)&(cpu_reg.bph)  },
+        {"%bpl",    (uint64_t)&(cpu_reg.bpl)  },
+        {"%rsp",    (uint64_t)&(cpu_reg.rsp)  },
+        {"%esp",    (uint64_t)&(cpu_reg.esp)  },
+        {"%sp",     (uint64_t)&(cpu_reg.sp)   },
+        {"%sph",    (uint64_t)&(cpu_reg.sph)  },
+        {"%spl",    (uint64_t)&(cpu_reg.spl)  },
+        {"%r8",     (uint64_t)&(cpu_reg.r8)   },
+        {"%r8d",    (uint64_t)&(cpu_reg.r8d)  },
+        {"%r8w",    (uint64_t)&(cpu_reg.r8w)  },
+        {"%r8b",    (uint64_t)&(cpu_reg.r8b)  },
+        {"%r9",     (uint64_t)&(cpu_reg.r9)   },
+        {"%r9d",    (uint64_t)&(cpu_reg.r9d)  },
+        {"%r9w",    (uint64_t)&(cpu_reg.r9w)  },
+        {"%r9b",    (uint64_t)&(cpu_reg.r9b)  },
+        {"%r10",    (uint64_t)&(cpu_reg.r10)  },
+        {"%r10d",   (uint64_t)&(cpu_reg.r10d) },
+        {"%r10w",   (uint64_t)&(cpu_reg.r10w) },
+        {"%r10b",   (uint64_t)&(cpu_reg.r10b) },
+        {"%r11",    (uint64_t)&(cpu_reg.r11)  },
+        {"%r11d",   (uint64_t)&(cpu_reg.r11d) },
+        {"%r11w",   (uint64_t)&(cpu_reg.r11w) },
+        {"%r11b",   (uint64_t)&(cpu_reg.r11b) },
+        {"%r12",    (uint64_t)&(cpu_reg.r12)  },
+        {"%r12d",   (uint64_t)&(cpu_reg.r12d) },
+        {"%r12w",   (uint64_t)&(cpu_reg.r12w) },
+        {"%r12b",   (uint64_t)&(cpu_reg.r12b) },
+        {"%r13",    (uint64_t)&(cpu_reg.r13)  },
+        {"%r13d",   (uint64_t)&(cpu_reg.r13d) },
+        {"%r13w",   (uint64_t)&(cpu_reg.r13w) },
+        {"%r13b",   (uint64_t)&(cpu_reg.r13b) },
+        {"%r14",    (uint64_t)&(cpu_reg.r14)  },
+        {"%r14d",   (uint64_t)&(cpu_reg.r14d) },
+        {"%r14w",   (uint64_t)&(cpu_reg.r14w) },
+        {"%r14b",   (uint64_t)&(cpu_reg.r14b) },
+        {"%r15",    (uint64_t)&(cpu_reg.r15)  },
+        {"%r15d",   (uint64_t)&(cpu_reg.r15d) },
+        {"%r15w",   (uint64_t)&(cpu_reg.r15w) },
+        {"%r15b",   (uint64_t)&(cpu_reg.r15b) },
+    };
+    lexicon_insert(register_lexicon, REGISTER_HASH_MULTIPLIER, REGISTER_HASH_BITS,
+        registers, sizeof(registers) / sizeof(lexicon_word_t));
+
+    lexicon_word_t operators[] = {
+        {"movq",    (uint64_t)INST_MOV   },
+        {"mov",     (uint64_t)INST_MOV   },
+        {"push",    (uint64_t)INST_PUSH  },
+        {"pushq",   (uint64_t)INST_PUSH  },
+        {"pop",     (uint64_t)INST_POP   },
+        {"leaveq",  (uint64_t)INST_LEAVE },
+        {"callq",   (uint64_t)INST_CALL  },
+        {"retq",    (uint64_t)INST_RET   },
+        {"add",     (uint64_t)INST_ADD   },
+        {"sub",     (uint64_t)INST_SUB   },
+        {"cmpq",    (uint64_t)INST_CMP   },
+        {"jne",     (uint64_t)INST_JNE   },
+        {"jmp",     (uint64_t)INST_JMP   },
+        {"lea",     (uint64_t)INST_LEA   },
+        {"int",     (uint64_t)INST_INT   },
+        {"rep",     (uint64_t)INST_REP   },
+        {"movsb",   (uint64_t)INST_MOVSB },
+        {"movsq",   (uint64_t)INST_MOVSQ },
+        {"stosb",   (uint64_t)INST_STOSB },
+        {"stosq",   (uint64_t)INST_STOSQ },
+    };
+    lexicon_insert(operator_lexicon, OPERATOR_HASH_MULTIPLIER, OPERATOR_HASH_BITS,
+        operators, sizeof(operators) / sizeof(lexicon_word_t));
+
+    lexicon_initialized = 1;
 }
 
+// select the specialized handler by the operator and the operand types
+// the combinations not listed here are HANDLER_ILLEGAL
+static const handler_type_t handler_selector[NUM_INSTRTYPE][4][4] =
+{
+    [INST_MOV][OD_REG][OD_REG]        = HANDLER_MOV_REG_REG,
+    [INST_MOV][OD_REG][OD_MEM]        = HANDLER_MOV_REG_MEM,
+    [INST_MOV][OD_MEM][OD_REG]        = HANDLER_MOV_MEM_REG,
+    [INST_MOV][OD_IMM][OD_REG]        = HANDLER_MOV_IMM_REG,
+    [INST_PUSH][OD_REG][OD_EMPTY]     = HANDLER_PUSH_REG,
+    [INST_POP][OD_REG][OD_EMPTY]      = HANDLER_POP_REG,
+    [INST_LEAVE][OD_EMPTY][OD_EMPTY]  = HANDLER_LEAVE,
+    // the target address of call and jump is parsed as memory
+    // operand, but it is interpreted as an immediate number
+    [INST_CALL][OD_IMM][OD_EMPTY]     = HANDLER_CALL,
+    [INST_CALL][OD_MEM][OD_EMPTY]     = HANDLER_CALL,
+    [INST_RET][OD_EMPTY][OD_EMPTY]    = HANDLER_RET,
+    [INST_ADD][OD_REG][OD_REG]        = HANDLER_ADD_REG_REG,
+    [INST_SUB][OD_IMM][OD_REG]        = HANDLER_SUB_IMM_REG,
+    [INST_CMP][OD_IMM][OD_MEM]        = HANDLER_CMP_IMM_MEM,
+    [INST_JNE][OD_IMM][OD_EMPTY]      = HANDLER_JNE,
+    [INST_JNE][OD_MEM][OD_EMPTY]      = HANDLER_JNE,
+    [INST_JMP][OD_IMM][OD_EMPTY]      = HANDLER_JMP,
+    [INST_JMP][OD_MEM][OD_EMPTY]      = HANDLER_JMP,
+    [INST_LEA][OD_MEM][OD_REG]        = HANDLER_LEA_MEM_REG,
+    [INST_INT][OD_IMM][OD_EMPTY]      = HANDLER_INT_IMM,
+    // the operands of string operations are implicit:
+    // %rsi, %rdi and the count %rcx
+    [INST_MOVSB][OD_EMPTY][OD_EMPTY]  = HANDLER_REP_MOVSB,
+    [INST_MOVSQ][OD_EMPTY][OD_EMPTY]  = HANDLER_REP_MOVSQ,
+    [INST_STOSB][OD_EMPTY][OD_EMPTY]  = HANDLER_REP_STOSB,
+    [INST_STOSQ][OD_EMPTY][OD_EMPTY]  = HANDLER_REP_STOSQ,
+};
+
 typedef enum
 {
     INST_PARSE_START,
@@ -197,8 +289,9 @@ typedef enum
 
 typedef struct
 {
-    // parser for string
-    trie_node_t *trie_node;
+    // the name of register or operator being scanned
+    uint64_t token;
+    int token_length;
 
     // parser for number
     string2uint_state_t imm_state;
@@ -221,6 +314,9 @@ typedef struct
     // parsed operand
     od_t operand;
 
+    // 1 if the operator follows the `rep` prefix
+    int rep;
+
     // parsed result
     inst_t *inst;
 } inst_parser_t;
@@ -229,6 +325,45 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c);
 static inst_parser_t *parse_operand_next(inst_parser_t *p, char c);
 static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c);
 
+static inline void start_token(inst_parser_t *p)
+{
+    p->token = 0;
+    p->token_length = 0;
+}
+
+static inline void append_token(inst_parser_t *p, char c)
+{
+    p->token = pack_token(p->token, p->token_length, c);
+    p->token_length += 1;
+}
+
+static inline uint64_t lookup_token(lexicon_entry_t *lexicon, uint64_t multiplier, int bits, uint64_t key)
+{
+    lexicon_entry_t *e = &lexicon[hash_token(key, multiplier, bits)];
+    // checked without assert, or the unknown name resolves to the word in its slot
+    if (key == TOKEN_TOO_LONG)
+    {
+        printf("parse_instruction: name longer than 8 chars\n");
+        exit(1);
+    }
+    if (key == 0 || e->key != key)
+    {
+        printf("parse_instruction: unknown name: %.8s\n", (char *)&key);
+        exit(1);
+    }
+    return e->value;
+}
+
+static inline uint64_t lookup_register(inst_parser_t *p)
+{
+    return lookup_token(register_lexicon, REGISTER_HASH_MULTIPLIER, REGISTER_HASH_BITS, p->token);
+}
+
+static inline op_type_t lookup_operator(inst_parser_t *p)
+{
+    return (op_type_t)lookup_token(operator_lexicon, OPERATOR_HASH_MULTIPLIER, OPERATOR_HASH_BITS, p->token);
+}
+
 // DFA to parse instruction in one-time left-right scanning
 static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
 {
@@ -242,10 +377,9 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
             if ('a' <= c && c <= 'z')
             {
                 // start parsing operator
-                p->trie_node = operator_mapping;
+                start_token(p);
                 // accepting first char in operator
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 p->inst_state = INST_PARSE_OPERATOR;
                 return p;
             }
@@ -258,17 +392,23 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
         case INST_PARSE_OPERATOR:
             if ('a' <= c && c <= 'z')
             {
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 return p;
             }
             else if (c == ' ' || c == '\t' || c == '\r')
             {
                 // operator parsed
-                assert(p->trie_node != NULL);
-                assert(p->trie_node->isvalue == 1);
                 // get operator
-                p->inst->op = (op_t)p->trie_node->value;
+                p->inst->opcode = lookup_operator(p);
+
+                if (p->inst->opcode == INST_REP)
+                {
+                    // prefix parsed, the operator follows
+                    assert(p->rep == 0);
+                    p->rep = 1;
+                    p->inst_state = INST_PARSE_START;
+                    return p;
+                }
 
                 // transfer to first operand
                 p->inst_state = INST_PARSE_SPACE_SRC_OPERAND;
@@ -277,10 +417,8 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
             else if (c == '\n')
             {
                 // instruction ends without operand like: `NOP`, `RET`
-                assert(p->trie_node != NULL);
-                assert(p->trie_node->isvalue == 1);
                 // get operator
-                p->inst->op = (op_t)p->trie_node->value;
+                p->inst->opcode = lookup_operator(p);
 
                 p->inst_state = INST_PARSE_PARSED;
                 p->inst->src.type = OD_EMPTY;
@@ -325,8 +463,7 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
             {
                 // src parsed
                 // copy the result to src
-                p->inst->src.type = p->operand.type;
-                p->inst->src.value = p->operand.value;
+                p->inst->src = p->operand;
 
                 // going to parse dst
                 if (c == '\n')
@@ -374,8 +511,7 @@ static inst_parser_t *parse_instruction_next(inst_parser_t *p, char c)
             {
                 // dst parsed
                 // copy the result to dst
-                p->inst->dst.type = p->operand.type;
-                p->inst->dst.value = p->operand.value;
+                p->inst->dst = p->operand;
 
                 // going to parse dst
                 p->inst_state = INST_PARSE_PARSED;
@@ -397,6 +533,7 @@ static inst_parser_t *parse_operand_next(inst_parser_t *p, char c)
     {
         case OPERAND_PARSE_START:
             // the start of parsing operands
+            memset(&p->operand, 0, sizeof(od_t));
             if (c == '$')
             {
                 // immediate number
@@ -411,10 +548,9 @@ static inst_parser_t *parse_operand_next(inst_parser_t *p, char c)
             {
                 // register
                 // start parsing register
-                p->trie_node = register_mapping;
+                start_token(p);
                 // accepting first char in register ('%')
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 p->od_state = OPERAND_PARSE_REG;
                 return p;
             }
@@ -453,21 +589,19 @@ static inst_parser_t *parse_operand_next(inst_parser_t *p, char c)
             }
             assert(0);
         case OPERAND_PARSE_REG:
-            // register
-            if ('a' <= c && c <= 'z')
+            // register: the digits are in %r8 - %r15
+            if (('a' <= c && c <= 'z') || ('0' <= c && c <= '9'))
             {
                 // still a register
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 return p;
             }
             else if (c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
             {
                 // end of parsing this operand: reg
                 p->od_state = OPERAND_PARSE_PARSED;
-                assert(p->trie_node->isvalue == 1);
                 p->operand.type = OD_REG;
-                p->operand.value = p->trie_node->value;
+                p->operand.value = lookup_register(p);
                 return p;
             }
             assert(0);
@@ -483,8 +617,6 @@ static inst_parser_t *parse_operand_next(inst_parser_t *p, char c)
     }
 }
 
-uint64_t zero_register = 0;
-
 // DFA to parse effective address in one-time left-right scanning
 static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
 {
@@ -536,10 +668,9 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
             }
             else if (c == ',' || c == ' ' ||  c == '\t' || c == '\r' || c == '\n')
             {
-                // end of parsing this operand: reg
+                // end of parsing this operand: imm
                 p->mem_state = MEM_PARSE_PARSED;
-                // computing of effective address
-                // this is the work of ALU
+                // absolute address without registers
                 p->operand.type = OD_MEM;
                 p->operand.value = p->imm;
                 return p;
@@ -551,9 +682,8 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
             {
                 // *(reg1
                 // parsing reg1, '%' accepted
-                p->trie_node = register_mapping;
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                start_token(p);
+                append_token(p, c);
                 p->mem_state = MEM_PARSE_FIRST_REGISTER;
                 return p;
             }
@@ -562,61 +692,56 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
                 // *(,reg2...
                 // initialize the second register
                 // and we have not accepted '%' here
-                p->trie_node = register_mapping;
-                p->reg1 = (uint64_t)&zero_register;
+                start_token(p);
+                p->reg1 = 0;
                 p->mem_state = MEM_PARSE_SECOND_REGISTER;
                 return p;
             }
             assert(0);
         case MEM_PARSE_FIRST_REGISTER:
             // *(reg1...
-            if ('a' <= c && c <= 'z')
+            if (('a' <= c && c <= 'z') || ('0' <= c && c <= '9'))
             {
                 // parsing reg1
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 return p;
             }
             else if (c == ',')
             {
                 // end of parsing reg1
-                assert(p->trie_node->isvalue == 1);
-                p->reg1 = p->trie_node->value;
+                p->reg1 = lookup_register(p);
                 // initialize the second register
                 // and we have not accepted '%' here
-                p->trie_node = register_mapping;
+                start_token(p);
                 p->mem_state = MEM_PARSE_SECOND_REGISTER;
                 return p;
             }
             else if (c == ')')
             {
                 // end of parsing reg1
-                assert(p->trie_node->isvalue == 1);
-                p->reg1 = p->trie_node->value;
+                p->reg1 = lookup_register(p);
                 p->mem_state = MEM_PARSE_RIGHT_PARENTHESIS;
                 
-                // computing of effective address
+                // effective address is computed in execution
                 p->operand.type = OD_MEM;
-                p->operand.value = *(uint64_t *)p->reg1 + p->imm;
+                p->operand.value = p->imm;
+                p->operand.reg1 = p->reg1;
                 return p;
             }
             assert(0);
         case MEM_PARSE_SECOND_REGISTER:
-            // `zero_register` is making the effective address safe to compute
-            // even without reg1, the reg1 is set to zero_register
-            // so the we can get 0 from reg1
-            if (c == '%' || ('a' <= c && c <= 'z'))
+            // without reg1, the reg1 is set to 0
+            // and it is skipped when computing the effective address
+            if (c == '%' || ('a' <= c && c <= 'z') || ('0' <= c && c <= '9'))
             {
                 // parsing reg2
-                p->trie_node = trie_next(p->trie_node, c);
-                assert(p->trie_node != NULL);
+                append_token(p, c);
                 return p;
             }
             else if (c == ',')
             {
                 // reg2 parsed
-                assert(p->trie_node->isvalue == 1);
-                p->reg2 = p->trie_node->value;
+                p->reg2 = lookup_register(p);
                 // going to parse scale
                 p->mem_state = MEM_PARSE_SCALE;
                 return p;
@@ -625,14 +750,16 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
             {
                 // *(*,reg2)
                 // reg2 parsed
-                assert(p->trie_node->isvalue == 1);
-                p->reg2 = p->trie_node->value;
+                p->reg2 = lookup_register(p);
                 p->scal = 1;
                 p->mem_state = MEM_PARSE_RIGHT_PARENTHESIS;
 
-                // computing of effective address
+                // effective address is computed in execution
                 p->operand.type = OD_MEM;
-                p->operand.value = *(uint64_t *)p->reg2 + *(uint64_t *)p->reg1 + p->imm;
+                p->operand.value = p->imm;
+                p->operand.reg1 = p->reg1;
+                p->operand.reg2 = p->reg2;
+                p->operand.scal = p->scal;
                 return p;
             }
             assert(0);
@@ -640,18 +767,21 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
             if (c == '1' || c == '2' || c == '4' || c == '8')
             {
                 p->scal = c - '0';
-                p->od_state = MEM_PARSE_SCALE_PARSED;
+                p->mem_state = MEM_PARSE_SCALE_PARSED;
 
-                // computing of effective address
+                // effective address is computed in execution
                 p->operand.type = OD_MEM;
-                p->operand.value = *(uint64_t *)p->reg2 * p->scal + *(uint64_t *)p->reg1 + p->imm;
+                p->operand.value = p->imm;
+                p->operand.reg1 = p->reg1;
+                p->operand.reg2 = p->reg2;
+                p->operand.scal = p->scal;
                 return p;
             }
             assert(0);
         case MEM_PARSE_SCALE_PARSED:
             if (c == ')')
             {
-                p->od_state = MEM_PARSE_RIGHT_PARENTHESIS;
+                p->mem_state = MEM_PARSE_RIGHT_PARENTHESIS;
                 return p;
             }
             assert(0);
@@ -670,13 +800,14 @@ static inst_parser_t *parse_effective_address_next(inst_parser_t *p, char c)
 
 void parse_instruction(char *inst_str, inst_t *inst)
 {
-    lazy_initialize_trie();
+    lazy_initialize_lexicon();
 
     inst_parser_t parser =
     {
         .inst = inst
     };
     inst_parser_t *p = &parser;
+    memset(inst, 0, sizeof(inst_t));
     
     for (int i = 0; i < strlen(inst_str); ++ i)
     {
@@ -689,4 +820,136 @@ void parse_instruction(char *inst_str, inst_t *inst)
     }
     p = parse_instruction_next(p, '\n');
     assert(p->inst_state == INST_PARSE_PARSED);
-}
\ No newline at end of file
+
+    // the string operations are supported with `rep` only,
+    // and `rep` is only allowed before them
+    assert(parser.rep == (INST_MOVSB <= inst->opcode && inst->opcode <= INST_STOSQ));
+
+    // bind the handler in decoding, not in execution
+    inst->handler = handler_selector[inst->opcode][inst->src.type][inst->dst.type];
+    assert(inst->handler != HANDLER_ILLEGAL);
+}
+
+/*======================================*/
+/*      decoded instruction cache       */
+/*======================================*/
+
+#ifdef USE_DECODE_CACHE
+// Parsing the instruction string is the most expensive part of the
+// instruction cycle. The decoded instructions are cached by the physical
+// address of the instruction, so the instructions in a hot loop are parsed
+// only once. Each instruction takes MAX_INSTRUCTION_CHAR bytes in DRAM,
+// thus the cache line is indexed by the instruction slot of the address.
+// With 1024 lines, the direct-mapped cache covers the whole 64KB of DRAM.
+
+#define DECODE_CACHE_INDEX_LENGTH (10)
+
+#ifdef USE_SOFTMMU
+// from mmu.c
+void softmmu_protect_code_page(uint64_t ppn);
+#endif
+
+typedef struct
+{
+    int valid;
+    uint64_t paddr;
+#ifdef USE_SMP
+    uint64_t version;   // the code version of the page when decoded
+#endif
+    inst_t inst;
+} decode_cacheline_t;
+
+static CORE_LOCAL decode_cacheline_t decode_cache[(1 << DECODE_CACHE_INDEX_LENGTH)];
+
+// version of the code in each physical page, increased on every write,
+// so the translations built upon the decoded instructions can be checked
+static MACHINE_LOCAL uint64_t code_version[PHYSICAL_MEMORY_SPACE / PAGE_SIZE];
+
+uint64_t read_code_version(uint64_t ppn)
+{
+#ifdef USE_SMP
+    // written by the other cores
+    return __atomic_load_n(&code_version[ppn], __ATOMIC_ACQUIRE);
+#else
+    return code_version[ppn];
+#endif
+}
+
+static inline decode_cacheline_t *get_decode_cacheline(uint64_t paddr)
+{
+    uint64_t index = (paddr / MAX_INSTRUCTION_CHAR) & ((1 << DECODE_CACHE_INDEX_LENGTH) - 1);
+    return &decode_cache[index];
+}
+
+int read_decode_cache(uint64_t paddr, inst_t *inst)
+{
+    decode_cacheline_t *line = get_decode_cacheline(paddr);
+#ifdef USE_SMP
+    // the code may be written by another core, which can only
+    // invalidate its own decode cache but bumps the shared version
+    if (line->valid == 1 && line->paddr == paddr &&
+        line->version == read_code_version(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH))
+#else
+    if (line->valid == 1 && line->paddr == paddr)
+#endif
+    {
+        // decode cache hit
+        memcpy(inst, &line->inst, sizeof(inst_t));
+        return 1;
+    }
+
+    // decode cache miss
+    return 0;
+}
+
+void write_decode_cache(uint64_t paddr, inst_t *inst)
+{
+    // direct-mapped: always overwrite the line
+    decode_cacheline_t *line = get_decode_cacheline(paddr);
+    line->valid = 1;
+    line->paddr = paddr;
+#ifdef USE_SMP
+    line->version = read_code_version(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
+#endif
+#ifdef USE_SOFTMMU
+    // the decoded instructions must not be written by the host pointers
+    softmmu_protect_code_page(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
+#endif
+    memcpy(&line->inst, inst, sizeof(inst_t));
+}
+
+// invalidate the decoded instructions overlapping [paddr, paddr + size)
+// must be called on every write to the physical memory
+void invalidate_decode_cache(uint64_t paddr, uint64_t size)
+{
+    // the instruction starting at (paddr - MAX_INSTRUCTION_CHAR + 1)
+    // is the lowest one that may overlap the written bytes
+    uint64_t low = 0;
+    if (paddr >= MAX_INSTRUCTION_CHAR)
+    {
+        low = paddr - MAX_INSTRUCTION_CHAR + 1;
+    }
+
+    for (uint64_t slot = low / MAX_INSTRUCTION_CHAR; 
+        slot * MAX_INSTRUCTION_CHAR < paddr + size; ++ slot)
+    {
+        decode_cacheline_t *line = get_decode_cacheline(slot * MAX_INSTRUCTION_CHAR);
+        if (line->valid == 1 &&
+            line->paddr < paddr + size &&
+            paddr < line->paddr + MAX_INSTRUCTION_CHAR)
+        {
+            line->valid = 0;
+        }
+    }
+
+    for (uint64_t ppn = paddr >> PHYSICAL_PAGE_OFFSET_LENGTH;
+        (ppn << PHYSICAL_PAGE_OFFSET_LENGTH) < paddr + size; ++ ppn)
+    {
+#ifdef USE_SMP
+        __atomic_fetch_add(&code_version[ppn], 1, __ATOMIC_RELEASE);
+#else
+        code_version[ppn] += 1;
+#endif
+    }
+}
+#endif
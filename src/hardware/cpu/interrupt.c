@@ -17,6 +17,7 @@
 #include "headers/interrupt.h"
 #include "headers/process.h"
 #include "headers/address.h"
+#include "headers/log.h"
 
 typedef void (*interrupt_handler_t)();
 
@@ -27,7 +28,10 @@ typedef struct IDT_ENTRY_STRUCT
 } idt_entry_t;
 
 // Interrupt Descriptor/Vector Table
-idt_entry_t idt[256];
+MACHINE_LOCAL idt_entry_t idt[256];
+
+// the entry point of the re-execution after interrupt return
+CORE_LOCAL jmp_buf USER_INSTRUCTION_ON_IRET;
 
 // handlers of IDT
 void pagefault_handler();           // trap gate - exception
@@ -173,6 +177,9 @@ static void software_push_userframe()
     uint64_t rsp = cpu_reg.rsp;
     assert((rsp + tf_size) == get_kstack_top_TSS());
 
+    // the condition codes are saved as evaluated values
+    evaluate_flags();
+
     // store user frame to kstack
     rsp -= uf_size;
     userframe_t uf = {
@@ -284,7 +291,7 @@ void interrupt_return_stack_switching()
 
 void timer_handler()
 {
-    printf("\033[32;1mTimer interrupt to invoke OS scheduling\033[0m\n");
+    LOG(LOG_INTERRUPT, LOG_DEBUG, "\033[32;1mTimer interrupt to invoke OS scheduling\033[0m\n");
     software_push_userframe();
     os_schedule();
     /* ================================= */
@@ -303,7 +310,7 @@ void timer_handler()
 
 void pagefault_handler()
 {
-    printf("\033[32;1mPage fault handling\033[0m\n");
+    LOG(LOG_INTERRUPT, LOG_INFO, "\033[32;1mPage fault handling\033[0m\n");
 
     software_push_userframe();
     fix_pagefault();
@@ -313,7 +320,7 @@ void pagefault_handler()
 
 void syscall_handler()
 {
-    printf("\033[32;1mInvoking system call [%ld]\033[0m\n", cpu_reg.rax);
+    LOG(LOG_INTERRUPT, LOG_DEBUG, "\033[32;1mInvoking system call [%ld]\033[0m\n", cpu_reg.rax);
 
     // push user general registers to kernel stack
     // to save the context of user thread
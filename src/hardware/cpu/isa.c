@@ -16,17 +16,123 @@
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/algorithm.h"
+#include "headers/address.h"
 #include "headers/instruction.h"
 #include "headers/interrupt.h"
+#include "headers/trace.h"
+#include "headers/cycle.h"
+#include "headers/softmmu.h"
+
+// length of the executing instruction in memory
+// set in fetching: MAX_INSTRUCTION_CHAR for the assembly string,
+// or the variable length of the x86-64 machine code
+static CORE_LOCAL uint64_t inst_length = MAX_INSTRUCTION_CHAR;
 
 // update the rip pointer to the next instruction sequentially
 static inline void increase_pc()
 {
-    // we are handling the fixed-length of assembly string here
-    // but their size can be variable as true X86 instructions
+    // the assembly strings are of fixed length
+    // but the size of x86 machine code is variable
     // that's because the operands' sizes follow the specific encoding rule
     // the risc-v is a fixed length ISA
-    cpu_pc.rip = cpu_pc.rip + sizeof(char) * MAX_INSTRUCTION_CHAR;
+    cpu_pc.rip = cpu_pc.rip + inst_length;
+}
+
+// compute the effective address of memory operand: value(reg1, reg2, scal)
+// this is the work of ALU in execution, not in decoding,
+// so the decoded instruction can be reused with other register values
+static inline uint64_t compute_effective_address(od_t *od)
+{
+    uint64_t vaddr = od->value;
+    if (od->reg1 != 0)
+    {
+        vaddr += *(uint64_t *)(od->reg1);
+    }
+    if (od->reg2 != 0)
+    {
+        vaddr += *(uint64_t *)(od->reg2) * od->scal;
+    }
+    return vaddr;
+}
+
+// the 8-byte data accesses of the instructions
+// both may page fault, so they go before any update of the registers
+static inline uint64_t load64(uint64_t vaddr)
+{
+#ifdef USE_SOFTMMU
+    return softmmu_load64(vaddr);
+#else
+    return cpu_read64bits_dram(va2pa(vaddr));
+#endif
+}
+
+static inline void store64(uint64_t vaddr, uint64_t data)
+{
+#ifdef USE_SOFTMMU
+    softmmu_store64(vaddr, data);
+#else
+    cpu_write64bits_dram(va2pa_write(vaddr), data);
+#endif
+}
+
+// condition codes
+
+// most instructions only clear the flags
+static inline void clear_flags()
+{
+    cpu_flags.__flags_value = 0;
+    cpu_flags.lazy_op = FLAGS_EVALUATED;
+}
+
+// only record the operation, the flags are computed when they are read
+// because most results of arithmetic are never tested
+static inline void set_lazy_flags(flags_op_t op, uint64_t src, uint64_t dst, uint64_t result)
+{
+    cpu_flags.lazy_op = op;
+    cpu_flags.lazy_src = src;
+    cpu_flags.lazy_dst = dst;
+    cpu_flags.lazy_result = result;
+}
+
+// ZF is the most frequently read flag, and it does not need the others
+static inline int read_zero_flag()
+{
+    if (cpu_flags.lazy_op == FLAGS_EVALUATED)
+    {
+        return cpu_flags.ZF;
+    }
+    return cpu_flags.lazy_result == 0;
+}
+
+void evaluate_flags()
+{
+    uint64_t src = cpu_flags.lazy_src;
+    uint64_t dst = cpu_flags.lazy_dst;
+    uint64_t val = cpu_flags.lazy_result;
+
+    int val_sign = ((val >> 63) & 0x1);
+    int src_sign = ((src >> 63) & 0x1);
+    int dst_sign = ((dst >> 63) & 0x1);
+
+    switch (cpu_flags.lazy_op)
+    {
+        case FLAGS_ADD:
+            cpu_flags.CF = (val < src); // unsigned
+            cpu_flags.ZF = (val == 0);
+            cpu_flags.SF = val_sign;
+            cpu_flags.OF = (src_sign == 0 && dst_sign == 0 && val_sign == 1) || (src_sign == 1 && dst_sign == 1 && val_sign == 0);
+            break;
+        case FLAGS_SUB:
+            cpu_flags.CF = (val > dst); // unsigned
+            cpu_flags.ZF = (val == 0);
+            cpu_flags.SF = val_sign;
+            cpu_flags.OF = (src_sign == 1 && dst_sign == 0 && val_sign == 1) || (src_sign == 0 && dst_sign == 1 && val_sign == 0);
+            break;
+        case FLAGS_EVALUATED:
+        default:
+            return;
+    }
+    cpu_flags.lazy_op = FLAGS_EVALUATED;
 }
 
 // instruction handlers
@@ -53,216 +159,160 @@ static inline void increase_pc()
  *          process 1, second `mov`: no page fault
  */
 
-void mov_handler(od_t *src_od, od_t *dst_od)
+static void mov_reg_reg_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_REG && dst_od->type == OD_REG)
-    {
-        // src: register
-        // dst: register
-        *(uint64_t *)(dst_od->value) = *(uint64_t *)(src_od->value);
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
-    else if (src_od->type == OD_REG && dst_od->type == OD_MEM)
-    {
-        // src: register
-        // dst: virtual address
-        uint64_t dst_pa = va2pa(dst_od->value);
-        cpu_write64bits_dram(dst_pa, *(uint64_t *)(src_od->value));
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
-    else if (src_od->type == OD_MEM && dst_od->type == OD_REG)
-    {
-        // src: virtual address
-        // dst: register
-        uint64_t src_pa = va2pa(src_od->value);
-        *(uint64_t *)(dst_od->value) = cpu_read64bits_dram(src_pa);
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
-    else if (src_od->type == OD_IMM && dst_od->type == OD_REG)
-    {
-        // src: immediate number (uint64_t bit map)
-        // dst: register
-        *(uint64_t *)(dst_od->value) = (src_od->value);
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
+    // src: register
+    // dst: register
+    *(uint64_t *)(dst_od->value) = *(uint64_t *)(src_od->value);
+    increase_pc();
+    clear_flags();
 }
 
-void push_handler(od_t *src_od, od_t *dst_od)
+static void mov_reg_mem_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_REG)
-    {
-        // src: register
-        // dst: empty
-        cpu_reg.rsp = cpu_reg.rsp - 8;
-        uint64_t rsp_pa = va2pa(cpu_reg.rsp);
-        cpu_write64bits_dram(
-            rsp_pa, 
-            *(uint64_t *)(src_od->value));
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
+    // src: register
+    // dst: virtual address
+    store64(compute_effective_address(dst_od), *(uint64_t *)(src_od->value));
+    increase_pc();
+    clear_flags();
 }
 
-void pop_handler(od_t *src_od, od_t *dst_od)
+static void mov_mem_reg_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_REG)
-    {
-        // src: register
-        // dst: empty
-        uint64_t rsp_pa = va2pa(cpu_reg.rsp);
-        uint64_t old_val = cpu_read64bits_dram(rsp_pa);
-        cpu_reg.rsp = cpu_reg.rsp + 8;
-        *(uint64_t *)(src_od->value) = old_val;
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
-    }
+    // src: virtual address
+    // dst: register
+    *(uint64_t *)(dst_od->value) = load64(compute_effective_address(src_od));
+    increase_pc();
+    clear_flags();
 }
 
-void leave_handler(od_t *src_od, od_t *dst_od)
+static void mov_imm_reg_handler(od_t *src_od, od_t *dst_od)
 {
-    // movq %rbp, %rsp
-    cpu_reg.rsp = cpu_reg.rbp;
+    // src: immediate number (uint64_t bit map)
+    // dst: register
+    *(uint64_t *)(dst_od->value) = (src_od->value);
+    increase_pc();
+    clear_flags();
+}
 
-    // popq %rbp
-    uint64_t rsp_pa = va2pa(cpu_reg.rsp);
-    uint64_t old_val = cpu_read64bits_dram(rsp_pa);
+static void push_reg_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: register
+    // dst: empty
+    // rsp is updated after the translation, which may page fault
+    store64(cpu_reg.rsp - 8, *(uint64_t *)(src_od->value));
+    cpu_reg.rsp = cpu_reg.rsp - 8;
+    increase_pc();
+    clear_flags();
+}
+
+static void pop_reg_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: register
+    // dst: empty
+    uint64_t old_val = load64(cpu_reg.rsp);
     cpu_reg.rsp = cpu_reg.rsp + 8;
+    *(uint64_t *)(src_od->value) = old_val;
+    increase_pc();
+    clear_flags();
+}
+
+static void leave_handler(od_t *src_od, od_t *dst_od)
+{
+    // movq %rbp, %rsp
+    // popq %rbp
+    // the registers are updated after the translation, which may page fault
+    uint64_t old_val = load64(cpu_reg.rbp);
+    cpu_reg.rsp = cpu_reg.rbp + 8;
     cpu_reg.rbp = old_val;
     increase_pc();
-    cpu_flags.__flags_value = 0;
+    clear_flags();
 }
 
-void call_handler(od_t *src_od, od_t *dst_od)
+static void call_handler(od_t *src_od, od_t *dst_od)
 {
     // src: immediate number: virtual address of target function starting
     // dst: empty
     // push the return value
+    store64(cpu_reg.rsp - 8, cpu_pc.rip + inst_length);
     cpu_reg.rsp = cpu_reg.rsp - 8;
-    uint64_t rsp_pa = va2pa(cpu_reg.rsp);
-    cpu_write64bits_dram(
-        rsp_pa,
-        cpu_pc.rip + sizeof(char) * MAX_INSTRUCTION_CHAR);
+
     // jump to target function address
-    // TODO: support PC relative addressing
+    // the relative target of machine code is resolved in decoding
     cpu_pc.rip = (src_od->value);
-    cpu_flags.__flags_value = 0;
+    clear_flags();
 }
 
-void ret_handler(od_t *src_od, od_t *dst_od)
+static void ret_handler(od_t *src_od, od_t *dst_od)
 {
     // src: empty
     // dst: empty
     // pop rsp
-    uint64_t rsp_pa = va2pa(cpu_reg.rsp);
-    uint64_t ret_addr = cpu_read64bits_dram(rsp_pa);
+    uint64_t ret_addr = load64(cpu_reg.rsp);
     cpu_reg.rsp = cpu_reg.rsp + 8;
     // jump to return address
     cpu_pc.rip = ret_addr;
-    cpu_flags.__flags_value = 0;
-}
-
-void add_handler(od_t *src_od, od_t *dst_od)
-{
-    if (src_od->type == OD_REG && dst_od->type == OD_REG)
-    {
-        // src: register (value: int64_t bit map)
-        // dst: register (value: int64_t bit map)
-        uint64_t val = *(uint64_t *)(dst_od->value) + *(uint64_t *)(src_od->value);
-
-        int val_sign = ((val >> 63) & 0x1);
-        int src_sign = ((*(uint64_t *)(src_od->value) >> 63) & 0x1);
-        int dst_sign = ((*(uint64_t *)(dst_od->value) >> 63) & 0x1);
-
-        // set condition flags
-        cpu_flags.CF = (val < *(uint64_t *)(src_od->value)); // unsigned
-        cpu_flags.ZF = (val == 0);
-        cpu_flags.SF = val_sign;
-        cpu_flags.OF = (src_sign == 0 && dst_sign == 0 && val_sign == 1) || (src_sign == 1 && dst_sign == 1 && val_sign == 0);
-
-        // update registers
-        *(uint64_t *)(dst_od->value) = val;
-        // signed and unsigned value follow the same addition. e.g.
-        // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
-        increase_pc();
-        return;
-    }
+    clear_flags();
 }
 
-void sub_handler(od_t *src_od, od_t *dst_od)
+static void add_reg_reg_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_IMM && dst_od->type == OD_REG)
-    {
-        // src: register (value: int64_t bit map)
-        // dst: register (value: int64_t bit map)
-        // (dst_od->value) = (dst_od->value) - (src_od->value) = (dst_od->value) + (-(src_od->value))
-        uint64_t val = *(uint64_t *)(dst_od->value) + (~(src_od->value) + 1);
+    // src: register (value: int64_t bit map)
+    // dst: register (value: int64_t bit map)
+    uint64_t src = *(uint64_t *)(src_od->value);
+    uint64_t dst = *(uint64_t *)(dst_od->value);
+    uint64_t val = dst + src;
 
-        int val_sign = ((val >> 63) & 0x1);
-        int src_sign = (((src_od->value) >> 63) & 0x1);
-        int dst_sign = ((*(uint64_t *)(dst_od->value) >> 63) & 0x1);
+    // set condition flags
+    set_lazy_flags(FLAGS_ADD, src, dst, val);
 
-        // set condition flags
-        cpu_flags.CF = (val > *(uint64_t *)(dst_od->value)); // unsigned
+    // update registers
+    *(uint64_t *)(dst_od->value) = val;
+    // signed and unsigned value follow the same addition. e.g.
+    // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
+    increase_pc();
+}
 
-        cpu_flags.ZF = (val == 0);
-        cpu_flags.SF = val_sign;
+static void sub_imm_reg_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: immediate number (value: int64_t bit map)
+    // dst: register (value: int64_t bit map)
+    // (dst_od->value) = (dst_od->value) - (src_od->value) = (dst_od->value) + (-(src_od->value))
+    uint64_t dst = *(uint64_t *)(dst_od->value);
+    uint64_t val = dst + (~(src_od->value) + 1);
 
-        cpu_flags.OF = (src_sign == 1 && dst_sign == 0 && val_sign == 1) || (src_sign == 0 && dst_sign == 1 && val_sign == 0);
+    // set condition flags
+    set_lazy_flags(FLAGS_SUB, src_od->value, dst, val);
 
-        // update registers
-        *(uint64_t *)(dst_od->value) = val;
-        // signed and unsigned value follow the same addition. e.g.
-        // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
-        increase_pc();
-        return;
-    }
+    // update registers
+    *(uint64_t *)(dst_od->value) = val;
+    // signed and unsigned value follow the same addition. e.g.
+    // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
+    increase_pc();
 }
 
-void cmp_handler(od_t *src_od, od_t *dst_od)
+static void cmp_imm_mem_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_IMM && dst_od->type == OD_MEM)
-    {
-        // src: register (value: int64_t bit map)
-        // dst: register (value: int64_t bit map)
-        // (dst_od->value) = (dst_od->value) - (src_od->value) = (dst_od->value) + (-(src_od->value))
-        uint64_t dst_pa = va2pa(dst_od->value);
-        uint64_t dval = cpu_read64bits_dram(dst_pa);
-        uint64_t val = dval + (~(src_od->value) + 1);
-
-        int val_sign = ((val >> 63) & 0x1);
-        int src_sign = (((src_od->value) >> 63) & 0x1);
-        int dst_sign = ((dval >> 63) & 0x1);
-
-        // set condition flags
-        cpu_flags.CF = (val > dval); // unsigned
+    // src: immediate number (value: int64_t bit map)
+    // dst: virtual address (value: int64_t bit map)
+    // (dst_od->value) = (dst_od->value) - (src_od->value) = (dst_od->value) + (-(src_od->value))
+    uint64_t dval = load64(compute_effective_address(dst_od));
 
-        cpu_flags.ZF = (val == 0);
-        cpu_flags.SF = val_sign;
+    uint64_t val = dval + (~(src_od->value) + 1);
 
-        cpu_flags.OF = (src_sign == 1 && dst_sign == 0 && val_sign == 1) || (src_sign == 0 && dst_sign == 1 && val_sign == 0);
+    // set condition flags
+    set_lazy_flags(FLAGS_SUB, src_od->value, dval, val);
 
-        // signed and unsigned value follow the same addition. e.g.
-        // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
-        increase_pc();
-        return;
-    }
+    // signed and unsigned value follow the same addition. e.g.
+    // 5 = 0000000000000101, 3 = 0000000000000011, -3 = 1111111111111101, 5 + (-3) = 0000000000000010
+    increase_pc();
 }
 
-void jne_handler(od_t *src_od, od_t *dst_od)
+static void jne_handler(od_t *src_od, od_t *dst_od)
 {
     // src_od is actually a instruction memory address
     // but we are interpreting it as an immediate number
-    if (cpu_flags.ZF == 0)
+    if (read_zero_flag() == 0)
     {
         // last instruction value != 0
         cpu_pc.rip = (src_od->value);
@@ -272,55 +322,394 @@ void jne_handler(od_t *src_od, od_t *dst_od)
         // last instruction value == 0
         increase_pc();
     }
-    cpu_flags.__flags_value = 0;
+    clear_flags();
 }
 
-void jmp_handler(od_t *src_od, od_t *dst_od)
+static void jmp_handler(od_t *src_od, od_t *dst_od)
 {
     cpu_pc.rip = (src_od->value);
-    cpu_flags.__flags_value = 0;
+    clear_flags();
+}
+
+static void lea_mem_reg_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: virtual address - The effective address computed from instruction
+    // dst: register - The register to load the effective address
+    *(uint64_t *)(dst_od->value) = compute_effective_address(src_od);
+    increase_pc();
+    clear_flags();
 }
 
-void lea_handler(od_t *src_od, od_t *dst_od)
+static void int_imm_handler(od_t *src_od, od_t *dst_od)
 {
-    if (src_od->type == OD_MEM && dst_od->type == OD_REG)
+    // src: interrupt vector
+
+    // Be careful here. Think why we need to increase RIP before interrupt?
+    // This `int` instruction is executed by process 1,
+    // but interrupt will cause OS's scheduling to process 2.
+    // So this `int_imm_handler` will not return.
+    // When the execution of process 1 resumed, the system call is finished.
+    // We want to execute the next instruction, so RIP pushed to trap frame
+    // must be the next instruction.
+    increase_pc();
+    clear_flags();
+
+    // This function will not return.
+    interrupt_stack_switching(src_od->value);
+}
+
+// string operations: the direction flag is not modelled, always forward
+//
+// The %rcx elements are split at the page boundaries of both %rsi and %rdi.
+// Each piece is translated once and accessed by DRAM in bulk, so copying
+// a page costs 2 translations instead of 1024.
+// The registers are updated after each piece, as the hardware does after
+// each element. If a page fault happens in the middle, the instruction is
+// re-executed with the remaining elements.
+
+// the number of whole elements before the next page boundary
+static inline uint64_t elements_in_page(uint64_t vaddr, uint64_t width)
+{
+    return (PAGE_SIZE - (vaddr & (PAGE_SIZE - 1))) / width;
+}
+
+static void rep_movs(uint64_t width)
+{
+    while (cpu_reg.rcx != 0)
     {
-        // src: virtual address - The effective address computed from instruction
-        // dst: register - The register to load the effective address
-        *(uint64_t *)(dst_od->value) = src_od->value;
-        increase_pc();
-        cpu_flags.__flags_value = 0;
-        return;
+        uint64_t count = cpu_reg.rcx;
+        uint64_t n = elements_in_page(cpu_reg.rsi, width);
+        count = n < count ? n : count;
+        n = elements_in_page(cpu_reg.rdi, width);
+        count = n < count ? n : count;
+
+        if (count == 0)
+        {
+            // the element crosses the page boundary: translate all bytes
+            // before moving any, so a page fault leaves memory unchanged
+            uint64_t src_pa[8], dst_pa[8];
+            for (uint64_t i = 0; i < width; ++ i)
+            {
+                src_pa[i] = va2pa(cpu_reg.rsi + i);
+                dst_pa[i] = va2pa_write(cpu_reg.rdi + i);
+            }
+            for (uint64_t i = 0; i < width; ++ i)
+            {
+                cpu_movs_dram(dst_pa[i], src_pa[i], 1, 1);
+            }
+            count = 1;
+        }
+        else
+        {
+            uint64_t src_pa = va2pa(cpu_reg.rsi);
+            uint64_t dst_pa = va2pa_write(cpu_reg.rdi);
+            cpu_movs_dram(dst_pa, src_pa, count * width, width);
+        }
+
+        cpu_reg.rsi += count * width;
+        cpu_reg.rdi += count * width;
+        cpu_reg.rcx -= count;
     }
+    increase_pc();
+    clear_flags();
 }
 
-void int_handler(od_t *src_od, od_t *dst_od)
+static void rep_stos(uint64_t width, uint64_t data)
 {
-    if (src_od->type == OD_IMM)
+    while (cpu_reg.rcx != 0)
     {
-        // src: interrupt vector
-
-        // Be careful here. Think why we need to increase RIP before interrupt?
-        // This `int` instruction is executed by process 1,
-        // but interrupt will cause OS's scheduling to process 2.
-        // So this `int_handler` will not return.
-        // When the execution of process 1 resumed, the system call is finished.
-        // We want to execute the next instruction, so RIP pushed to trap frame
-        // must be the next instruction.
-        increase_pc();
-        cpu_flags.__flags_value = 0;
+        uint64_t count = cpu_reg.rcx;
+        uint64_t n = elements_in_page(cpu_reg.rdi, width);
+        count = n < count ? n : count;
+
+        if (count == 0)
+        {
+            uint64_t dst_pa[8];
+            for (uint64_t i = 0; i < width; ++ i)
+            {
+                dst_pa[i] = va2pa_write(cpu_reg.rdi + i);
+            }
+            for (uint64_t i = 0; i < width; ++ i)
+            {
+                cpu_stos_dram(dst_pa[i], data >> (i * 8), 1, 1);
+            }
+            count = 1;
+        }
+        else
+        {
+            cpu_stos_dram(va2pa_write(cpu_reg.rdi), data, count * width, width);
+        }
 
-        // This function will not return.
-        interrupt_stack_switching(src_od->value);
+        cpu_reg.rdi += count * width;
+        cpu_reg.rcx -= count;
     }
+    increase_pc();
+    clear_flags();
+}
+
+static void rep_movsb_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: (%rsi)
+    // dst: (%rdi)
+    rep_movs(1);
+}
+
+static void rep_movsq_handler(od_t *src_od, od_t *dst_od)
+{
+    rep_movs(8);
+}
+
+static void rep_stosb_handler(od_t *src_od, od_t *dst_od)
+{
+    // src: %al
+    // dst: (%rdi)
+    rep_stos(1, cpu_reg.al);
+}
+
+static void rep_stosq_handler(od_t *src_od, od_t *dst_od)
+{
+    rep_stos(8, cpu_reg.rax);
+}
+
+// the handler is selected in decoding by the operator and operand types
+static const op_t handler_table[NUM_HANDLER] =
+{
+    [HANDLER_ILLEGAL]       = NULL,
+    [HANDLER_MOV_REG_REG]   = &mov_reg_reg_handler,
+    [HANDLER_MOV_REG_MEM]   = &mov_reg_mem_handler,
+    [HANDLER_MOV_MEM_REG]   = &mov_mem_reg_handler,
+    [HANDLER_MOV_IMM_REG]   = &mov_imm_reg_handler,
+    [HANDLER_PUSH_REG]      = &push_reg_handler,
+    [HANDLER_POP_REG]       = &pop_reg_handler,
+    [HANDLER_LEAVE]         = &leave_handler,
+    [HANDLER_CALL]          = &call_handler,
+    [HANDLER_RET]           = &ret_handler,
+    [HANDLER_ADD_REG_REG]   = &add_reg_reg_handler,
+    [HANDLER_SUB_IMM_REG]   = &sub_imm_reg_handler,
+    [HANDLER_CMP_IMM_MEM]   = &cmp_imm_mem_handler,
+    [HANDLER_JNE]           = &jne_handler,
+    [HANDLER_JMP]           = &jmp_handler,
+    [HANDLER_LEA_MEM_REG]   = &lea_mem_reg_handler,
+    [HANDLER_INT_IMM]       = &int_imm_handler,
+    [HANDLER_REP_MOVSB]     = &rep_movsb_handler,
+    [HANDLER_REP_MOVSQ]     = &rep_movsq_handler,
+    [HANDLER_REP_STOSB]     = &rep_stosb_handler,
+    [HANDLER_REP_STOSQ]     = &rep_stosq_handler,
+};
+
+#ifdef USE_PROFILER
+// from profile.c
+uint64_t profile_clock();
+void profile_enter(uint64_t rip);
+void profile_exit(handler_type_t handler, uint64_t start);
+
+static inline void dispatch_instruction(inst_t *inst);
+
+// EXECUTE: the profiled handler, timed unless it does not return
+static inline void execute_instruction(inst_t *inst)
+{
+    uint64_t start = profile_clock();
+    dispatch_instruction(inst);
+    profile_exit(inst->handler, start);
+}
+
+static inline void dispatch_instruction(inst_t *inst)
+#else
+// EXECUTE: update CPU and memory according the instruction
+static inline void execute_instruction(inst_t *inst)
+#endif
+{
+#ifdef USE_SWITCH_DISPATCH
+    // the handlers are static in this file and can be inlined,
+    // so the indirect call is replaced by the jump table of switch
+    switch (inst->handler)
+    {
+        case HANDLER_MOV_REG_REG:
+            mov_reg_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_MOV_REG_MEM:
+            mov_reg_mem_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_MOV_MEM_REG:
+            mov_mem_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_MOV_IMM_REG:
+            mov_imm_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_PUSH_REG:
+            push_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_POP_REG:
+            pop_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_LEAVE:
+            leave_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_CALL:
+            call_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_RET:
+            ret_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_ADD_REG_REG:
+            add_reg_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_SUB_IMM_REG:
+            sub_imm_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_CMP_IMM_MEM:
+            cmp_imm_mem_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_JNE:
+            jne_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_JMP:
+            jmp_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_LEA_MEM_REG:
+            lea_mem_reg_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_INT_IMM:
+            int_imm_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_REP_MOVSB:
+            rep_movsb_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_REP_MOVSQ:
+            rep_movsq_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_REP_STOSB:
+            rep_stosb_handler(&(inst->src), &(inst->dst));
+            return;
+        case HANDLER_REP_STOSQ:
+            rep_stosq_handler(&(inst->src), &(inst->dst));
+            return;
+
+        default:
+            assert(0);
+    }
+#else
+    handler_table[inst->handler](&(inst->src), &(inst->dst));
+#endif
 }
 
 // from inst.c
 void parse_instruction(char *inst_str, inst_t *inst);
 
+// from decode.c
+uint64_t decode_instruction(uint8_t *code, uint64_t size, uint64_t vaddr, inst_t *inst,
+    void (*read_next_page)(uint64_t vaddr, uint8_t *buf, uint64_t size));
+
+#ifdef USE_DECODE_CACHE
+int read_decode_cache(uint64_t paddr, inst_t *inst);
+void write_decode_cache(uint64_t paddr, inst_t *inst);
+#endif
+
 // time, the craft of god
-static uint64_t global_time = 0;
-static uint64_t timer_period = 5;
+static CORE_LOCAL uint64_t global_time = 0;
+static CORE_LOCAL uint64_t timer_period = 5;
+// instructions to be executed before the next timer interrupt
+static CORE_LOCAL uint64_t timer_countdown = 5;
+
+// check timer interrupt from APIC after each instruction
+// counting down is cheaper than the modulo of global time
+static inline void tick_timer()
+{
+    timer_countdown -= 1;
+    if (timer_countdown == 0)
+    {
+        timer_countdown = timer_period;
+        interrupt_stack_switching(0x81);
+    }
+}
+
+// the timer is saved and restored with the machine
+void read_timer(uint64_t *time, uint64_t *countdown)
+{
+    *time = global_time;
+    *countdown = timer_countdown;
+}
+
+void write_timer(uint64_t time, uint64_t countdown)
+{
+    global_time = time;
+    timer_countdown = countdown;
+}
+
+// the rest bytes of the instruction crossing the page boundary
+static void read_next_code_page(uint64_t vaddr, uint8_t *buf, uint64_t size)
+{
+    cpu_readcode_dram(va2pa_fetch(vaddr), buf, size);
+}
+
+// FETCH and DECODE the machine code pointed by the program counter
+static inline void fetch_machine_code(inst_t *inst)
+{
+    // x86-64 instruction is at most 15 bytes
+    // the instruction is decoded from the current page first, and the
+    // next page is translated only if the instruction does cross it
+    uint8_t code[16];
+    uint64_t size = PAGE_SIZE - (cpu_pc.rip & (PAGE_SIZE - 1));
+    if (size > 15)
+    {
+        size = 15;
+    }
+    uint64_t pc_pa = va2pa_fetch(cpu_pc.rip);
+#ifdef USE_TRACE
+    trace_fetch(cpu_pc.rip, pc_pa);
+#endif
+    cpu_readcode_dram(pc_pa, code, size);
+
+    inst_length = decode_instruction(code, size, cpu_pc.rip, inst, &read_next_code_page);
+
+#ifdef DEBUG_INSTRUCTION_CYCLE
+    printf("%8lx    ", cpu_pc.rip);
+    for (int i = 0; i < inst_length; ++ i)
+    {
+        printf("%02x ", code[i]);
+    }
+    printf("\n");
+#endif
+}
+
+// FETCH and DECODE the instruction pointed by the program counter
+static inline void fetch_instruction(inst_t *inst)
+{
+    if (cpu_inst_encoding == INST_ENCODING_BINARY)
+    {
+        fetch_machine_code(inst);
+        return;
+    }
+    inst_length = MAX_INSTRUCTION_CHAR;
+
+    // FETCH: get the instruction string by program counter
+    char inst_str[MAX_INSTRUCTION_CHAR + 10];
+    uint64_t pc_pa = va2pa_fetch(cpu_pc.rip);
+
+#ifdef USE_TRACE
+    trace_fetch(cpu_pc.rip, pc_pa);
+#endif
+
+#ifdef DEBUG_INSTRUCTION_CYCLE
+    printf("%8lx    %s\n", cpu_pc.rip, (char *)&pm[pc_pa]);
+#endif
+
+#ifdef USE_DECODE_CACHE
+    // DECODE CACHE: a hit skips both the fetching and the parsing
+    // the instruction page is still referenced by the translation above
+    if (read_decode_cache(pc_pa, inst) == 0)
+    {
+        cpu_readinst_dram(pc_pa, inst_str);
+        parse_instruction(inst_str, inst);
+        write_decode_cache(pc_pa, inst);
+    }
+#else
+    cpu_readinst_dram(pc_pa, inst_str);
+
+    // DECODE: decode the run-time instruction operands
+    parse_instruction(inst_str, inst);
+#endif
+}
 
 // instruction cycle is implemented in CPU
 // the only exposed interface outside CPU
@@ -336,26 +725,324 @@ void instruction_cycle()
 
     global_time += 1;
 
-    // FETCH: get the instruction string by program counter
-    char inst_str[MAX_INSTRUCTION_CHAR + 10];
-    uint64_t pc_pa = va2pa(cpu_pc.rip);
-    cpu_readinst_dram(pc_pa, inst_str);
-
-#ifdef DEBUG_INSTRUCTION_CYCLE
-    printf("%8lx    %s\n", cpu_pc.rip, inst_str);
+#ifdef USE_PROFILER
+    profile_enter(cpu_pc.rip);
+#endif
+#ifdef USE_TRACE
+    trace_instruction(cpu_pc.rip);
+#endif
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_INSTRUCTION);
 #endif
 
-    // DECODE: decode the run-time instruction operands
     inst_t inst;
-    parse_instruction(inst_str, &inst);
+    fetch_instruction(&inst);
 
-    // EXECUTE: get the function pointer or handler by the operator
-    // update CPU and memory according the instruction
-    inst.op(&(inst.src), &(inst.dst));
+    // EXECUTE: the handler is selected in decoding
+    execute_instruction(&inst);
     
-    // check timer interrupt from APIC
-    if ((global_time % timer_period) == 0)
+    tick_timer();
+}
+
+// run at most max_instructions instruction cycles
+// setjmp saves all registers, so the entry point of interrupt return
+// is set once per run and once per interrupt, not per instruction
+void cpu_run(uint64_t max_instructions)
+{
+    // not modified after setjmp, so it is kept after longjmp
+    uint64_t end_time = global_time + max_instructions;
+
+    // the entry point of interrupt return, the same as instruction_cycle
+    setjmp(USER_INSTRUCTION_ON_IRET);
+
+    while (global_time < end_time)
     {
-        interrupt_stack_switching(0x81);
+#ifdef USE_SMP
+        // another core may be replacing a page cached by the TLB
+        smp_check_stop();
+#endif
+        global_time += 1;
+
+#ifdef USE_PROFILER
+        profile_enter(cpu_pc.rip);
+#endif
+#ifdef USE_TRACE
+        trace_instruction(cpu_pc.rip);
+#endif
+#ifdef USE_CYCLE_MODEL
+        cycle_charge(CYCLE_INSTRUCTION);
+#endif
+
+        inst_t inst;
+        fetch_instruction(&inst);
+        execute_instruction(&inst);
+
+        tick_timer();
+    }
+}
+
+#if defined(USE_BLOCK_CACHE) && defined(USE_DECODE_CACHE)
+/*======================================*/
+/*      basic block cache               */
+/*======================================*/
+
+// A basic block is a run of consecutive instructions ending at a control
+// transfer (jmp, jne, call, ret, int). The instructions of a block are
+// decoded once and kept in the block, so executing a cached block costs
+// one address translation and one lookup instead of one per instruction.
+// A block never crosses a page, so all its instructions are in the same
+// physical page, which is translated at the entry of the block.
+//
+// The block is recorded lazily during its first execution: the bytes
+// after the last executed instruction may not be code at all.
+
+#define MAX_BLOCK_INSTRUCTION (16)
+#define BLOCK_CACHE_INDEX_LENGTH (8)
+
+typedef struct BLOCK_STRUCT
+{
+    int         valid;
+    int         closed;     // 1 if the block reaches its end, 0 if still recording
+    uint64_t    vaddr;      // guest rip of the first instruction
+    uint64_t    paddr;      // physical address of the first instruction
+    uint64_t    cr3;        // the address space in which vaddr is translated
+    uint64_t    version;    // the code version of the physical page
+    uint64_t    generation; // mmu_generation when vaddr is translated
+    int         count;
+    inst_t      inst[MAX_BLOCK_INSTRUCTION];
+
+    // direct links to the successors: [0] for jump target, [1] for fall through
+    struct BLOCK_STRUCT *next[2];
+
+#ifdef USE_JIT
+    uint64_t    hits;       // executions of the closed block
+    jit_code_t  code;       // compiled when the block is hot
+#endif
+} block_t;
+
+static CORE_LOCAL block_t block_cache[(1 << BLOCK_CACHE_INDEX_LENGTH)];
+
+// the last completely executed block, whose successor will be linked
+static CORE_LOCAL block_t *prev_block = NULL;
+
+// from inst.c
+uint64_t read_code_version(uint64_t ppn);
+
+#ifdef USE_JIT
+// a closed block is compiled after this number of executions
+#define JIT_THRESHOLD (16)
+
+// from jit.c
+int jit_reserve();
+jit_code_t jit_compile(inst_t *inst, int count, uint64_t vaddr,
+    uint64_t *time, uint64_t *countdown);
+int jit_run(jit_code_t code);
+#endif
+
+static inline int is_block_end(inst_t *inst)
+{
+    return inst->opcode == INST_JMP || inst->opcode == INST_JNE ||
+        inst->opcode == INST_CALL || inst->opcode == INST_RET ||
+        inst->opcode == INST_INT;
+}
+
+static inline int is_block_latest(block_t *block)
+{
+    return block->version == read_code_version(block->paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
+}
+
+static block_t *lookup_block()
+{
+    // follow the direct link of the previous block
+    // skipping both the address translation and the cache lookup.
+    // After any invalidation, the block is translated again, so MMU
+    // sets the reference bit of its page cleared by the OS
+    if (prev_block != NULL)
+    {
+        for (int i = 0; i < 2; ++ i)
+        {
+            block_t *next = prev_block->next[i];
+            if (next != NULL && next->valid == 1 &&
+                next->vaddr == cpu_pc.rip && next->cr3 == cpu_controls.cr3 &&
+                next->generation == mmu_generation && is_block_latest(next))
+            {
+                return next;
+            }
+        }
     }
+
+    uint64_t pc_pa = va2pa_fetch(cpu_pc.rip);
+#ifdef USE_TRACE
+    trace_fetch(cpu_pc.rip, pc_pa);
+#endif
+    block_t *block = &block_cache[(pc_pa / MAX_INSTRUCTION_CHAR) & ((1 << BLOCK_CACHE_INDEX_LENGTH) - 1)];
+
+    if (block->valid == 0 || block->paddr != pc_pa ||
+        block->vaddr != cpu_pc.rip || is_block_latest(block) == 0)
+    {
+        // block cache miss: start recording a new block at this slot
+        block->valid = 1;
+        block->closed = 0;
+        block->vaddr = cpu_pc.rip;
+        block->paddr = pc_pa;
+        block->version = read_code_version(pc_pa >> PHYSICAL_PAGE_OFFSET_LENGTH);
+        block->count = 0;
+        block->next[0] = NULL;
+        block->next[1] = NULL;
+#ifdef USE_JIT
+        block->hits = 0;
+        block->code = NULL;
+#endif
+    }
+    // the physical address is the same in any address space
+    block->cr3 = cpu_controls.cr3;
+    block->generation = mmu_generation;
+
+    // link the previous block to this one
+    if (prev_block != NULL)
+    {
+        if (cpu_pc.rip == prev_block->vaddr + prev_block->count * MAX_INSTRUCTION_CHAR * sizeof(char))
+        {
+            prev_block->next[1] = block;
+        }
+        else
+        {
+            prev_block->next[0] = block;
+        }
+    }
+    return block;
 }
+
+// append the next instruction to a recording block
+static void record_block_instruction(block_t *block)
+{
+    uint64_t paddr = block->paddr + block->count * MAX_INSTRUCTION_CHAR * sizeof(char);
+    inst_t *inst = &block->inst[block->count];
+
+    if (read_decode_cache(paddr, inst) == 0)
+    {
+        char inst_str[MAX_INSTRUCTION_CHAR + 10];
+        cpu_readinst_dram(paddr, inst_str);
+        parse_instruction(inst_str, inst);
+        write_decode_cache(paddr, inst);
+    }
+    block->count += 1;
+
+    uint64_t next_vaddr = block->vaddr + block->count * MAX_INSTRUCTION_CHAR * sizeof(char);
+    if (is_block_end(inst) == 1 ||
+        block->count == MAX_BLOCK_INSTRUCTION ||
+        (next_vaddr & (PAGE_SIZE - 1)) == 0)
+    {
+        block->closed = 1;
+    }
+}
+
+// execute one basic block
+// the timer interrupt is still checked after each instruction
+void block_cycle()
+{
+    // an interrupt returns here in the newly scheduled process
+    // the address space may be changed, so the direct link is dropped
+    if (setjmp(USER_INSTRUCTION_ON_IRET) != 0)
+    {
+        prev_block = NULL;
+    }
+
+    if (cpu_inst_encoding == INST_ENCODING_BINARY)
+    {
+        // the blocks are built upon the fixed-length assembly strings
+        prev_block = NULL;
+        instruction_cycle();
+        return;
+    }
+    inst_length = MAX_INSTRUCTION_CHAR;
+
+    block_t *block = lookup_block();
+    prev_block = NULL;
+
+#ifdef USE_JIT
+    if (block->closed == 1 && block->code == NULL)
+    {
+        block->hits += 1;
+        if (block->hits == JIT_THRESHOLD)
+        {
+            if (jit_reserve() == 1)
+            {
+                // the code buffer is recycled, the other blocks count again
+                // to be compiled into the new buffer
+                for (int i = 0; i < (1 << BLOCK_CACHE_INDEX_LENGTH); ++ i)
+                {
+                    if (&block_cache[i] != block)
+                    {
+                        block_cache[i].hits = 0;
+                    }
+                    block_cache[i].code = NULL;
+                }
+            }
+            block->code = jit_compile(block->inst, block->count, block->vaddr,
+                &global_time, &timer_countdown);
+        }
+    }
+
+    if (block->code != NULL)
+    {
+        // the page faults in the compiled code return to setjmp above
+        int complete = jit_run(block->code);
+        if (is_block_latest(block) == 0)
+        {
+            // the block modified its own code
+            block->valid = 0;
+            complete = 0;
+        }
+        if (timer_countdown == 0)
+        {
+            // counted down in the compiled code
+            timer_countdown = timer_period;
+            interrupt_stack_switching(0x81);
+        }
+        if (complete == 1)
+        {
+            prev_block = block;
+        }
+        return;
+    }
+#endif
+
+    for (int i = 0; i < block->count || block->closed == 0; ++ i)
+    {
+        if (i == block->count)
+        {
+            record_block_instruction(block);
+        }
+
+        global_time += 1;
+
+#ifdef DEBUG_INSTRUCTION_CYCLE
+        printf("%8lx    %s\n", cpu_pc.rip, (char *)&pm[block->paddr + i * MAX_INSTRUCTION_CHAR]);
+#endif
+
+#ifdef USE_PROFILER
+        profile_enter(cpu_pc.rip);
+#endif
+#ifdef USE_TRACE
+        trace_instruction(cpu_pc.rip);
+#endif
+#ifdef USE_CYCLE_MODEL
+        cycle_charge(CYCLE_INSTRUCTION);
+#endif
+
+        execute_instruction(&block->inst[i]);
+
+        if (is_block_latest(block) == 0)
+        {
+            // the block modified its own code
+            block->valid = 0;
+            return;
+        }
+
+        tick_timer();
+    }
+
+    prev_block = block;
+}
+#endif
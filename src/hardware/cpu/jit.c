@@ -0,0 +1,580 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/softmmu.h"
+
+#ifdef USE_JIT
+/*======================================*/
+/*      compiled basic blocks           */
+/*======================================*/
+
+// The hot basic blocks of the block cache are compiled to host x86-64 code.
+// The guest registers, flags, rip and timer are kept in memory, the compiled
+// code loads and stores them as the handlers do. So when a page fault or an
+// interrupt jumps out of the compiled code by longjmp, the state in memory
+// is exactly the state of the interpreter at the faulting instruction:
+//
+//  -   rip is stored before each translation, which may page fault.
+//      The registers are updated after the translation, so the faulting
+//      instruction is executed again from the beginning.
+//  -   global time and timer are counted down after each instruction.
+//      When the timer runs out, rip of the next instruction is stored and
+//      the compiled code returns, the interrupt is raised by the caller.
+//
+// The memory accesses look up the softmmu TLB inline, only the misses
+// call the fill functions of softmmu. A write to the page holding decoded
+// instructions always misses, and requests to leave the block after it.
+
+#if !defined(__x86_64__)
+#error "the compiled code is x86-64"
+#endif
+
+#ifndef USE_SOFTMMU
+#error "the compiled code looks up the softmmu TLB"
+#endif
+
+#define JIT_BUFFER_SIZE (1 << 20)
+// the maximal code size of a block of MAX_BLOCK_INSTRUCTION instructions
+#define JIT_MAX_BLOCK_CODE (8192)
+
+// registers of the host
+#define HOST_RAX (0)
+#define HOST_RCX (1)
+#define HOST_RDX (2)
+#define HOST_RBX (3)
+#define HOST_RDI (7)
+
+static CORE_LOCAL uint8_t *jit_buffer = NULL;
+static CORE_LOCAL uint64_t jit_used = 0;
+static CORE_LOCAL uint64_t jit_blocks = 0;
+
+// the code being emitted
+static CORE_LOCAL uint8_t *emit_code = NULL;
+static CORE_LOCAL uint64_t emit_pos = 0;
+// the address of cpu_reg, to which the core local state is addressed
+static CORE_LOCAL uint8_t *emit_base = NULL;
+
+/*======================================*/
+/*      x86-64 emitter                  */
+/*======================================*/
+
+// the compiled code is called with the address of cpu_reg in %rdi,
+// kept in %rbx, and all the core local state is addressed relative to it
+
+static int32_t offset_of(void *addr)
+{
+    int64_t offset = (int64_t)((uint64_t)addr - (uint64_t)emit_base);
+    assert(INT32_MIN <= offset && offset <= INT32_MAX);
+    return (int32_t)offset;
+}
+
+static void emit_byte(uint8_t byte)
+{
+    emit_code[emit_pos] = byte;
+    emit_pos += 1;
+}
+
+static void emit_int32(int32_t value)
+{
+    memcpy(&emit_code[emit_pos], &value, 4);
+    emit_pos += 4;
+}
+
+static void emit_int64(uint64_t value)
+{
+    memcpy(&emit_code[emit_pos], &value, 8);
+    emit_pos += 8;
+}
+
+// op reg, qword [rbx + offset]
+// 0x8b: mov load, 0x89: mov store, 0x03: add
+static void emit_rbx(uint8_t opcode, int reg, void *addr)
+{
+    emit_byte(0x48);
+    emit_byte(opcode);
+    emit_byte(0x80 | (reg << 3) | HOST_RBX);
+    emit_int32(offset_of(addr));
+}
+
+// op qword [rbx + offset], imm8
+// extension 0: add, 5: sub, 7: cmp
+static void emit_rbx_imm8(int extension, void *addr, int8_t imm)
+{
+    emit_byte(0x48);
+    emit_byte(0x83);
+    emit_byte(0x80 | (extension << 3) | HOST_RBX);
+    emit_int32(offset_of(addr));
+    emit_byte((uint8_t)imm);
+}
+
+// mov dword or qword [rbx + offset], imm32
+static void emit_store_imm32(void *addr, int32_t imm, int qword)
+{
+    if (qword == 1)
+    {
+        emit_byte(0x48);
+    }
+    emit_byte(0xc7);
+    emit_byte(0x80 | HOST_RBX);
+    emit_int32(offset_of(addr));
+    emit_int32(imm);
+}
+
+// movabs reg, imm64
+static void emit_movabs(int reg, uint64_t imm)
+{
+    emit_byte(0x48);
+    emit_byte(0xb8 + reg);
+    emit_int64(imm);
+}
+
+// op dst, src
+// 0x89: mov, 0x01: add, 0x29: sub
+static void emit_reg_reg(uint8_t opcode, int dst, int src)
+{
+    emit_byte(0x48);
+    emit_byte(opcode);
+    emit_byte(0xc0 | (src << 3) | dst);
+}
+
+// the forward jumps with 8-bit displacement
+// 0x74: je, 0x75: jne, 0xeb: jmp
+static uint64_t emit_jump8(uint8_t opcode)
+{
+    emit_byte(opcode);
+    emit_byte(0);
+    return emit_pos;
+}
+
+static void patch_jump8(uint64_t from)
+{
+    uint64_t distance = emit_pos - from;
+    assert(distance < 128);
+    emit_code[from - 1] = (uint8_t)distance;
+}
+
+static void emit_store_rip(uint64_t rip)
+{
+    emit_movabs(HOST_RAX, rip);
+    emit_rbx(0x89, HOST_RAX, &cpu_pc.rip);
+}
+
+// return from the compiled code, 1 if the block is completed
+static void emit_return(int complete)
+{
+    emit_byte(0xb8);        // mov eax, imm32
+    emit_int32(complete);
+    emit_byte(0x5b);        // pop rbx
+    emit_byte(0xc3);        // ret
+}
+
+/*======================================*/
+/*      instructions                    */
+/*======================================*/
+
+// the flags known in compiling, to skip the redundant stores
+typedef enum
+{
+    JIT_FLAGS_UNKNOWN,
+    JIT_FLAGS_CLEARED,
+    JIT_FLAGS_LAZY,     // lazy_result in memory is the latest
+} jit_flags_t;
+
+static CORE_LOCAL jit_flags_t emit_flags = JIT_FLAGS_UNKNOWN;
+
+static void emit_clear_flags()
+{
+    if (emit_flags != JIT_FLAGS_CLEARED)
+    {
+        emit_store_imm32(&cpu_flags.__flags_value, 0, 1);
+        emit_store_imm32(&cpu_flags.lazy_op, FLAGS_EVALUATED, 0);
+        emit_flags = JIT_FLAGS_CLEARED;
+    }
+}
+
+// src in rdx, dst in rax, result in rcx
+static void emit_lazy_flags(flags_op_t op)
+{
+    emit_rbx(0x89, HOST_RDX, &cpu_flags.lazy_src);
+    emit_rbx(0x89, HOST_RAX, &cpu_flags.lazy_dst);
+    emit_rbx(0x89, HOST_RCX, &cpu_flags.lazy_result);
+    emit_store_imm32(&cpu_flags.lazy_op, op, 0);
+    emit_flags = JIT_FLAGS_LAZY;
+}
+
+// the effective address of the memory operand to rdi
+static void emit_effective_address(od_t *od)
+{
+    if ((int64_t)od->value == (int32_t)od->value)
+    {
+        // mov rdi, simm32
+        emit_byte(0x48);
+        emit_byte(0xc7);
+        emit_byte(0xc0 | HOST_RDI);
+        emit_int32((int32_t)od->value);
+    }
+    else
+    {
+        emit_movabs(HOST_RDI, od->value);
+    }
+    if (od->reg1 != 0)
+    {
+        emit_rbx(0x03, HOST_RDI, (void *)od->reg1);
+    }
+    if (od->reg2 != 0)
+    {
+        emit_rbx(0x8b, HOST_RAX, (void *)od->reg2);
+        // imul rax, rax, imm32
+        emit_byte(0x48);
+        emit_byte(0x69);
+        emit_byte(0xc0);
+        emit_int32((int32_t)od->scal);
+        emit_reg_reg(0x01, HOST_RDI, HOST_RAX);
+    }
+}
+
+// translate the virtual address in rdi to the host address in rax
+// the registers of the caller are not preserved
+static void emit_translate(int write, uint64_t rip)
+{
+    uint64_t *tag = write == 1 ? &softmmu_tlb[0].write_tag : &softmmu_tlb[0].read_tag;
+    assert(sizeof(softmmu_entry_t) == 32);
+
+    // rax = vpn + 1, rcx = rbx + index * sizeof(softmmu_entry_t)
+    emit_reg_reg(0x89, HOST_RAX, HOST_RDI);
+    emit_byte(0x48); emit_byte(0xc1); emit_byte(0xe8);     // shr rax, 12
+    emit_byte(PHYSICAL_PAGE_OFFSET_LENGTH);
+    emit_reg_reg(0x89, HOST_RCX, HOST_RAX);
+    emit_byte(0x48); emit_byte(0x81); emit_byte(0xe1);     // and rcx, imm32
+    emit_int32((1 << SOFTMMU_INDEX_LENGTH) - 1);
+    emit_byte(0x48); emit_byte(0xc1); emit_byte(0xe1);     // shl rcx, 5
+    emit_byte(5);
+    emit_reg_reg(0x01, HOST_RCX, HOST_RBX);
+    emit_byte(0x48); emit_byte(0xff); emit_byte(0xc0);     // inc rax
+
+    // cmp rax, [rcx + tag]
+    emit_byte(0x48); emit_byte(0x3b); emit_byte(0x81);
+    emit_int32(offset_of(tag));
+    uint64_t miss = emit_jump8(0x75);
+
+    // hit: rax = page + (vaddr & 0xfff)
+    emit_reg_reg(0x89, HOST_RAX, HOST_RDI);
+    emit_byte(0x48); emit_byte(0x25);                       // and rax, imm32
+    emit_int32(PAGE_SIZE - 1);
+    emit_byte(0x48); emit_byte(0x03); emit_byte(0x81);     // add rax, [rcx + page]
+    emit_int32(offset_of(&softmmu_tlb[0].page));
+    uint64_t done = emit_jump8(0xeb);
+
+    // miss: va2pa may page fault, which returns to the faulting instruction
+    patch_jump8(miss);
+    emit_store_rip(rip);
+    emit_movabs(HOST_RAX, write == 1 ? (uint64_t)&softmmu_fill_write : (uint64_t)&softmmu_fill_read);
+    emit_byte(0xff); emit_byte(0xd0);                       // call rax
+
+    patch_jump8(done);
+}
+
+// emit one instruction, return 1 if it writes the memory
+static int emit_instruction(inst_t *inst, uint64_t rip, uint64_t next_rip)
+{
+    od_t *src = &inst->src;
+    od_t *dst = &inst->dst;
+
+    switch (inst->handler)
+    {
+        case HANDLER_MOV_REG_REG:
+            emit_rbx(0x8b, HOST_RAX, (void *)src->value);
+            emit_rbx(0x89, HOST_RAX, (void *)dst->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_MOV_IMM_REG:
+            emit_movabs(HOST_RAX, src->value);
+            emit_rbx(0x89, HOST_RAX, (void *)dst->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_MOV_REG_MEM:
+            emit_effective_address(dst);
+            emit_translate(1, rip);
+            emit_rbx(0x8b, HOST_RDX, (void *)src->value);
+            emit_byte(0x48); emit_byte(0x89); emit_byte(0x10);     // mov [rax], rdx
+            emit_clear_flags();
+            return 1;
+        case HANDLER_MOV_MEM_REG:
+            emit_effective_address(src);
+            emit_translate(0, rip);
+            emit_byte(0x48); emit_byte(0x8b); emit_byte(0x00);     // mov rax, [rax]
+            emit_rbx(0x89, HOST_RAX, (void *)dst->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_LEA_MEM_REG:
+            emit_effective_address(src);
+            emit_rbx(0x89, HOST_RDI, (void *)dst->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_PUSH_REG:
+            emit_rbx(0x8b, HOST_RDI, &cpu_reg.rsp);
+            emit_byte(0x48); emit_byte(0x83); emit_byte(0xef); emit_byte(8);   // sub rdi, 8
+            emit_translate(1, rip);
+            emit_rbx(0x8b, HOST_RDX, (void *)src->value);
+            emit_byte(0x48); emit_byte(0x89); emit_byte(0x10);     // mov [rax], rdx
+            emit_rbx_imm8(5, &cpu_reg.rsp, 8);
+            emit_clear_flags();
+            return 1;
+        case HANDLER_POP_REG:
+            emit_rbx(0x8b, HOST_RDI, &cpu_reg.rsp);
+            emit_translate(0, rip);
+            emit_byte(0x48); emit_byte(0x8b); emit_byte(0x00);     // mov rax, [rax]
+            emit_rbx_imm8(0, &cpu_reg.rsp, 8);
+            emit_rbx(0x89, HOST_RAX, (void *)src->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_LEAVE:
+            emit_rbx(0x8b, HOST_RDI, &cpu_reg.rbp);
+            emit_translate(0, rip);
+            emit_byte(0x48); emit_byte(0x8b); emit_byte(0x00);     // mov rax, [rax]
+            emit_rbx(0x8b, HOST_RDX, &cpu_reg.rbp);
+            emit_byte(0x48); emit_byte(0x83); emit_byte(0xc2); emit_byte(8);   // add rdx, 8
+            emit_rbx(0x89, HOST_RDX, &cpu_reg.rsp);
+            emit_rbx(0x89, HOST_RAX, &cpu_reg.rbp);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_CALL:
+            emit_rbx(0x8b, HOST_RDI, &cpu_reg.rsp);
+            emit_byte(0x48); emit_byte(0x83); emit_byte(0xef); emit_byte(8);   // sub rdi, 8
+            emit_translate(1, rip);
+            emit_movabs(HOST_RDX, next_rip);
+            emit_byte(0x48); emit_byte(0x89); emit_byte(0x10);     // mov [rax], rdx
+            emit_rbx_imm8(5, &cpu_reg.rsp, 8);
+            emit_store_rip(src->value);
+            emit_clear_flags();
+            return 1;
+        case HANDLER_RET:
+            emit_rbx(0x8b, HOST_RDI, &cpu_reg.rsp);
+            emit_translate(0, rip);
+            emit_byte(0x48); emit_byte(0x8b); emit_byte(0x00);     // mov rax, [rax]
+            emit_rbx_imm8(0, &cpu_reg.rsp, 8);
+            emit_rbx(0x89, HOST_RAX, &cpu_pc.rip);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_ADD_REG_REG:
+            emit_rbx(0x8b, HOST_RDX, (void *)src->value);
+            emit_rbx(0x8b, HOST_RAX, (void *)dst->value);
+            emit_reg_reg(0x89, HOST_RCX, HOST_RAX);
+            emit_reg_reg(0x01, HOST_RCX, HOST_RDX);
+            emit_lazy_flags(FLAGS_ADD);
+            emit_rbx(0x89, HOST_RCX, (void *)dst->value);
+            return 0;
+        case HANDLER_SUB_IMM_REG:
+            emit_movabs(HOST_RDX, src->value);
+            emit_rbx(0x8b, HOST_RAX, (void *)dst->value);
+            emit_reg_reg(0x89, HOST_RCX, HOST_RAX);
+            emit_reg_reg(0x29, HOST_RCX, HOST_RDX);
+            emit_lazy_flags(FLAGS_SUB);
+            emit_rbx(0x89, HOST_RCX, (void *)dst->value);
+            return 0;
+        case HANDLER_CMP_IMM_MEM:
+            emit_effective_address(dst);
+            emit_translate(0, rip);
+            emit_byte(0x48); emit_byte(0x8b); emit_byte(0x00);     // mov rax, [rax]
+            emit_movabs(HOST_RDX, src->value);
+            emit_reg_reg(0x89, HOST_RCX, HOST_RAX);
+            emit_reg_reg(0x29, HOST_RCX, HOST_RDX);
+            emit_lazy_flags(FLAGS_SUB);
+            return 0;
+        case HANDLER_JMP:
+            emit_store_rip(src->value);
+            emit_clear_flags();
+            return 0;
+        case HANDLER_JNE:
+            if (emit_flags == JIT_FLAGS_CLEARED)
+            {
+                // ZF is 0, always taken
+                emit_store_rip(src->value);
+                return 0;
+            }
+            if (emit_flags == JIT_FLAGS_UNKNOWN)
+            {
+                // cmp dword [lazy_op], FLAGS_EVALUATED
+                emit_byte(0x83); emit_byte(0xbb);
+                emit_int32(offset_of(&cpu_flags.lazy_op));
+                emit_byte(FLAGS_EVALUATED);
+                uint64_t lazy = emit_jump8(0x75);
+                // cmp word [ZF], 1: not equal if ZF is 0
+                emit_byte(0x66); emit_byte(0x83); emit_byte(0xbb);
+                emit_int32(offset_of(&cpu_flags.ZF));
+                emit_byte(1);
+                uint64_t decide = emit_jump8(0xeb);
+                patch_jump8(lazy);
+                emit_rbx_imm8(7, &cpu_flags.lazy_result, 0);
+                patch_jump8(decide);
+            }
+            else
+            {
+                emit_rbx_imm8(7, &cpu_flags.lazy_result, 0);
+            }
+            // taken if not equal: the result is not zero
+            emit_movabs(HOST_RAX, next_rip);
+            emit_movabs(HOST_RDX, src->value);
+            emit_byte(0x48); emit_byte(0x0f); emit_byte(0x45); emit_byte(0xc2);   // cmovne rax, rdx
+            emit_rbx(0x89, HOST_RAX, &cpu_pc.rip);
+            emit_clear_flags();
+            return 0;
+        default:
+            // int and string operations are left to the interpreter
+            assert(0);
+    }
+    return 0;
+}
+
+int jit_is_supported(inst_t *inst)
+{
+    switch (inst->handler)
+    {
+        case HANDLER_MOV_REG_REG:
+        case HANDLER_MOV_IMM_REG:
+        case HANDLER_MOV_REG_MEM:
+        case HANDLER_MOV_MEM_REG:
+        case HANDLER_LEA_MEM_REG:
+        case HANDLER_PUSH_REG:
+        case HANDLER_POP_REG:
+        case HANDLER_LEAVE:
+        case HANDLER_CALL:
+        case HANDLER_RET:
+        case HANDLER_ADD_REG_REG:
+        case HANDLER_SUB_IMM_REG:
+        case HANDLER_CMP_IMM_MEM:
+        case HANDLER_JMP:
+        case HANDLER_JNE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*======================================*/
+/*      interface                       */
+/*======================================*/
+
+// make room for one block in the code buffer
+// return 1 if all the compiled code is dropped
+int jit_reserve()
+{
+    if (jit_buffer == NULL)
+    {
+        jit_buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(jit_buffer != MAP_FAILED);
+        jit_used = 0;
+        emit_base = (uint8_t *)&cpu_reg;
+
+        return 1;
+    }
+    if (jit_used + JIT_MAX_BLOCK_CODE > JIT_BUFFER_SIZE)
+    {
+        jit_used = 0;
+        return 1;
+    }
+    return 0;
+}
+
+// compile count instructions starting at guest vaddr
+// the global time and timer countdown are counted by the compiled code
+// return NULL if some instruction is not supported
+jit_code_t jit_compile(inst_t *inst, int count, uint64_t vaddr,
+    uint64_t *time, uint64_t *countdown)
+{
+    for (int i = 0; i < count; ++ i)
+    {
+        if (jit_is_supported(&inst[i]) == 0)
+        {
+            return NULL;
+        }
+    }
+    assert(jit_buffer != NULL && jit_used + JIT_MAX_BLOCK_CODE <= JIT_BUFFER_SIZE);
+
+    emit_code = &jit_buffer[jit_used];
+    emit_pos = 0;
+
+    emit_flags = JIT_FLAGS_UNKNOWN;
+
+    emit_byte(0x53);                                        // push rbx
+    emit_reg_reg(0x89, HOST_RBX, HOST_RDI);
+
+    for (int i = 0; i < count; ++ i)
+    {
+        uint64_t rip = vaddr + i * MAX_INSTRUCTION_CHAR;
+        uint64_t next_rip = rip + MAX_INSTRUCTION_CHAR;
+
+        emit_rbx_imm8(0, time, 1);
+        int write = emit_instruction(&inst[i], rip, next_rip);
+        emit_rbx_imm8(5, countdown, 1);
+
+        if (i == count - 1)
+        {
+            // the control transfer has updated rip
+            if (inst[i].opcode != INST_JMP && inst[i].opcode != INST_JNE &&
+                inst[i].opcode != INST_CALL && inst[i].opcode != INST_RET)
+            {
+                emit_store_rip(next_rip);
+            }
+            emit_return(1);
+            break;
+        }
+
+        // leave the block if the timer runs out, or the code is written
+        uint64_t next;
+        if (write == 1)
+        {
+            uint64_t timer = emit_jump8(0x74);
+            emit_byte(0x80); emit_byte(0xbb);               // cmp byte [exit_request], 0
+            emit_int32(offset_of(&softmmu_code_written));
+            emit_byte(0);
+            next = emit_jump8(0x74);
+            patch_jump8(timer);
+        }
+        else
+        {
+            next = emit_jump8(0x75);
+        }
+        emit_store_rip(next_rip);
+        emit_return(0);
+        patch_jump8(next);
+    }
+    assert(emit_pos <= JIT_MAX_BLOCK_CODE);
+
+    jit_used += (emit_pos + 15) & ~15ul;
+    jit_blocks += 1;
+    return (jit_code_t)emit_code;
+}
+
+// run the compiled block, return 1 if it is completed,
+// 0 if it is left early for the timer or the modified code
+int jit_run(jit_code_t code)
+{
+    int complete = code((uint8_t *)&cpu_reg);
+    softmmu_code_written = 0;
+    return complete;
+}
+
+uint64_t jit_compiled_blocks()
+{
+    return jit_blocks;
+}
+#endif
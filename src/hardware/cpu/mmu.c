@@ -11,24 +11,33 @@
 // Memory Management Unit 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "headers/cpu.h"
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/address.h"
 #include "headers/interrupt.h"
+#include "headers/trace.h"
+#include "headers/cycle.h"
+#include "headers/log.h"
+#include "headers/softmmu.h"
 
 // -------------------------------------------- //
 // TLB cache struct
 // -------------------------------------------- //
 
+#ifndef NUM_TLB_CACHE_LINE_PER_SET
 #define NUM_TLB_CACHE_LINE_PER_SET (8)
+#endif
 
 typedef struct 
 {
     int valid;
+    uint64_t asid;  // the address space of the translation
     uint64_t tag;
     uint64_t ppn;
+    int dirty;      // the dirty bit of the page table entry is set
 } tlb_cacheline_t;
 
 typedef struct
@@ -41,22 +50,141 @@ typedef struct
     tlb_cacheset_t sets[(1 << TLB_CACHE_INDEX_LENGTH)];
 } tlb_cache_t;
 
-static tlb_cache_t mmu_tlb;
+static CORE_LOCAL tlb_cache_t mmu_tlb;
+
+#ifdef USE_HUGE_PAGE
+// the 2MB pages are cached in another fully associative TLB,
+// looked up together with the 4KB TLB
+#ifndef NUM_HUGE_TLB_CACHE_LINE
+#define NUM_HUGE_TLB_CACHE_LINE (8)
+#endif
+
+// the tag is the virtual 2MB page number, ppn is the first physical page
+static CORE_LOCAL tlb_cacheline_t mmu_huge_tlb[NUM_HUGE_TLB_CACHE_LINE];
+
+#define HUGE_PAGE_OFFSET_LENGTH (21)
+
+static int read_huge_tlb(uint64_t vaddr_value, int write, uint64_t *paddr_value_ptr);
+static void write_huge_tlb(uint64_t vaddr_value, uint64_t paddr_value, int dirty);
+#endif
+
+#ifdef USE_PAGE_WALK_CACHE
+// Paging-structure cache: the PGD, PUD and PMD entries recently walked,
+// as the PML4, PDPTE and PDE caches of x86-64. The cache of each level
+// is direct-mapped and tagged by the virtual page number bits above the
+// level. The line holds the next level table, so a TLB miss in a seen
+// 1GB or 2MB region starts the walk from the PMD or the PT.
+#ifndef PAGE_WALK_CACHE_INDEX_LENGTH
+#define PAGE_WALK_CACHE_INDEX_LENGTH (3)
+#endif
+
+typedef struct
+{
+    int valid;
+    uint64_t asid;
+    uint64_t tag;       // vpn1 for PGD, vpn1:vpn2 for PUD, vpn1:vpn2:vpn3 for PMD
+    pte123_t *table;    // the next level table
+} page_walk_cacheline_t;
+
+static CORE_LOCAL page_walk_cacheline_t mmu_page_walk_cache[3][(1 << PAGE_WALK_CACHE_INDEX_LENGTH)];
+static CORE_LOCAL page_walk_stat_t mmu_page_walk_stat;
+
+// the virtual page number bits above the next level of the level
+// level 0 - PGD: 39, level 1 - PUD: 30, level 2 - PMD: 21
+static inline uint64_t page_walk_cache_tag(int level, uint64_t vaddr_value)
+{
+    return vaddr_value >> (VIRTUAL_PAGE_OFFSET_LENGTH + (3 - level) * VIRTUAL_PAGE_NUMBER_LENGTH);
+}
+
+static inline page_walk_cacheline_t *get_page_walk_cacheline(int level, uint64_t vaddr_value)
+{
+    uint64_t tag = page_walk_cache_tag(level, vaddr_value);
+    return &mmu_page_walk_cache[level][tag & ((1 << PAGE_WALK_CACHE_INDEX_LENGTH) - 1)];
+}
+
+static void invalidate_page_walk_cache(uint64_t asid);
+#endif
+
+#ifdef USE_TLB_HIERARCHY
+// The TLBs of the core, as Intel cores since Nehalem:
+//  -   L1 iTLB: the translations of the instruction fetch
+//  -   L1 dTLB: the translations of the data accesses
+//  -   L2 STLB: shared by the fetch and the data, looked up on L1 misses
+// The geometry and the replacement of each level are set at runtime by
+// tlb_configure. The lines are tagged by the whole virtual page number,
+// so the number of sets is not bound to the bits of address_t.
+
+#if !defined(USE_TLB_HARDWARE) || !defined(USE_PAGETABLE_VA2PA)
+#error "TLB hierarchy caches the translations of page table"
+#endif
 
-static uint64_t page_walk(uint64_t vaddr_value);
+typedef struct
+{
+    int valid;
+    uint64_t asid;
+    uint64_t vpn;
+    uint64_t ppn;
+    int dirty;
+    uint64_t time;      // LRU: the last access
+} tlb_entry_t;
+
+typedef struct
+{
+    tlb_geometry_t geometry;
+    tlb_entry_t *lines;     // num_sets * num_ways
+    uint64_t *plru;         // PLRU: the tree of num_ways - 1 bits of each set
+    uint64_t clock;
+    tlb_level_stat_t stat;
+} tlb_level_t;
+
+// Skylake: 128 entries of iTLB, 64 of dTLB, and 1536 of STLB
+static const tlb_config_t default_tlb_config = {
+    .itlb = {.num_sets = 16,    .num_ways = 8,  .replacement = TLB_PLRU},
+    .dtlb = {.num_sets = 16,    .num_ways = 4,  .replacement = TLB_PLRU},
+    .stlb = {.num_sets = 128,   .num_ways = 12, .replacement = TLB_LRU},
+};
+
+static CORE_LOCAL tlb_level_t mmu_itlb, mmu_dtlb, mmu_stlb;
+static CORE_LOCAL int tlb_configured = 0;
+
+static int read_tlb_hierarchy(uint64_t vaddr_value, int fetch, int write, uint64_t *paddr_value_ptr);
+static void write_tlb_hierarchy(uint64_t vaddr_value, int fetch, int dirty, uint64_t paddr_value);
+static void flush_tlb_hierarchy();
+static void invalidate_tlb_hierarchy_page(uint64_t asid, uint64_t vpn);
+static void invalidate_tlb_hierarchy_asid(uint64_t asid);
+#endif
+
+static uint64_t page_walk(uint64_t vaddr_value, int write, int *hugepage);
 static void page_fault_handler(pte4_t *pte, address_t vaddr);
 
-static int read_tlb(uint64_t vaddr_value, uint64_t *paddr_value_ptr,
+static int read_tlb(uint64_t vaddr_value, int write, uint64_t *paddr_value_ptr,
     int *free_tlb_line_index);
-static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value, 
+static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value, int dirty,
     int free_tlb_line_index);
 
 int swap_in(uint64_t daddr, uint64_t ppn);
 int swap_out(uint64_t daddr, uint64_t ppn);
 
+#ifdef USE_PROFILER
+void profile_tlb_miss();
+#endif
+
 // consider this function va2pa as functional
-uint64_t va2pa(uint64_t vaddr)
+// fetch is 1 if the address is of the instruction
+// write is 1 if the page is written, then MMU sets its dirty bit
+//
+// MMU sets the reference bit of PTE when the translation is walked,
+// i.e., filled to TLB, and the dirty bit on the first write through
+// the TLB line: the line filled by read is clean, and the write hit
+// on it is taken as a miss to walk again. So the OS finds the used
+// pages by the bits, without any bookkeeping on the accesses.
+static uint64_t translate(uint64_t vaddr, int fetch, int write)
 {
+#ifdef USE_TRACE
+    // the physical address is traced when the memory is accessed
+    trace_translation(vaddr);
+#endif
+
 #ifdef USE_NAVIE_VA2PA
     return vaddr % PHYSICAL_MEMORY_SPACE;
 #endif
@@ -64,21 +192,41 @@ uint64_t va2pa(uint64_t vaddr)
 
 #if defined(USE_TLB_HARDWARE) && defined(USE_PAGETABLE_VA2PA)
     int free_tlb_line_index = -1;
-    int tlb_hit = read_tlb(vaddr, &paddr, &free_tlb_line_index);
+#ifdef USE_TLB_HIERARCHY
+    int tlb_hit = read_tlb_hierarchy(vaddr, fetch, write, &paddr);
+#else
+    int tlb_hit = read_tlb(vaddr, write, &paddr, &free_tlb_line_index);
+#endif
+#ifdef USE_HUGE_PAGE
+    if (tlb_hit == 0)
+    {
+        tlb_hit = read_huge_tlb(vaddr, write, &paddr);
+    }
+#endif
 
     // TODO: add flag to read tlb failed
     if (tlb_hit)
     {
         // TLB read hit
+#ifdef USE_CYCLE_MODEL
+        cycle_charge(CYCLE_TLB_HIT);
+#endif
         return paddr;
     }
 
     // TLB read miss
+#ifdef USE_PROFILER
+    profile_tlb_miss();
+#endif
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_TLB_MISS);
+#endif
 #endif
 
 #ifdef USE_PAGETABLE_VA2PA
     // assume that page_walk is consuming much time
-    paddr = page_walk(vaddr);
+    int hugepage = 0;
+    paddr = page_walk(vaddr, write, &hugepage);
 #endif
 
 #if defined(USE_TLB_HARDWARE) && defined(USE_PAGETABLE_VA2PA)
@@ -86,11 +234,24 @@ uint64_t va2pa(uint64_t vaddr)
     // TODO: check if this paddr from page table is a legal address
     if (paddr != 0)
     {
+#ifdef USE_HUGE_PAGE
+        if (hugepage == 1)
+        {
+            // one line for the whole 2MB
+            write_huge_tlb(vaddr, paddr, write);
+            return paddr;
+        }
+#endif
         // TLB write
-        if (write_tlb(vaddr, paddr, free_tlb_line_index) == 1)
+#ifdef USE_TLB_HIERARCHY
+        write_tlb_hierarchy(vaddr, fetch, write, paddr);
+        return paddr;
+#else
+        if (write_tlb(vaddr, paddr, write, free_tlb_line_index) == 1)
         {
             return paddr;
         }
+#endif
     }
 #endif
 
@@ -98,8 +259,248 @@ uint64_t va2pa(uint64_t vaddr)
     return paddr;
 }
 
+uint64_t va2pa(uint64_t vaddr)
+{
+    return translate(vaddr, 0, 0);
+}
+
+uint64_t va2pa_fetch(uint64_t vaddr)
+{
+    return translate(vaddr, 1, 0);
+}
+
+uint64_t va2pa_write(uint64_t vaddr)
+{
+    return translate(vaddr, 0, 1);
+}
+
+void tlb_flush_all()
+{
+    mmu_generation += 1;
+    memset(&mmu_tlb, 0, sizeof(tlb_cache_t));
+#ifdef USE_TLB_HIERARCHY
+    flush_tlb_hierarchy();
+#endif
+#ifdef USE_PAGE_WALK_CACHE
+    memset(&mmu_page_walk_cache, 0, sizeof(mmu_page_walk_cache));
+#endif
+#ifdef USE_HUGE_PAGE
+    memset(&mmu_huge_tlb, 0, sizeof(mmu_huge_tlb));
+#endif
+#ifdef USE_SOFTMMU
+    softmmu_flush();
+#endif
+}
+
+// the lines are tagged by ASID, so switching the address space needs
+// no flush. But the OS must invalidate the translation it changes.
+
+void tlb_invalidate_page(uint64_t asid, uint64_t vaddr_value)
+{
+    mmu_generation += 1;
+    address_t vaddr = {
+        .address_value = vaddr_value
+    };
+
+    tlb_cacheset_t *set = &mmu_tlb.sets[vaddr.tlbi];
+    for (int i = 0; i < NUM_TLB_CACHE_LINE_PER_SET; ++ i)
+    {
+        tlb_cacheline_t *line = &set->lines[i];
+        if (line->valid == 1 && line->tag == vaddr.tlbt && line->asid == asid)
+        {
+            line->valid = 0;
+        }
+    }
+#ifdef USE_TLB_HIERARCHY
+    invalidate_tlb_hierarchy_page(asid, vaddr_value >> PHYSICAL_PAGE_OFFSET_LENGTH);
+#endif
+
+#ifdef USE_PAGE_WALK_CACHE
+    // the upper level entries walked for vaddr
+    for (int i = 0; i < 3; ++ i)
+    {
+        page_walk_cacheline_t *line = get_page_walk_cacheline(i, vaddr_value);
+        if (line->asid == asid && line->tag == page_walk_cache_tag(i, vaddr_value))
+        {
+            line->valid = 0;
+        }
+    }
+#endif
+
+#ifdef USE_HUGE_PAGE
+    // the 2MB page translating vaddr
+    int hugepage = 0;
+    for (int i = 0; i < NUM_HUGE_TLB_CACHE_LINE; ++ i)
+    {
+        tlb_cacheline_t *line = &mmu_huge_tlb[i];
+        if (line->valid == 1 && line->asid == asid &&
+            line->tag == (vaddr_value >> HUGE_PAGE_OFFSET_LENGTH))
+        {
+            line->valid = 0;
+            hugepage = 1;
+        }
+    }
+#endif
+
+#ifdef USE_SOFTMMU
+    // softmmu only holds the translations of the running address space
+    if (asid == cpu_controls.asid)
+    {
+#ifdef USE_HUGE_PAGE
+        if (hugepage == 1)
+        {
+            // the 4KB entries of the 2MB page
+            softmmu_flush();
+            return;
+        }
+#endif
+        softmmu_invalidate_page(vaddr_value);
+    }
+#endif
+}
+
+void tlb_invalidate_asid(uint64_t asid)
+{
+    mmu_generation += 1;
+    for (int i = 0; i < (1 << TLB_CACHE_INDEX_LENGTH); ++ i)
+    {
+        for (int j = 0; j < NUM_TLB_CACHE_LINE_PER_SET; ++ j)
+        {
+            tlb_cacheline_t *line = &mmu_tlb.sets[i].lines[j];
+            if (line->asid == asid)
+            {
+                line->valid = 0;
+            }
+        }
+    }
+#ifdef USE_TLB_HIERARCHY
+    invalidate_tlb_hierarchy_asid(asid);
+#endif
+#ifdef USE_PAGE_WALK_CACHE
+    invalidate_page_walk_cache(asid);
+#endif
+#ifdef USE_HUGE_PAGE
+    for (int i = 0; i < NUM_HUGE_TLB_CACHE_LINE; ++ i)
+    {
+        if (mmu_huge_tlb[i].asid == asid)
+        {
+            mmu_huge_tlb[i].valid = 0;
+        }
+    }
+#endif
+
+#ifdef USE_SOFTMMU
+    if (asid == cpu_controls.asid)
+    {
+        softmmu_flush();
+    }
+#endif
+}
+
+#ifdef USE_SOFTMMU
+// -------------------------------------------- //
+// softmmu: TLB of host pointers
+// -------------------------------------------- //
+
+// The entries are filled on misses, after va2pa returns:
+//  -   the read entry after MMU sets the reference bit of the page
+//  -   the write entry after MMU sets the dirty bit, and only if the page
+//      holds no decoded instruction. So the writes to the code pages
+//      always take the slow path to invalidate the decode cache.
+// The hits skip MMU as the TLB hits skip the page table. The OS clears
+// the reference bit with the TLB line, so the next access misses again.
+//
+// Mapping a page adds a translation, which is found by the next miss,
+// so map_pte4 needs nothing. The entry is invalidated with the TLB line
+// on unmapping. CR3 switching flushes all, the entries have no ASID.
+
+#if defined(USE_SRAM_CACHE) || defined(USE_TRACE) || defined(USE_PROFILER) || \
+    defined(USE_CYCLE_MODEL) || defined(USE_SMP)
+#error "softmmu accesses the physical memory directly, without the models"
+#endif
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "softmmu loads and stores the guest little-endian data on host"
+#endif
+
+CORE_LOCAL softmmu_entry_t softmmu_tlb[(1 << SOFTMMU_INDEX_LENGTH)];
+CORE_LOCAL uint8_t softmmu_code_written = 0;
+
+// the physical pages holding decoded instructions
+static CORE_LOCAL uint8_t softmmu_code_page[PHYSICAL_MEMORY_SPACE / PAGE_SIZE];
+
+#ifdef USE_DECODE_CACHE
+// from inst.c
+void invalidate_decode_cache(uint64_t paddr, uint64_t size);
+#endif
+
+void softmmu_flush()
+{
+    memset(softmmu_tlb, 0, sizeof(softmmu_tlb));
+}
+
+void softmmu_invalidate_page(uint64_t vaddr)
+{
+    softmmu_entry_t *entry = get_softmmu_entry(vaddr);
+    if (entry->read_tag == SOFTMMU_TAG(vaddr))
+    {
+        entry->read_tag = 0;
+        entry->write_tag = 0;
+    }
+}
+
+void softmmu_protect_code_page(uint64_t ppn)
+{
+    if (softmmu_code_page[ppn] == 0)
+    {
+        softmmu_code_page[ppn] = 1;
+        for (int i = 0; i < (1 << SOFTMMU_INDEX_LENGTH); ++ i)
+        {
+            softmmu_tlb[i].write_tag = 0;
+        }
+    }
+}
+
+uint8_t *softmmu_fill_read(uint64_t vaddr)
+{
+    uint64_t paddr = va2pa(vaddr);
+    uint64_t tag = SOFTMMU_TAG(vaddr);
+
+    softmmu_entry_t *entry = get_softmmu_entry(vaddr);
+    if (entry->write_tag != tag)
+    {
+        entry->write_tag = 0;
+    }
+    entry->read_tag = tag;
+    entry->page = &pm[paddr & ~(uint64_t)(PAGE_SIZE - 1)];
+    return &pm[paddr];
+}
+
+uint8_t *softmmu_fill_write(uint64_t vaddr)
+{
+    uint64_t paddr = va2pa_write(vaddr);
+    uint64_t ppn = paddr >> PHYSICAL_PAGE_OFFSET_LENGTH;
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(paddr, 8);
+#endif
+
+    if (softmmu_code_page[ppn] == 1)
+    {
+        // the write may modify the executing instructions
+        softmmu_code_written = 1;
+        return &pm[paddr];
+    }
+
+    softmmu_entry_t *entry = get_softmmu_entry(vaddr);
+    entry->read_tag = SOFTMMU_TAG(vaddr);
+    entry->write_tag = SOFTMMU_TAG(vaddr);
+    entry->page = &pm[paddr & ~(uint64_t)(PAGE_SIZE - 1)];
+    return &pm[paddr];
+}
+#endif
+
 #if defined(USE_TLB_HARDWARE) && defined(USE_PAGETABLE_VA2PA)
-static int read_tlb(uint64_t vaddr_value, uint64_t *paddr_value_ptr, 
+static int read_tlb(uint64_t vaddr_value, int write, uint64_t *paddr_value_ptr,
     int *free_tlb_line_index)
 {
     address_t vaddr = {
@@ -119,20 +520,54 @@ static int read_tlb(uint64_t vaddr_value, uint64_t *paddr_value_ptr,
         }
 
         if (line->tag == vaddr.tlbt &&
+            line->asid == cpu_controls.asid &&
             line->valid == 1)
         {
+            if (write == 1 && line->dirty == 0)
+            {
+                // the first write walks to set the dirty bit,
+                // and refills this line
+                line->valid = 0;
+                *free_tlb_line_index = i;
+                break;
+            }
             // TLB read hit
-            *paddr_value_ptr = line->ppn;
+            *paddr_value_ptr = (line->ppn << PHYSICAL_PAGE_OFFSET_LENGTH) | vaddr.tlbo;
             return 1;
         }
     }
 
     // TLB read miss
-    *paddr_value_ptr = NULL;
+    *paddr_value_ptr = 0;
     return 0;
 }
 
-static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value, 
+#ifdef USE_TRACE
+// replay one translation from trace: the page table is not walked,
+// a miss fills the TLB with the traced physical address.
+// No dirty bit to set, so the lines are filled as dirty
+int replay_tlb(uint64_t vaddr, uint64_t paddr, int fetch)
+{
+    uint64_t tlb_paddr = 0;
+#ifdef USE_TLB_HIERARCHY
+    if (read_tlb_hierarchy(vaddr, fetch, 0, &tlb_paddr) == 1)
+    {
+        return 1;
+    }
+    write_tlb_hierarchy(vaddr, fetch, 1, paddr);
+#else
+    int free_tlb_line_index = -1;
+    if (read_tlb(vaddr, 0, &tlb_paddr, &free_tlb_line_index) == 1)
+    {
+        return 1;
+    }
+    write_tlb(vaddr, paddr, 1, free_tlb_line_index);
+#endif
+    return 0;
+}
+#endif
+
+static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value, int dirty,
     int free_tlb_line_index)
 {
     address_t vaddr = {
@@ -150,8 +585,10 @@ static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value,
         tlb_cacheline_t *line = &set->lines[free_tlb_line_index];
 
         line->valid = 1;
+        line->asid = cpu_controls.asid;
         line->ppn = paddr.ppn;
         line->tag = vaddr.tlbt;
+        line->dirty = dirty;
 
         return 1;
     }
@@ -162,17 +599,358 @@ static int write_tlb(uint64_t vaddr_value, uint64_t paddr_value,
     tlb_cacheline_t *line = &set->lines[random_victim_index];
 
     line->valid = 1;
+    line->asid = cpu_controls.asid;
     line->ppn = paddr.ppn;
     line->tag = vaddr.tlbt;
+    line->dirty = dirty;
+
+    return 1;
+}
+
+#ifdef USE_HUGE_PAGE
+static int read_huge_tlb(uint64_t vaddr_value, int write, uint64_t *paddr_value_ptr)
+{
+    for (int i = 0; i < NUM_HUGE_TLB_CACHE_LINE; ++ i)
+    {
+        tlb_cacheline_t *line = &mmu_huge_tlb[i];
+
+        if (line->tag == (vaddr_value >> HUGE_PAGE_OFFSET_LENGTH) &&
+            line->asid == cpu_controls.asid &&
+            line->valid == 1)
+        {
+            if (write == 1 && line->dirty == 0)
+            {
+                // walk to set the dirty bit of PMD entry
+                line->valid = 0;
+                break;
+            }
+            // TLB read hit
+            *paddr_value_ptr = (line->ppn << PHYSICAL_PAGE_OFFSET_LENGTH) |
+                (vaddr_value & (HUGE_PAGE_SIZE - 1));
+            return 1;
+        }
+    }
+
+    // TLB read miss
+    *paddr_value_ptr = 0;
+    return 0;
+}
+
+static void write_huge_tlb(uint64_t vaddr_value, uint64_t paddr_value, int dirty)
+{
+    tlb_cacheline_t *victim = NULL;
+    for (int i = 0; i < NUM_HUGE_TLB_CACHE_LINE; ++ i)
+    {
+        if (mmu_huge_tlb[i].valid == 0)
+        {
+            victim = &mmu_huge_tlb[i];
+            break;
+        }
+    }
+
+    if (victim == NULL)
+    {
+        // no free TLB cache line, select one RANDOM victim
+        victim = &mmu_huge_tlb[random() % NUM_HUGE_TLB_CACHE_LINE];
+    }
+
+    victim->valid = 1;
+    victim->asid = cpu_controls.asid;
+    victim->ppn = (paddr_value & ~(uint64_t)(HUGE_PAGE_SIZE - 1)) >> PHYSICAL_PAGE_OFFSET_LENGTH;
+    victim->tag = vaddr_value >> HUGE_PAGE_OFFSET_LENGTH;
+    victim->dirty = dirty;
+}
+#endif
+#endif
+
+#ifdef USE_TLB_HIERARCHY
+static void configure_level(tlb_level_t *level, const tlb_geometry_t *geometry)
+{
+    int num_sets = geometry->num_sets;
+    int num_ways = geometry->num_ways;
+    // the set is indexed by the low bits of VPN
+    assert(num_sets >= 0 && (num_sets & (num_sets - 1)) == 0);
+    assert(num_sets == 0 || num_ways > 0);
+    // the PLRU tree is binary and held in one uint64_t
+    assert(geometry->replacement != TLB_PLRU ||
+        ((num_ways & (num_ways - 1)) == 0 && num_ways <= 64));
+
+    free(level->lines);
+    free(level->plru);
+    memset(level, 0, sizeof(tlb_level_t));
+    level->geometry = *geometry;
+    if (num_sets > 0)
+    {
+        level->lines = calloc(num_sets * num_ways, sizeof(tlb_entry_t));
+        level->plru = calloc(num_sets, sizeof(uint64_t));
+    }
+}
+
+void tlb_configure(const tlb_config_t *config)
+{
+    // the L1 TLBs must exist, the STLB is optional
+    assert(config->itlb.num_sets > 0 && config->dtlb.num_sets > 0);
+    configure_level(&mmu_itlb, &config->itlb);
+    configure_level(&mmu_dtlb, &config->dtlb);
+    configure_level(&mmu_stlb, &config->stlb);
+    tlb_configured = 1;
+}
+
+void tlb_read_stat(tlb_stat_t *stat)
+{
+    stat->itlb = mmu_itlb.stat;
+    stat->dtlb = mmu_dtlb.stat;
+    stat->stlb = mmu_stlb.stat;
+}
+
+static inline void lazy_configure_tlb()
+{
+    if (tlb_configured == 0)
+    {
+        tlb_configure(&default_tlb_config);
+    }
+}
+
+static inline tlb_entry_t *get_tlb_set(tlb_level_t *level, uint64_t vpn)
+{
+    return &level->lines[(vpn & (level->geometry.num_sets - 1)) * level->geometry.num_ways];
+}
+
+// point the PLRU tree away from the accessed way
+static void update_replacement(tlb_level_t *level, uint64_t vpn, int way)
+{
+    uint64_t set_index = vpn & (level->geometry.num_sets - 1);
+    tlb_entry_t *set = get_tlb_set(level, vpn);
+
+    level->clock += 1;
+    set[way].time = level->clock;
+
+    if (level->geometry.replacement == TLB_PLRU)
+    {
+        uint64_t tree = level->plru[set_index];
+        int node = 0;
+        for (int half = level->geometry.num_ways >> 1; half > 0; half >>= 1)
+        {
+            // 0: the victim is on the left, 1: on the right
+            int right = (way & half) != 0;
+            if (right == 1)
+            {
+                tree &= ~((uint64_t)1 << node);
+            }
+            else
+            {
+                tree |= ((uint64_t)1 << node);
+            }
+            node = 2 * node + 1 + right;
+        }
+        level->plru[set_index] = tree;
+    }
+}
+
+static int select_victim(tlb_level_t *level, uint64_t vpn)
+{
+    tlb_entry_t *set = get_tlb_set(level, vpn);
+    int num_ways = level->geometry.num_ways;
+
+    for (int i = 0; i < num_ways; ++ i)
+    {
+        if (set[i].valid == 0)
+        {
+            return i;
+        }
+    }
+
+    level->stat.eviction += 1;
+    switch (level->geometry.replacement)
+    {
+        case TLB_LRU:
+        {
+            int victim = 0;
+            for (int i = 1; i < num_ways; ++ i)
+            {
+                if (set[i].time < set[victim].time)
+                {
+                    victim = i;
+                }
+            }
+            return victim;
+        }
+        case TLB_PLRU:
+        {
+            uint64_t tree = level->plru[vpn & (level->geometry.num_sets - 1)];
+            int node = 0;
+            int victim = 0;
+            for (int half = num_ways >> 1; half > 0; half >>= 1)
+            {
+                int right = (tree >> node) & 1;
+                victim += right * half;
+                node = 2 * node + 1 + right;
+            }
+            return victim;
+        }
+        case TLB_RANDOM:
+        default:
+            return random() % num_ways;
+    }
+}
+
+static tlb_entry_t *lookup_level(tlb_level_t *level, uint64_t vpn, int write)
+{
+    tlb_entry_t *set = get_tlb_set(level, vpn);
+    for (int i = 0; i < level->geometry.num_ways; ++ i)
+    {
+        if (set[i].valid == 1 && set[i].vpn == vpn && set[i].asid == cpu_controls.asid)
+        {
+            if (write == 1 && set[i].dirty == 0)
+            {
+                // the first write walks to set the dirty bit
+                set[i].valid = 0;
+                break;
+            }
+            level->stat.hit += 1;
+            update_replacement(level, vpn, i);
+            return &set[i];
+        }
+    }
+    level->stat.miss += 1;
+    return NULL;
+}
+
+static void fill_level(tlb_level_t *level, uint64_t vpn, uint64_t ppn, int dirty)
+{
+    int way = select_victim(level, vpn);
+    tlb_entry_t *line = &get_tlb_set(level, vpn)[way];
+    line->valid = 1;
+    line->asid = cpu_controls.asid;
+    line->vpn = vpn;
+    line->ppn = ppn;
+    line->dirty = dirty;
+    update_replacement(level, vpn, way);
+}
+
+static int read_tlb_hierarchy(uint64_t vaddr_value, int fetch, int write, uint64_t *paddr_value_ptr)
+{
+    lazy_configure_tlb();
+
+    uint64_t vpn = vaddr_value >> PHYSICAL_PAGE_OFFSET_LENGTH;
+    uint64_t vpo = vaddr_value & (PAGE_SIZE - 1);
+    tlb_level_t *l1 = fetch == 1 ? &mmu_itlb : &mmu_dtlb;
+
+    tlb_entry_t *line = lookup_level(l1, vpn, write);
+    if (line == NULL && mmu_stlb.geometry.num_sets > 0)
+    {
+        line = lookup_level(&mmu_stlb, vpn, write);
+        if (line != NULL)
+        {
+            // refill L1 from STLB
+#ifdef USE_CYCLE_MODEL
+            cycle_charge(CYCLE_STLB_HIT);
+#endif
+            fill_level(l1, vpn, line->ppn, line->dirty);
+        }
+    }
 
+    if (line == NULL)
+    {
+        *paddr_value_ptr = 0;
+        return 0;
+    }
+    *paddr_value_ptr = (line->ppn << PHYSICAL_PAGE_OFFSET_LENGTH) | vpo;
     return 1;
 }
+
+// the walked translation is filled to both L1 and STLB
+static void write_tlb_hierarchy(uint64_t vaddr_value, int fetch, int dirty, uint64_t paddr_value)
+{
+    lazy_configure_tlb();
+
+    uint64_t vpn = vaddr_value >> PHYSICAL_PAGE_OFFSET_LENGTH;
+    uint64_t ppn = paddr_value >> PHYSICAL_PAGE_OFFSET_LENGTH;
+    fill_level(fetch == 1 ? &mmu_itlb : &mmu_dtlb, vpn, ppn, dirty);
+    if (mmu_stlb.geometry.num_sets > 0)
+    {
+        fill_level(&mmu_stlb, vpn, ppn, dirty);
+    }
+}
+
+// all the address spaces
+static void flush_tlb_hierarchy()
+{
+    tlb_level_t *levels[3] = {&mmu_itlb, &mmu_dtlb, &mmu_stlb};
+    for (int i = 0; i < 3; ++ i)
+    {
+        if (levels[i]->lines != NULL)
+        {
+            memset(levels[i]->lines, 0,
+                levels[i]->geometry.num_sets * levels[i]->geometry.num_ways * sizeof(tlb_entry_t));
+        }
+    }
+}
+
+// only the set indexed by vpn may hold the page
+static void invalidate_tlb_hierarchy_page(uint64_t asid, uint64_t vpn)
+{
+    tlb_level_t *levels[3] = {&mmu_itlb, &mmu_dtlb, &mmu_stlb};
+    for (int i = 0; i < 3; ++ i)
+    {
+        if (levels[i]->geometry.num_sets == 0)
+        {
+            continue;
+        }
+        tlb_entry_t *set = get_tlb_set(levels[i], vpn);
+        for (int j = 0; j < levels[i]->geometry.num_ways; ++ j)
+        {
+            if (set[j].asid == asid && set[j].vpn == vpn)
+            {
+                set[j].valid = 0;
+            }
+        }
+    }
+}
+
+static void invalidate_tlb_hierarchy_asid(uint64_t asid)
+{
+    tlb_level_t *levels[3] = {&mmu_itlb, &mmu_dtlb, &mmu_stlb};
+    for (int i = 0; i < 3; ++ i)
+    {
+        tlb_level_t *level = levels[i];
+        for (int j = 0; j < level->geometry.num_sets * level->geometry.num_ways; ++ j)
+        {
+            if (level->lines[j].asid == asid)
+            {
+                level->lines[j].valid = 0;
+            }
+        }
+    }
+}
+#endif
+
+#ifdef USE_PAGE_WALK_CACHE
+static void invalidate_page_walk_cache(uint64_t asid)
+{
+    for (int i = 0; i < 3; ++ i)
+    {
+        for (int j = 0; j < (1 << PAGE_WALK_CACHE_INDEX_LENGTH); ++ j)
+        {
+            if (mmu_page_walk_cache[i][j].asid == asid)
+            {
+                mmu_page_walk_cache[i][j].valid = 0;
+            }
+        }
+    }
+}
+
+void page_walk_read_stat(page_walk_stat_t *stat)
+{
+    *stat = mmu_page_walk_stat;
+}
 #endif
 
 #ifdef USE_PAGETABLE_VA2PA
-// input - virtual address
-// output - physical address
-static uint64_t page_walk(uint64_t vaddr_value)
+// input - virtual address, and if it is written
+// output - physical address, and if it is in a 2MB page
+// the reference and dirty bits of the last level entry are set
+static uint64_t page_walk(uint64_t vaddr_value, int write, int *hugepage)
 {
     // parse address
     address_t vaddr = {
@@ -196,24 +974,74 @@ static uint64_t page_walk(uint64_t vaddr_value)
 
     int level = 0;
     pte123_t *tab = pgd;
+#ifdef USE_PAGE_WALK_CACHE
+    // start from the deepest level found: PMD, PUD, then PGD
+    mmu_page_walk_stat.walks += 1;
+    for (int i = 2; i >= 0; -- i)
+    {
+        page_walk_cacheline_t *line = get_page_walk_cacheline(i, vaddr_value);
+        if (line->valid == 1 && line->asid == cpu_controls.asid &&
+            line->tag == page_walk_cache_tag(i, vaddr_value))
+        {
+            mmu_page_walk_stat.hits[i] += 1;
+            tab = line->table;
+            level = i + 1;
+            break;
+        }
+    }
+#endif
     while (level < 3)
     {
         int vpn = vpns[level];
+#ifdef USE_PAGE_WALK_CACHE
+        mmu_page_walk_stat.table_reads += 1;
+#endif
+#ifdef USE_CYCLE_MODEL
+        // each level is one memory access of MMU
+        cycle_charge(CYCLE_PAGE_WALK);
+#endif
         if (tab[vpn].present != 1)
         {
             // page fault
-            printf("\033[31;1mMMU (%lx): level %d page fault: [%x].present == 0\n\033[0m", vaddr_value, level + 1, vpn);
+            LOG(LOG_MMU, LOG_DEBUG, "\033[31;1mMMU (%lx): level %ld page fault: [%lx].present == 0\n\033[0m", vaddr_value, level + 1, vpn);
             goto RAISE_PAGE_FAULT;
         }
 
+#ifdef USE_HUGE_PAGE
+        if (level == 2 && tab[vpn].hugepage == 1)
+        {
+            // PMD maps the 2MB page, 3 levels are walked
+            *hugepage = 1;
+            tab[vpn].reference = 1;
+            tab[vpn].dirty |= write;
+            return tab[vpn].paddr + (vaddr_value & (HUGE_PAGE_SIZE - 1));
+        }
+#endif
+
         // move to next level
         tab = (pte123_t *)((uint64_t)tab[vpn].paddr);
+#ifdef USE_PAGE_WALK_CACHE
+        page_walk_cacheline_t *line = get_page_walk_cacheline(level, vaddr_value);
+        line->valid = 1;
+        line->asid = cpu_controls.asid;
+        line->tag = page_walk_cache_tag(level, vaddr_value);
+        line->table = tab;
+#endif
         level += 1;
     }
 
     pte4_t *pte = &((pte4_t *)tab)[vaddr.vpn4];
+#ifdef USE_PAGE_WALK_CACHE
+    mmu_page_walk_stat.table_reads += 1;
+#endif
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_PAGE_WALK);
+#endif
     if (pte->present == 1)
     {
+        pte->reference = 1;
+        pte->dirty |= write;
+
         // find page table entry
         address_t paddr = {
             .ppn = pte->ppn,
@@ -223,7 +1051,7 @@ static uint64_t page_walk(uint64_t vaddr_value)
     }
     else
     {
-        printf("\033[31;1mMMU (%lx): level 4 page fault: [%x].present == 0\n\033[0m", vaddr_value, vaddr.vpn4);
+        LOG(LOG_MMU, LOG_DEBUG, "\033[31;1mMMU (%lx): level 4 page fault: [%lx].present == 0\n\033[0m", vaddr_value, vaddr.vpn4);
     }
 
 RAISE_PAGE_FAULT:
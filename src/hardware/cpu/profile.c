@@ -0,0 +1,460 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "headers/cpu.h"
+#include "headers/common.h"
+#include "headers/instruction.h"
+
+#ifdef USE_PROFILER
+/*======================================*/
+/*      guest instruction profiler      */
+/*======================================*/
+
+// The profiler counts what the guest executes, not the host:
+//  1.  per-RIP: executions, handler cycles, memory accesses, TLB and
+//      SRAM cache misses, kept in an open-addressed table by guest rip
+//  2.  per-handler: executions and host cycles spent in the handler
+//  3.  per-block: the instruction starting a basic block (after a control
+//      transfer) counts the block entries and the instructions of the block
+//  4.  per-stack: a shadow call stack following call/ret, each executed
+//      instruction is a sample of the current stack
+//
+// An instruction interrupted by fault or `int` never returns from its
+// handler, so it is counted but not timed.
+// All tables are CORE_LOCAL: each core has its own profile, and the report
+// at exit is the profile of the thread calling exit.
+
+#define PROFILE_TABLE_LENGTH (12)
+#define PROFILE_FRAME_LENGTH (12)
+#define PROFILE_STACK_DEPTH (256)
+#define PROFILE_REPORT_TOP (32)
+#define PROFILE_COLLAPSED_FILE "./bin/profile.folded"
+
+typedef struct
+{
+    int         valid;
+    uint64_t    rip;
+    handler_type_t handler;
+    uint64_t    count;          // executions
+    uint64_t    cycles;         // host cycles in the handler
+    uint64_t    memory_access;  // data accesses to DRAM
+    uint64_t    tlb_miss;
+    uint64_t    cache_miss;
+    uint64_t    block_entry;    // times this instruction starts a basic block
+    uint64_t    block_length;   // instructions executed in the block it starts
+} profile_entry_t;
+
+typedef struct
+{
+    uint64_t    count;
+    uint64_t    cycles;
+} profile_handler_t;
+
+// a node in the tree of call stacks: the callee `func` called in `parent`
+typedef struct
+{
+    int         valid;
+    int         parent;
+    uint64_t    func;
+    uint64_t    samples;
+} profile_frame_t;
+
+static CORE_LOCAL profile_entry_t profile_table[(1 << PROFILE_TABLE_LENGTH)];
+// the rips not fitting in the table are all counted here
+static CORE_LOCAL profile_entry_t profile_overflow;
+static CORE_LOCAL profile_handler_t profile_handler_table[NUM_HANDLER];
+static CORE_LOCAL profile_frame_t profile_frame_table[(1 << PROFILE_FRAME_LENGTH)];
+
+// frame 0 is the root of all stacks
+static CORE_LOCAL int profile_stack[PROFILE_STACK_DEPTH];
+static CORE_LOCAL int profile_stack_top = 0;
+// calls deeper than PROFILE_STACK_DEPTH are not recorded but still matched by ret
+static CORE_LOCAL int profile_stack_lost = 0;
+
+// the instruction being executed and the block it is in
+static CORE_LOCAL profile_entry_t *profile_current = NULL;
+static CORE_LOCAL profile_entry_t *profile_block = NULL;
+static CORE_LOCAL int profile_next_is_leader = 1;
+static CORE_LOCAL int profile_initialized = 0;
+
+static const char *handler_name[NUM_HANDLER] =
+{
+    [HANDLER_ILLEGAL]       = "illegal",
+    [HANDLER_MOV_REG_REG]   = "mov_reg_reg",
+    [HANDLER_MOV_REG_MEM]   = "mov_reg_mem",
+    [HANDLER_MOV_MEM_REG]   = "mov_mem_reg",
+    [HANDLER_MOV_IMM_REG]   = "mov_imm_reg",
+    [HANDLER_PUSH_REG]      = "push_reg",
+    [HANDLER_POP_REG]       = "pop_reg",
+    [HANDLER_LEAVE]         = "leave",
+    [HANDLER_CALL]          = "call",
+    [HANDLER_RET]           = "ret",
+    [HANDLER_ADD_REG_REG]   = "add_reg_reg",
+    [HANDLER_SUB_IMM_REG]   = "sub_imm_reg",
+    [HANDLER_CMP_IMM_MEM]   = "cmp_imm_mem",
+    [HANDLER_JNE]           = "jne",
+    [HANDLER_JMP]           = "jmp",
+    [HANDLER_LEA_MEM_REG]   = "lea_mem_reg",
+    [HANDLER_INT_IMM]       = "int_imm",
+    [HANDLER_REP_MOVSB]     = "rep_movsb",
+    [HANDLER_REP_MOVSQ]     = "rep_movsq",
+    [HANDLER_REP_STOSB]     = "rep_stosb",
+    [HANDLER_REP_STOSQ]     = "rep_stosq",
+};
+
+void profile_report(FILE *stream);
+void profile_write_collapsed(const char *filename);
+
+// host cycles: the time stamp counter is much cheaper than clock_gettime
+uint64_t profile_clock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+static void profile_at_exit()
+{
+    profile_report(stdout);
+    profile_write_collapsed(PROFILE_COLLAPSED_FILE);
+}
+
+static void lazy_initialize_profiler()
+{
+    if (profile_initialized == 1)
+    {
+        return;
+    }
+    profile_frame_table[0].valid = 1;
+    profile_frame_table[0].parent = -1;
+    profile_stack[0] = 0;
+    profile_stack_top = 0;
+    profile_initialized = 1;
+
+    atexit(&profile_at_exit);
+}
+
+static inline uint64_t hash_rip(uint64_t rip)
+{
+    // Fibonacci hashing, the instructions are at regular strides
+    return (rip * 0x9e3779b97f4a7c15) >> (64 - PROFILE_TABLE_LENGTH);
+}
+
+static profile_entry_t *find_entry(uint64_t rip)
+{
+    uint64_t mask = (1 << PROFILE_TABLE_LENGTH) - 1;
+    uint64_t index = hash_rip(rip);
+
+    // linear probing, bounded to keep the hot path short
+    for (int i = 0; i < 16; ++ i)
+    {
+        profile_entry_t *entry = &profile_table[(index + i) & mask];
+        if (entry->valid == 0)
+        {
+            entry->valid = 1;
+            entry->rip = rip;
+            return entry;
+        }
+        if (entry->rip == rip)
+        {
+            return entry;
+        }
+    }
+    return &profile_overflow;
+}
+
+static int find_frame(int parent, uint64_t func)
+{
+    uint64_t mask = (1 << PROFILE_FRAME_LENGTH) - 1;
+    uint64_t index = hash_rip(func ^ ((uint64_t)parent << 32)) & mask;
+
+    for (int i = 0; i < 16; ++ i)
+    {
+        int k = (index + i) & mask;
+        profile_frame_t *frame = &profile_frame_table[k];
+        if (frame->valid == 0)
+        {
+            frame->valid = 1;
+            frame->parent = parent;
+            frame->func = func;
+            return k;
+        }
+        if (frame->parent == parent && frame->func == func)
+        {
+            return k;
+        }
+    }
+    // the tree is full, the callee is merged into the caller
+    return parent;
+}
+
+// called at the beginning of each instruction cycle, before fetching
+void profile_enter(uint64_t rip)
+{
+    lazy_initialize_profiler();
+
+    profile_entry_t *entry = find_entry(rip);
+    entry->count += 1;
+
+    if (profile_current != NULL)
+    {
+        // the last instruction did not return from its handler,
+        // i.e., an interrupt or fault, this one starts a new block
+        profile_next_is_leader = 1;
+    }
+    if (profile_next_is_leader == 1 || profile_block == NULL)
+    {
+        entry->block_entry += 1;
+        profile_block = entry;
+        profile_next_is_leader = 0;
+    }
+    profile_block->block_length += 1;
+
+    profile_frame_table[profile_stack[profile_stack_top]].samples += 1;
+    profile_current = entry;
+}
+
+// called when the handler returns, start is the clock before the handler
+void profile_exit(handler_type_t handler, uint64_t start)
+{
+    uint64_t cycles = profile_clock() - start;
+
+    profile_handler_table[handler].count += 1;
+    profile_handler_table[handler].cycles += cycles;
+
+    profile_entry_t *entry = profile_current;
+    profile_current = NULL;
+    if (entry == NULL)
+    {
+        return;
+    }
+    entry->handler = handler;
+    entry->cycles += cycles;
+
+    switch (handler)
+    {
+        case HANDLER_CALL:
+            // the rip is already the callee
+            if (profile_stack_top + 1 < PROFILE_STACK_DEPTH)
+            {
+                int frame = find_frame(profile_stack[profile_stack_top], cpu_pc.rip);
+                profile_stack_top += 1;
+                profile_stack[profile_stack_top] = frame;
+            }
+            else
+            {
+                profile_stack_lost += 1;
+            }
+            profile_next_is_leader = 1;
+            break;
+        case HANDLER_RET:
+            if (profile_stack_lost > 0)
+            {
+                profile_stack_lost -= 1;
+            }
+            else if (profile_stack_top > 0)
+            {
+                profile_stack_top -= 1;
+            }
+            profile_next_is_leader = 1;
+            break;
+        case HANDLER_JMP:
+        case HANDLER_JNE:
+        case HANDLER_INT_IMM:
+            profile_next_is_leader = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+// attribution to the executing instruction
+// the accesses outside the instruction cycle (e.g. loading) are not counted
+
+void profile_memory_access()
+{
+    if (profile_current != NULL)
+    {
+        profile_current->memory_access += 1;
+    }
+}
+
+void profile_tlb_miss()
+{
+    if (profile_current != NULL)
+    {
+        profile_current->tlb_miss += 1;
+    }
+}
+
+void profile_cache_miss()
+{
+    if (profile_current != NULL)
+    {
+        profile_current->cache_miss += 1;
+    }
+}
+
+uint64_t profile_read_count(uint64_t rip)
+{
+    uint64_t mask = (1 << PROFILE_TABLE_LENGTH) - 1;
+    uint64_t index = hash_rip(rip);
+
+    for (int i = 0; i < 16; ++ i)
+    {
+        profile_entry_t *entry = &profile_table[(index + i) & mask];
+        if (entry->valid == 0)
+        {
+            return 0;
+        }
+        if (entry->rip == rip)
+        {
+            return entry->count;
+        }
+    }
+    return 0;
+}
+
+/*======================================*/
+/*      report                          */
+/*======================================*/
+
+static int compare_entry_count(const void *a, const void *b)
+{
+    const profile_entry_t *x = *(const profile_entry_t **)a;
+    const profile_entry_t *y = *(const profile_entry_t **)b;
+    if (x->count == y->count)
+    {
+        return x->rip < y->rip ? -1 : 1;
+    }
+    return x->count > y->count ? -1 : 1;
+}
+
+static int compare_entry_block(const void *a, const void *b)
+{
+    const profile_entry_t *x = *(const profile_entry_t **)a;
+    const profile_entry_t *y = *(const profile_entry_t **)b;
+    if (x->block_length == y->block_length)
+    {
+        return x->rip < y->rip ? -1 : 1;
+    }
+    return x->block_length > y->block_length ? -1 : 1;
+}
+
+// the hot spots sorted by executions, the handlers and the hot blocks
+void profile_report(FILE *stream)
+{
+    profile_entry_t *sorted[(1 << PROFILE_TABLE_LENGTH)];
+    int num = 0;
+    uint64_t total = profile_overflow.count;
+
+    for (int i = 0; i < (1 << PROFILE_TABLE_LENGTH); ++ i)
+    {
+        if (profile_table[i].valid == 1)
+        {
+            sorted[num] = &profile_table[i];
+            num += 1;
+            total += profile_table[i].count;
+        }
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    fprintf(stream, "==== profile: %lu instructions, %d rips ====\n", total, num);
+
+    qsort(sorted, num, sizeof(profile_entry_t *), &compare_entry_count);
+    fprintf(stream, "%-16s %12s %7s %14s %10s %10s %10s  %s\n",
+        "rip", "count", "%", "cycles", "mem", "tlb miss", "cache miss", "handler");
+    for (int i = 0; i < num && i < PROFILE_REPORT_TOP; ++ i)
+    {
+        profile_entry_t *e = sorted[i];
+        fprintf(stream, "%-16lx %12lu %6.2f%% %14lu %10lu %10lu %10lu  %s\n",
+            e->rip, e->count, 100.0 * e->count / total, e->cycles,
+            e->memory_access, e->tlb_miss, e->cache_miss, handler_name[e->handler]);
+    }
+    if (profile_overflow.count > 0)
+    {
+        fprintf(stream, "%-16s %12lu %6.2f%%\n", "[other]",
+            profile_overflow.count, 100.0 * profile_overflow.count / total);
+    }
+
+    fprintf(stream, "\n%-16s %12s %14s %10s\n", "handler", "count", "cycles", "cycles/op");
+    for (int i = 0; i < NUM_HANDLER; ++ i)
+    {
+        profile_handler_t *h = &profile_handler_table[i];
+        if (h->count > 0)
+        {
+            fprintf(stream, "%-16s %12lu %14lu %10.1f\n",
+                handler_name[i], h->count, h->cycles, (double)h->cycles / h->count);
+        }
+    }
+
+    qsort(sorted, num, sizeof(profile_entry_t *), &compare_entry_block);
+    fprintf(stream, "\n%-16s %12s %14s %10s\n", "block", "entries", "instructions", "length");
+    for (int i = 0; i < num && i < PROFILE_REPORT_TOP; ++ i)
+    {
+        profile_entry_t *e = sorted[i];
+        if (e->block_entry == 0)
+        {
+            break;
+        }
+        fprintf(stream, "%-16lx %12lu %14lu %10.1f\n",
+            e->rip, e->block_entry, e->block_length, (double)e->block_length / e->block_entry);
+    }
+}
+
+// one line per stack: `root;0x400000;0x400000 samples`
+// the format of the collapsed stacks read by flamegraph.pl
+void profile_write_collapsed(const char *filename)
+{
+    FILE *fw = fopen(filename, "w");
+    if (fw == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < (1 << PROFILE_FRAME_LENGTH); ++ i)
+    {
+        profile_frame_t *frame = &profile_frame_table[i];
+        if (frame->valid == 0 || frame->samples == 0)
+        {
+            continue;
+        }
+
+        // collect the frames from leaf to root
+        int path[PROFILE_STACK_DEPTH];
+        int depth = 0;
+        for (int k = i; k > 0 && depth < PROFILE_STACK_DEPTH; k = profile_frame_table[k].parent)
+        {
+            path[depth] = k;
+            depth += 1;
+        }
+
+        fprintf(fw, "root");
+        for (int j = depth - 1; j >= 0; -- j)
+        {
+            fprintf(fw, ";0x%lx", profile_frame_table[path[j]].func);
+        }
+        fprintf(fw, " %lu\n", frame->samples);
+    }
+    fclose(fw);
+}
+#endif
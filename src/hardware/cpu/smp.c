@@ -0,0 +1,167 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+
+#ifdef USE_SMP
+/*======================================*/
+/*      symmetric multiprocessing       */
+/*======================================*/
+
+// Each core is a host thread. The registers, TLB, decode cache, kernel
+// stack (by TSS) and the jump buffer of interrupt return are CORE_LOCAL,
+// so they are private to the thread. The physical memory, page map,
+// IDT and syscall table are MACHINE_LOCAL, shared by all the cores.
+//
+// The cores should run different processes: each process has its own
+// kernel stack, and the scheduler of a core follows the PCB ring of
+// the process running on it.
+
+// The TLB shootdown stops the cores by generations. The stopping core
+// takes a new stop generation and waits until each running core has
+// stopped for it, then replaces the page and resumes the generation.
+// The stopped cores spin at their instruction boundary until resumed.
+#define MAX_NUM_CORES (64)
+
+static MACHINE_LOCAL int core_running[MAX_NUM_CORES];
+static MACHINE_LOCAL uint64_t core_stopped[MAX_NUM_CORES];
+static MACHINE_LOCAL uint64_t stop_generation = 0;
+static MACHINE_LOCAL uint64_t resume_generation = 0;
+
+// the core running on this thread, -1 if not run by smp_run
+static CORE_LOCAL int64_t core_id = -1;
+// the generation stopped by this core, 0 if it stops none
+static CORE_LOCAL uint64_t core_stopping = 0;
+
+void smp_stop_cores()
+{
+    if (core_stopping != 0)
+    {
+        return;
+    }
+
+    // the caller holds the page map lock, so the stops never overlap
+    core_stopping = __atomic_add_fetch(&stop_generation, 1, __ATOMIC_SEQ_CST);
+    for (int64_t i = 0; i < MAX_NUM_CORES; ++ i)
+    {
+        // the core leaving smp_run is not waited for
+        while (i != core_id &&
+            __atomic_load_n(&core_running[i], __ATOMIC_SEQ_CST) == 1 &&
+            __atomic_load_n(&core_stopped[i], __ATOMIC_ACQUIRE) != core_stopping)
+        {
+            sched_yield();
+        }
+    }
+}
+
+void smp_resume_cores()
+{
+    if (core_stopping == 0)
+    {
+        return;
+    }
+
+    __atomic_store_n(&resume_generation, core_stopping, __ATOMIC_RELEASE);
+    core_stopping = 0;
+}
+
+void smp_check_stop()
+{
+    uint64_t stop = __atomic_load_n(&stop_generation, __ATOMIC_SEQ_CST);
+    if (core_id == -1 || stop == __atomic_load_n(&resume_generation, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    __atomic_store_n(&core_stopped[core_id], stop, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&resume_generation, __ATOMIC_ACQUIRE) < stop)
+    {
+        sched_yield();
+    }
+
+    // the translations to the replaced pages are stale
+    tlb_flush_all();
+}
+
+static void load_core(core_t *core)
+{
+    memcpy(&cpu_reg, &core->reg, sizeof(cpu_reg_t));
+    memcpy(&cpu_flags, &core->flags, sizeof(cpu_flags_t));
+    cpu_pc = core->pc;
+    cpu_controls = core->controls;
+    tr_global_tss = core->tss;
+    cpu_inst_encoding = core->inst_encoding;
+}
+
+static void store_core(core_t *core)
+{
+    memcpy(&core->reg, &cpu_reg, sizeof(cpu_reg_t));
+    memcpy(&core->flags, &cpu_flags, sizeof(cpu_flags_t));
+    core->pc = cpu_pc;
+    core->controls = cpu_controls;
+    core->tss = tr_global_tss;
+    core->inst_encoding = cpu_inst_encoding;
+}
+
+typedef struct
+{
+    core_t *core;
+    uint64_t max_instructions;
+} core_thread_arg_t;
+
+static void *core_thread(void *arg)
+{
+    core_thread_arg_t *a = (core_thread_arg_t *)arg;
+
+    // the core is stopped by the others from its first instruction
+    core_id = a->core->id;
+    assert(0 <= core_id && core_id < MAX_NUM_CORES);
+    __atomic_store_n(&core_running[core_id], 1, __ATOMIC_SEQ_CST);
+
+    load_core(a->core);
+    cpu_run(a->max_instructions);
+    store_core(a->core);
+
+    __atomic_store_n(&core_running[core_id], 0, __ATOMIC_SEQ_CST);
+    core_id = -1;
+
+    return NULL;
+}
+
+void smp_run(core_t *cores, int num_cores, uint64_t max_instructions)
+{
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_cores);
+    core_thread_arg_t *args = malloc(sizeof(core_thread_arg_t) * num_cores);
+
+    for (int i = 0; i < num_cores; ++ i)
+    {
+        args[i].core = &cores[i];
+        args[i].max_instructions = max_instructions;
+        int r = pthread_create(&threads[i], NULL, core_thread, &args[i]);
+        assert(r == 0);
+    }
+
+    for (int i = 0; i < num_cores; ++ i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
+#endif
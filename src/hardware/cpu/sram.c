@@ -10,6 +10,8 @@
 
 #include "headers/address.h"
 #include "headers/memory.h"
+#include "headers/trace.h"
+#include "headers/cycle.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <assert.h>
@@ -35,7 +37,7 @@ int dirty_bytes_evicted_count = 0;
 // to be read by python script
 char trace_buf[20];
 char *trace_ptr = (char *)&trace_buf;
-#else
+#elif !defined(NUM_CACHE_LINE_PER_SET)
 #define NUM_CACHE_LINE_PER_SET (8)
 #endif
 
@@ -65,7 +67,11 @@ typedef struct
     sram_cacheset_t sets[(1 << SRAM_CACHE_INDEX_LENGTH)];
 } sram_cache_t;
 
-static sram_cache_t cache;
+static CORE_LOCAL sram_cache_t cache;
+
+#ifdef USE_PROFILER
+void profile_cache_miss();
+#endif
 
 uint8_t sram_cache_read(uint64_t paddr_value)
 {
@@ -128,12 +134,22 @@ uint8_t sram_cache_read(uint64_t paddr_value)
     cache_miss_count ++;
 #endif
 
+#ifdef USE_PROFILER
+    profile_cache_miss();
+#endif
+#ifdef USE_TRACE
+    trace_cache_miss();
+#endif
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_CACHE_MISS);
+#endif
+
     // try to find one free cache line
     if (invalid != NULL)
     {
 #ifndef CACHE_SIMULATION_VERIFICATION
         // load data from DRAM to this invalid cache line
-        bus_read_cacheline(paddr.paddr_value, &(invalid->block));
+        bus_read_cacheline(paddr.paddr_value, invalid->block);
 #endif
         // update cache line state
         invalid->state = CACHE_LINE_CLEAN;
@@ -154,7 +170,13 @@ uint8_t sram_cache_read(uint64_t paddr_value)
     {
 #ifndef CACHE_SIMULATION_VERIFICATION
         // write back the dirty line to dram
-        bus_write_cacheline(paddr.paddr_value, victim);
+        // the address of the victim is its own tag in the same set
+        uint64_t victim_paddr = (victim->tag << (SRAM_CACHE_INDEX_LENGTH + SRAM_CACHE_OFFSET_LENGTH)) |
+            (paddr.ci << SRAM_CACHE_OFFSET_LENGTH);
+        bus_write_cacheline(victim_paddr, victim->block);
+#ifdef USE_CYCLE_MODEL
+        cycle_charge(CYCLE_CACHE_EVICTION);
+#endif
 #else
         dirty_bytes_evicted_count   += (1 << SRAM_CACHE_OFFSET_LENGTH);
         dirty_bytes_in_cache_count  -= (1 << SRAM_CACHE_OFFSET_LENGTH);
@@ -172,7 +194,7 @@ uint8_t sram_cache_read(uint64_t paddr_value)
 #ifndef CACHE_SIMULATION_VERIFICATION
     // read from dram
     // load data from DRAM to this invalid cache line
-    bus_read_cacheline(paddr.paddr_value, &(victim->block));
+    bus_read_cacheline(paddr.paddr_value, victim->block);
 #endif
 
     // update cache line state
@@ -257,6 +279,16 @@ void sram_cache_write(uint64_t paddr_value, uint8_t data)
     cache_miss_count ++;
 #endif
 
+#ifdef USE_PROFILER
+    profile_cache_miss();
+#endif
+#ifdef USE_TRACE
+    trace_cache_miss();
+#endif
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_CACHE_MISS);
+#endif
+
     // write-allocate
 
     // try to find one free cache line
@@ -264,7 +296,7 @@ void sram_cache_write(uint64_t paddr_value, uint8_t data)
     {
 #ifndef CACHE_SIMULATION_VERIFICATION
         // load data from DRAM to this invalid cache line
-        bus_read_cacheline(paddr.paddr_value, &(invalid->block));
+        bus_read_cacheline(paddr.paddr_value, invalid->block);
 #else
         dirty_bytes_in_cache_count += (1 << SRAM_CACHE_OFFSET_LENGTH);
 #endif
@@ -291,7 +323,13 @@ void sram_cache_write(uint64_t paddr_value, uint8_t data)
     {
 #ifndef CACHE_SIMULATION_VERIFICATION
         // write back the dirty line to dram
-        bus_write_cacheline(paddr.paddr_value, victim);
+        // the address of the victim is its own tag in the same set
+        uint64_t victim_paddr = (victim->tag << (SRAM_CACHE_INDEX_LENGTH + SRAM_CACHE_OFFSET_LENGTH)) |
+            (paddr.ci << SRAM_CACHE_OFFSET_LENGTH);
+        bus_write_cacheline(victim_paddr, victim->block);
+#ifdef USE_CYCLE_MODEL
+        cycle_charge(CYCLE_CACHE_EVICTION);
+#endif
 #else
         dirty_bytes_evicted_count   += (1 << SRAM_CACHE_OFFSET_LENGTH);
         dirty_bytes_in_cache_count  -= (1 << SRAM_CACHE_OFFSET_LENGTH);
@@ -312,7 +350,7 @@ void sram_cache_write(uint64_t paddr_value, uint8_t data)
     // read from dram
     // write-allocate
     // load data from DRAM to this invalid cache line
-    bus_read_cacheline(paddr.paddr_value, &(victim->block));
+    bus_read_cacheline(paddr.paddr_value, victim->block);
 #endif
 
     // update cache line state
@@ -327,6 +365,35 @@ void sram_cache_write(uint64_t paddr_value, uint8_t data)
     victim->block[paddr.co] = data;
 }
 
+#ifndef CACHE_SIMULATION_VERIFICATION
+// write back all the dirty lines and invalidate the cache
+// e.g. before the physical memory is saved
+void sram_cache_flush()
+{
+    for (int i = 0; i < (1 << SRAM_CACHE_INDEX_LENGTH); ++ i)
+    {
+        for (int j = 0; j < NUM_CACHE_LINE_PER_SET; ++ j)
+        {
+            sram_cacheline_t *line = &(cache.sets[i].lines[j]);
+            if (line->state == CACHE_LINE_DIRTY)
+            {
+                uint64_t line_paddr = (line->tag << (SRAM_CACHE_INDEX_LENGTH + SRAM_CACHE_OFFSET_LENGTH)) |
+                    (i << SRAM_CACHE_OFFSET_LENGTH);
+                bus_write_cacheline(line_paddr, line->block);
+            }
+            line->state = CACHE_LINE_INVALID;
+        }
+    }
+}
+
+// drop all the lines without writing back
+// e.g. after the physical memory is replaced
+void sram_cache_invalidate()
+{
+    memset(&cache, 0, sizeof(sram_cache_t));
+}
+#endif
+
 #ifdef CACHE_SIMULATION_VERIFICATION
 void print_cache()
 {
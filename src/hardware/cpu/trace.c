@@ -0,0 +1,331 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/trace.h"
+
+#ifdef USE_TRACE
+/*======================================*/
+/*      execution trace                 */
+/*======================================*/
+
+// The trace is a stream of variable-length records after an 8-byte magic.
+// Each record starts with a varint: (zigzag(delta) << 2) | kind
+//  -   TRACE_INST:     delta of rip to the prediction: last rip + last stride
+//  -   TRACE_FETCH:    delta of vaddr to the last instruction
+//  -   TRACE_READ/WRITE: delta of vaddr to the last data access
+// The memory records are followed by a second varint: zigzag of the change
+// of (paddr - vaddr), kept for code and data apart. Inside one page it is 0.
+//
+// So the sequential instructions and the stack accesses are 1 or 2 bytes.
+
+#define TRACE_MAGIC "BCSTTRC1"
+#define TRACE_RING_LENGTH (16)
+// 2 varints of 64 bits
+#define TRACE_MAX_RECORD (20)
+
+typedef struct
+{
+    uint64_t    rip;
+    uint64_t    stride;     // the last sequential step of rip
+    uint64_t    vaddr;
+    uint64_t    offset;     // paddr - vaddr of data
+    uint64_t    code_offset;    // paddr - vaddr of code
+} trace_state_t;
+
+// the bytes in [tail, head) are not written to file yet
+static CORE_LOCAL uint8_t trace_ring[(1 << TRACE_RING_LENGTH)];
+static CORE_LOCAL uint64_t trace_head = 0;
+static CORE_LOCAL uint64_t trace_tail = 0;
+
+static CORE_LOCAL FILE *trace_file = NULL;
+static CORE_LOCAL trace_state_t trace_state;
+// the virtual address of the last translation
+static CORE_LOCAL uint64_t trace_vaddr = 0;
+
+static inline uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// the sequential instructions are predicted exactly
+static inline void update_rip(trace_state_t *state, uint64_t rip)
+{
+    uint64_t step = rip - state->rip;
+    if (0 < step && step <= MAX_INSTRUCTION_CHAR)
+    {
+        state->stride = step;
+    }
+    state->rip = rip;
+}
+
+static void flush_ring()
+{
+    uint64_t mask = (1 << TRACE_RING_LENGTH) - 1;
+    while (trace_tail < trace_head)
+    {
+        // the bytes till the end of ring or head
+        uint64_t begin = trace_tail & mask;
+        uint64_t size = trace_head - trace_tail;
+        if (begin + size > (1 << TRACE_RING_LENGTH))
+        {
+            size = (1 << TRACE_RING_LENGTH) - begin;
+        }
+        fwrite(&trace_ring[begin], 1, size, trace_file);
+        trace_tail += size;
+    }
+}
+
+static inline void write_varint(uint64_t value)
+{
+    uint64_t mask = (1 << TRACE_RING_LENGTH) - 1;
+    while (value >= 0x80)
+    {
+        trace_ring[trace_head & mask] = (uint8_t)(value | 0x80);
+        trace_head += 1;
+        value >>= 7;
+    }
+    trace_ring[trace_head & mask] = (uint8_t)value;
+    trace_head += 1;
+}
+
+static inline void write_record(trace_kind_t kind, int64_t delta)
+{
+    if (trace_head - trace_tail + TRACE_MAX_RECORD > (1 << TRACE_RING_LENGTH))
+    {
+        flush_ring();
+    }
+    write_varint((zigzag_encode(delta) << 2) | kind);
+}
+
+void trace_start(const char *filename)
+{
+    assert(trace_file == NULL);
+    trace_file = fopen(filename, "wb");
+    assert(trace_file != NULL);
+    fwrite(TRACE_MAGIC, 1, 8, trace_file);
+
+    trace_head = 0;
+    trace_tail = 0;
+    memset(&trace_state, 0, sizeof(trace_state_t));
+}
+
+void trace_stop()
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+    flush_ring();
+    fclose(trace_file);
+    trace_file = NULL;
+}
+
+void trace_instruction(uint64_t rip)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+    write_record(TRACE_INST, rip - (trace_state.rip + trace_state.stride));
+    update_rip(&trace_state, rip);
+}
+
+void trace_translation(uint64_t vaddr)
+{
+    trace_vaddr = vaddr;
+}
+
+void trace_fetch(uint64_t vaddr, uint64_t paddr)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+    // the instruction is usually fetched at rip, delta is 0
+    write_record(TRACE_FETCH, vaddr - trace_state.rip);
+    write_varint(zigzag_encode((paddr - vaddr) - trace_state.code_offset));
+    trace_state.code_offset = paddr - vaddr;
+}
+
+// the virtual address is the last translated by va2pa
+void trace_memory_access(uint64_t paddr, trace_kind_t kind)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+    write_record(kind, trace_vaddr - trace_state.vaddr);
+    write_varint(zigzag_encode((paddr - trace_vaddr) - trace_state.offset));
+    trace_state.vaddr = trace_vaddr;
+    trace_state.offset = paddr - trace_vaddr;
+}
+
+/*======================================*/
+/*      replay                          */
+/*======================================*/
+
+#if defined(USE_TLB_HARDWARE) && defined(USE_PAGETABLE_VA2PA)
+// from mmu.c
+int replay_tlb(uint64_t vaddr, uint64_t paddr, int fetch);
+#endif
+
+#ifdef USE_SRAM_CACHE
+uint8_t sram_cache_read(uint64_t paddr);
+void sram_cache_write(uint64_t paddr, uint8_t data);
+#endif
+
+// counted in replaying, the misses in recording are not traced
+static CORE_LOCAL int replaying = 0;
+static CORE_LOCAL uint64_t replay_cache_miss = 0;
+
+void trace_cache_miss()
+{
+    replay_cache_miss += replaying;
+}
+
+static inline uint64_t read_varint(uint8_t **cursor, uint8_t *end)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    while (*cursor < end)
+    {
+        uint8_t byte = **cursor;
+        *cursor += 1;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+static void replay_access(uint64_t vaddr, uint64_t paddr, trace_kind_t kind, trace_stat_t *stat)
+{
+#if defined(USE_TLB_HARDWARE) && defined(USE_PAGETABLE_VA2PA)
+    if (replay_tlb(vaddr, paddr, kind == TRACE_FETCH) == 1)
+    {
+        stat->tlb_hit += 1;
+    }
+    else
+    {
+        stat->tlb_miss += 1;
+    }
+#endif
+
+#ifdef USE_SRAM_CACHE
+    // the assembly instructions are read from DRAM directly,
+    // only the data accesses go through the SRAM cache
+    uint64_t miss = replay_cache_miss;
+    for (int i = 0; i < 8 && kind != TRACE_FETCH; ++ i)
+    {
+        if (kind == TRACE_READ)
+        {
+            sram_cache_read(paddr + i);
+        }
+        else
+        {
+            sram_cache_write(paddr + i, 0);
+        }
+    }
+    if (kind != TRACE_FETCH)
+    {
+        // one 8-byte access is a miss if any of its bytes misses
+        if (replay_cache_miss > miss)
+        {
+            stat->cache_miss += 1;
+        }
+        else
+        {
+            stat->cache_hit += 1;
+        }
+    }
+#endif
+}
+
+// the TLB and SRAM cache of this core are used as they are,
+// the configurations to compare are selected in compiling
+void trace_replay(const char *filename, trace_stat_t *stat)
+{
+    memset(stat, 0, sizeof(trace_stat_t));
+
+    FILE *fr = fopen(filename, "rb");
+    assert(fr != NULL);
+    fseek(fr, 0, SEEK_END);
+    uint64_t size = ftell(fr);
+    fseek(fr, 0, SEEK_SET);
+
+    uint8_t *buf = malloc(size);
+    assert(buf != NULL);
+    uint64_t count = fread(buf, 1, size, fr);
+    fclose(fr);
+    assert(count == size);
+    assert(size >= 8 && memcmp(buf, TRACE_MAGIC, 8) == 0);
+
+    trace_state_t state;
+    memset(&state, 0, sizeof(trace_state_t));
+
+    replaying = 1;
+    uint8_t *cursor = buf + 8;
+    uint8_t *end = buf + size;
+    while (cursor < end)
+    {
+        uint64_t head = read_varint(&cursor, end);
+        trace_kind_t kind = head & 0x3;
+        int64_t delta = zigzag_decode(head >> 2);
+
+        switch (kind)
+        {
+            case TRACE_INST:
+                update_rip(&state, state.rip + state.stride + delta);
+                stat->instructions += 1;
+                break;
+            case TRACE_FETCH:
+            {
+                uint64_t vaddr = state.rip + delta;
+                state.code_offset += zigzag_decode(read_varint(&cursor, end));
+                stat->fetches += 1;
+                replay_access(vaddr, vaddr + state.code_offset, kind, stat);
+                break;
+            }
+            case TRACE_READ:
+            case TRACE_WRITE:
+                state.vaddr += delta;
+                state.offset += zigzag_decode(read_varint(&cursor, end));
+                if (kind == TRACE_READ)
+                {
+                    stat->reads += 1;
+                }
+                else
+                {
+                    stat->writes += 1;
+                }
+                replay_access(state.vaddr, state.vaddr + state.offset, kind, stat);
+                break;
+        }
+    }
+    replaying = 0;
+
+    free(buf);
+}
+#endif
@@ -15,6 +15,12 @@
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/address.h"
+#include "headers/trace.h"
+#include "headers/cycle.h"
+
+// physical memory of this machine
+// page aligned so that a checkpoint file can be mapped onto it
+MACHINE_LOCAL uint8_t pm[PHYSICAL_MEMORY_SPACE] __attribute__((aligned(PAGE_SIZE)));
 
 #ifdef USE_SRAM_CACHE
 uint8_t sram_cache_read(uint64_t paddr);
@@ -22,10 +28,17 @@ void sram_cache_write(uint64_t paddr, uint8_t data);
 #endif
 
 #ifdef USE_PAGETABLE_VA2PA
-void pagemap_update_time(uint64_t ppn);
 void pagemap_dirty(uint64_t ppn);
 #endif
 
+#ifdef USE_DECODE_CACHE
+void invalidate_decode_cache(uint64_t paddr, uint64_t size);
+#endif
+
+#ifdef USE_PROFILER
+void profile_memory_access();
+#endif
+
 /*  
 Be careful with the x86-64 little endian integer encoding
 e.g. write 0x00007fd357a02ae0 to cache, the memory lapping should be:
@@ -37,12 +50,28 @@ uint64_t cpu_read64bits_dram(uint64_t paddr)
 {    
     uint64_t val = 0x0;
 
+#ifdef USE_PROFILER
+    profile_memory_access();
+#endif
+
+#ifdef USE_TRACE
+    trace_memory_access(paddr, TRACE_READ);
+#endif
+
+#ifdef USE_CYCLE_MODEL
+#ifdef USE_SRAM_CACHE
+    cycle_charge(CYCLE_CACHE_HIT);
+#else
+    cycle_charge(CYCLE_DRAM_ACCESS);
+#endif
+#endif
+
 #ifdef USE_SRAM_CACHE
     // try to load uint64_t from SRAM cache
     // little-endian
     for (int i = 0; i < 8; ++ i)
     {
-        val += (sram_cache_read(paddr + i) << (i * 8));
+        val += (((uint64_t)sram_cache_read(paddr + i)) << (i * 8));
     }
 #else
     // read from DRAM directly
@@ -57,16 +86,32 @@ uint64_t cpu_read64bits_dram(uint64_t paddr)
     val += (((uint64_t)pm[paddr + 7 ]) << 56);
 #endif
 
-#ifdef USE_PAGETABLE_VA2PA
-    // Update page_map when read data's timestamp
-    pagemap_update_time(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
-#endif
-
     return val;
 }
 
 void cpu_write64bits_dram(uint64_t paddr, uint64_t data)
 {
+#ifdef USE_PROFILER
+    profile_memory_access();
+#endif
+
+#ifdef USE_TRACE
+    trace_memory_access(paddr, TRACE_WRITE);
+#endif
+
+#ifdef USE_CYCLE_MODEL
+#ifdef USE_SRAM_CACHE
+    cycle_charge(CYCLE_CACHE_HIT);
+#else
+    cycle_charge(CYCLE_DRAM_ACCESS);
+#endif
+#endif
+
+#ifdef USE_DECODE_CACHE
+    // the data may overwrite some instruction
+    invalidate_decode_cache(paddr, 8);
+#endif
+
 #ifdef USE_SRAM_CACHE
     // try to write uint64_t to SRAM cache
     // little-endian
@@ -86,13 +131,6 @@ void cpu_write64bits_dram(uint64_t paddr, uint64_t data)
     pm[paddr + 6] = (data >> 48) & 0xff;
     pm[paddr + 7] = (data >> 56) & 0xff;
 #endif
-
-#ifdef USE_PAGETABLE_VA2PA
-    // Update page_map when read data's timestamp
-    pagemap_update_time(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
-    // Update dirty bit
-    pagemap_dirty(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
-#endif
 }
 
 void cpu_readinst_dram(uint64_t paddr, char *buf)
@@ -101,11 +139,6 @@ void cpu_readinst_dram(uint64_t paddr, char *buf)
     {
         buf[i] = (char)pm[paddr + i];
     }
-
-#ifdef USE_PAGETABLE_VA2PA
-    // Update page_map when read data's timestamp
-    pagemap_update_time(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
-#endif
 }
 
 void cpu_writeinst_dram(uint64_t paddr, const char *str)
@@ -113,6 +146,10 @@ void cpu_writeinst_dram(uint64_t paddr, const char *str)
     int len = strlen(str);
     assert(len < MAX_INSTRUCTION_CHAR);
 
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(paddr, MAX_INSTRUCTION_CHAR);
+#endif
+
     for (int i = 0; i < MAX_INSTRUCTION_CHAR; ++ i)
     {
         if (i < len)
@@ -126,18 +163,176 @@ void cpu_writeinst_dram(uint64_t paddr, const char *str)
     }
 
 #ifdef USE_PAGETABLE_VA2PA
-    // Update page_map when read data's timestamp
-    pagemap_update_time(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
-    // Update dirty bit
+    // the loader writes by the physical address, not through MMU,
+    // so the dirty bit is set here
+    pagemap_dirty(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
+#endif
+}
+
+// machine code is read and written byte by byte
+// the code is fetched through SRAM cache as the data, like an I-cache
+void cpu_readcode_dram(uint64_t paddr, uint8_t *buf, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++ i)
+    {
+#ifdef USE_SRAM_CACHE
+        buf[i] = sram_cache_read(paddr + i);
+#else
+        buf[i] = pm[paddr + i];
+#endif
+    }
+}
+
+void cpu_writecode_dram(uint64_t paddr, const uint8_t *buf, uint64_t size)
+{
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(paddr, size);
+#endif
+
+    for (uint64_t i = 0; i < size; ++ i)
+    {
+#ifdef USE_SRAM_CACHE
+        sram_cache_write(paddr + i, buf[i]);
+#else
+        pm[paddr + i] = buf[i];
+#endif
+    }
+
+#ifdef USE_PAGETABLE_VA2PA
+    // the loader writes by the physical address, not through MMU,
+    // so the dirty bit is set here
     pagemap_dirty(paddr >> PHYSICAL_PAGE_OFFSET_LENGTH);
 #endif
 }
 
+// The string instructions access the memory in bulk. The range is split
+// at the page boundaries by the CPU, so [paddr, paddr + size) is inside
+// one physical page and the page map is updated once per range.
+// `size` is a multiple of the element `width`: 1 or 8 bytes.
+
+// copy forward as `rep movs`: when the destination overlaps the tail of
+// the source, the elements already copied are copied again
+void cpu_movs_dram(uint64_t dst_paddr, uint64_t src_paddr, uint64_t size, uint64_t width)
+{
+    assert(size % width == 0);
+
+#ifdef USE_CYCLE_MODEL
+    // one 8-byte read and one 8-byte write
+    for (uint64_t i = 0; i < size; i += 8)
+    {
+#ifdef USE_SRAM_CACHE
+        cycle_charge(CYCLE_CACHE_HIT);
+        cycle_charge(CYCLE_CACHE_HIT);
+#else
+        cycle_charge(CYCLE_DRAM_ACCESS);
+        cycle_charge(CYCLE_DRAM_ACCESS);
+#endif
+    }
+#endif
+
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(dst_paddr, size);
+#endif
+
+#ifdef USE_SRAM_CACHE
+    // element by element through SRAM cache, so the hits and misses
+    // are the same as moving them one by one
+    uint8_t element[8];
+    for (uint64_t i = 0; i < size; i += width)
+    {
+        for (uint64_t j = 0; j < width; ++ j)
+        {
+            element[j] = sram_cache_read(src_paddr + i + j);
+        }
+        for (uint64_t j = 0; j < width; ++ j)
+        {
+            sram_cache_write(dst_paddr + i + j, element[j]);
+        }
+    }
+#else
+    if (dst_paddr <= src_paddr || src_paddr + size <= dst_paddr)
+    {
+        // copying forward is the same as memmove
+        memmove(&pm[dst_paddr], &pm[src_paddr], size);
+    }
+    else if (dst_paddr - src_paddr < width)
+    {
+        // an element overlaps the next one
+        uint8_t element[8];
+        for (uint64_t i = 0; i < size; i += width)
+        {
+            memcpy(element, &pm[src_paddr + i], width);
+            memcpy(&pm[dst_paddr + i], element, width);
+        }
+    }
+    else
+    {
+        // the source pattern of (dst - src) bytes is repeated
+        uint64_t distance = dst_paddr - src_paddr;
+        for (uint64_t i = 0; i < size; i += distance)
+        {
+            memcpy(&pm[dst_paddr + i], &pm[src_paddr + i],
+                size - i < distance ? size - i : distance);
+        }
+    }
+#endif
+}
+
+// fill with the lowest `width` bytes of data as `rep stos`
+void cpu_stos_dram(uint64_t paddr, uint64_t data, uint64_t size, uint64_t width)
+{
+    assert(size % width == 0);
+
+#ifdef USE_CYCLE_MODEL
+    for (uint64_t i = 0; i < size; i += 8)
+    {
+#ifdef USE_SRAM_CACHE
+        cycle_charge(CYCLE_CACHE_HIT);
+#else
+        cycle_charge(CYCLE_DRAM_ACCESS);
+#endif
+    }
+#endif
+
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(paddr, size);
+#endif
+
+#ifdef USE_SRAM_CACHE
+    for (uint64_t i = 0; i < size; ++ i)
+    {
+        sram_cache_write(paddr + i, (data >> ((i % width) * 8)) & 0xff);
+    }
+#else
+    if (width == 1)
+    {
+        memset(&pm[paddr], data & 0xff, size);
+    }
+    else if (size > 0)
+    {
+        // little-endian: the first element, then doubling the filled bytes
+        for (uint64_t j = 0; j < width; ++ j)
+        {
+            pm[paddr + j] = (data >> (j * 8)) & 0xff;
+        }
+        for (uint64_t filled = width; filled < size; filled *= 2)
+        {
+            memcpy(&pm[paddr + filled], &pm[paddr],
+                size - filled < filled ? size - filled : filled);
+        }
+    }
+#endif
+}
+
 /* interface of I/O Bus: read and write between the SRAM cache and DRAM memory
  */
 
 void bus_read_cacheline(uint64_t paddr, uint8_t *block)
 {
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_BUS_READ);
+#endif
+
     uint64_t dram_base = ((paddr >> SRAM_CACHE_OFFSET_LENGTH) << SRAM_CACHE_OFFSET_LENGTH);
 
     for (int i = 0; i < (1 << SRAM_CACHE_OFFSET_LENGTH); ++ i)
@@ -17,21 +17,64 @@
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/address.h"
+#include "headers/cycle.h"
 
 void set_pagemap_swapaddr(uint64_t ppn, uint64_t swap_address);
 
+#ifdef USE_DECODE_CACHE
+void invalidate_decode_cache(uint64_t paddr, uint64_t size);
+#endif
+
 // each swap file is swap page
 // each line of this swap page is one uint64
 #define SWAP_PAGE_FILE_LINES (512)
 #define SWAP_ADDRESS_MIN (100)
 
 // disk address counter
+// the swap directory is shared by all machines running in this process,
+// so the disk addresses are allocated atomically and never collide
 static char *SWAP_FILE_DIRECTORY = "./files/swap";
 static uint64_t internal_swap_addr = SWAP_ADDRESS_MIN;
 
+// the page file is text: one uint64 per line
+void read_swappage(uint64_t daddr, uint8_t *page)
+{
+    assert(daddr >= SWAP_ADDRESS_MIN);
+
+    char filename[128];
+    sprintf(filename, "%s/page-%ld.page.txt", SWAP_FILE_DIRECTORY, daddr);
+    FILE *fr = fopen(filename, "r");
+    assert(fr != NULL);
+
+    char buf[64] = {'0'};
+    for (int i = 0; i < SWAP_PAGE_FILE_LINES; ++ i)
+    {
+        char *str = fgets(buf, 64, fr);
+        // the anonymous page file is empty for zero page
+        *((uint64_t *)(&page[i * 8])) = str == NULL ? 0 : string2uint(str);
+    }
+    fclose(fr);
+}
+
+void write_swappage(uint64_t daddr, uint8_t *page)
+{
+    assert(daddr >= SWAP_ADDRESS_MIN);
+
+    char filename[128];
+    sprintf(filename, "%s/page-%ld.page.txt", SWAP_FILE_DIRECTORY, daddr);
+    FILE *fw = fopen(filename, "w");
+    assert(fw != NULL);
+
+    for (int i = 0; i < SWAP_PAGE_FILE_LINES; ++ i)
+    {
+        fprintf(fw, "0x%016lx\n", *((uint64_t *)(&page[i * 8])));
+    }
+    fclose(fw);
+}
+
 uint64_t allocate_swappage(uint64_t ppn)
 {
-    uint64_t daddr = internal_swap_addr++;
+    uint64_t daddr = __sync_fetch_and_add(&internal_swap_addr, 1);
     
     char filename[128];
     sprintf(filename, "%s/page-%ld.page.txt", SWAP_FILE_DIRECTORY, daddr);
@@ -43,6 +86,9 @@ uint64_t allocate_swappage(uint64_t ppn)
     fclose(fw);
     uint64_t ppn_ppo = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
     memset(&pm[ppn_ppo], 0, PAGE_SIZE);
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(ppn_ppo, PAGE_SIZE);
+#endif
     
     // Now the page is like swapped in from swap space. So:
     // daddr is stored on page_map
@@ -57,9 +103,6 @@ int swap_in(uint64_t daddr, uint64_t ppn)
 {
     assert(0 <= ppn && ppn < MAX_NUM_PHYSICAL_PAGE);
     
-    FILE *fr = NULL;
-    char filename[128];
-
     if (daddr == 0)
     {
         // daddr == 0 indicates that this page is not backed by file
@@ -69,38 +112,85 @@ int swap_in(uint64_t daddr, uint64_t ppn)
         return 0;
     }
 
-    assert(daddr >= SWAP_ADDRESS_MIN);
-    sprintf(filename, "%s/page-%ld.page.txt", SWAP_FILE_DIRECTORY, daddr);
-    fr = fopen(filename, "r");
-    assert(fr != NULL);
+    uint64_t ppn_ppo = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
+    read_swappage(daddr, &pm[ppn_ppo]);
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_SWAP_IN);
+#endif
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(ppn_ppo, PAGE_SIZE);
+#endif
+    return 1;
+}
+
+int swap_out(uint64_t daddr, uint64_t ppn)
+{
+    assert(0 <= ppn && ppn < MAX_NUM_PHYSICAL_PAGE);
 
     uint64_t ppn_ppo = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
-    char buf[64] = {'0'};
-    for (int i = 0; i < SWAP_PAGE_FILE_LINES; ++ i)
+    write_swappage(daddr, &pm[ppn_ppo]);
+#ifdef USE_CYCLE_MODEL
+    cycle_charge(CYCLE_SWAP_OUT);
+#endif
+    return 0;
+}
+
+// copy one page of swap space to a newly allocated disk address
+// used by restoring a checkpoint, so that the machines restored from
+// the same file never write the same swap page
+uint64_t copy_swappage(uint8_t *page)
+{
+    uint64_t daddr = __sync_fetch_and_add(&internal_swap_addr, 1);
+    write_swappage(daddr, page);
+    return daddr;
+}
+
+#ifdef USE_HUGE_PAGE
+// the 2MB page is swapped as 512 swap pages at contiguous disk addresses
+
+uint64_t copy_swappages(uint8_t *pages, uint64_t num)
+{
+    uint64_t daddr = __sync_fetch_and_add(&internal_swap_addr, num);
+    for (uint64_t i = 0; i < num; ++ i)
     {
-        char *str = fgets(buf, 64, fr);
-        *((uint64_t *)(&pm[ppn_ppo + i * 8])) = string2uint(str);
+        write_swappage(daddr + i, &pages[i * PAGE_SIZE]);
+    }
+    return daddr;
+}
+
+int swap_in_hugepage(uint64_t daddr, uint64_t ppn)
+{
+    assert(ppn % HUGE_PAGE_FRAME_NUM == 0);
+    assert(ppn + HUGE_PAGE_FRAME_NUM <= MAX_NUM_PHYSICAL_PAGE);
+
+    if (daddr == 0)
+    {
+        // newly created anoymous 2MB page, the swap pages are
+        // allocated when it is written back for the first time
+        uint64_t ppn_ppo = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
+        memset(&pm[ppn_ppo], 0, HUGE_PAGE_SIZE);
+#ifdef USE_DECODE_CACHE
+        invalidate_decode_cache(ppn_ppo, HUGE_PAGE_SIZE);
+#endif
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < HUGE_PAGE_FRAME_NUM; ++ i)
+    {
+        swap_in(daddr + i, ppn + i);
     }
-    fclose(fr);
     return 1;
 }
 
-int swap_out(uint64_t daddr, uint64_t ppn)
+int swap_out_hugepage(uint64_t daddr, uint64_t ppn)
 {
-    assert(0 <= ppn && ppn < MAX_NUM_PHYSICAL_PAGE);
+    assert(ppn % HUGE_PAGE_FRAME_NUM == 0);
     assert(daddr >= SWAP_ADDRESS_MIN);
 
-    FILE *fw = NULL;
-    char filename[128];
-    sprintf(filename, "%s/page-%ld.page.txt", SWAP_FILE_DIRECTORY, daddr);
-    fw = fopen(filename, "w");
-    assert(fw != NULL);
-
-    uint64_t ppn_ppo = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
-    for (int i = 0; i < SWAP_PAGE_FILE_LINES; ++ i)
+    for (uint64_t i = 0; i < HUGE_PAGE_FRAME_NUM; ++ i)
     {
-        fprintf(fw, "0x%16lx\n", *((uint64_t *)(&pm[ppn_ppo + i * 8])));
+        swap_out(daddr + i, ppn + i);
     }
-    fclose(fw);
     return 0;
-}
\ No newline at end of file
+}
+#endif
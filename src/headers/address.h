@@ -15,26 +15,37 @@
 
 #include <stdint.h>
 
-#ifndef CACHE_SIMULATION_VERIFICATION
-/*  for cache simulator verification
+/*  for cache simulator verification and trace replaying
     use the marcos passed in
  */
+#ifndef SRAM_CACHE_INDEX_LENGTH
 #define SRAM_CACHE_INDEX_LENGTH (6)
+#endif
+#ifndef SRAM_CACHE_OFFSET_LENGTH
 #define SRAM_CACHE_OFFSET_LENGTH (6)
-#define SRAM_CACHE_TAG_LENGTH (4)
+#endif
+#ifndef SRAM_CACHE_TAG_LENGTH
+#define SRAM_CACHE_TAG_LENGTH (PHYSICAL_ADDRESS_LENGTH - SRAM_CACHE_INDEX_LENGTH - SRAM_CACHE_OFFSET_LENGTH)
 #endif
 
 #define PHYSICAL_PAGE_OFFSET_LENGTH (12)
+#ifdef USE_HUGE_PAGE
+#define PHYSICAL_PAGE_NUMBER_LENGTH (10)
+#define PHYSICAL_ADDRESS_LENGTH (22)
+#else
 #define PHYSICAL_PAGE_NUMBER_LENGTH (4)
 #define PHYSICAL_ADDRESS_LENGTH (16)
+#endif
 
 #define VIRTUAL_PAGE_OFFSET_LENGTH (12)
 #define VIRTUAL_PAGE_NUMBER_LENGTH (9)  // 9 + 9 + 9 + 9 = 36
 #define VIRTUAL_ADDRESS_LENGTH (48)
 
 #define TLB_CACHE_OFFSET_LENGTH (12)
+#ifndef TLB_CACHE_INDEX_LENGTH
 #define TLB_CACHE_INDEX_LENGTH (4)
-#define TLB_CACHE_TAG_LENGTH (32)
+#endif
+#define TLB_CACHE_TAG_LENGTH (VIRTUAL_ADDRESS_LENGTH - TLB_CACHE_OFFSET_LENGTH - TLB_CACHE_INDEX_LENGTH)
 
 /*
 +--------+--------+--------+--------+---------------+
@@ -51,6 +51,21 @@ uint64_t string2uint_range(const char *str, int start, int end);
 // commonly shared variables
 #define MAX_INSTRUCTION_CHAR (64)
 
+// The state of the simulated machine is thread-local:
+// each host thread runs its own machine, independent of the others.
+// So the variables are declared `extern` in headers and
+// defined once in the source files owning them.
+//
+// CORE_LOCAL is the state of one CPU core: registers, TLB, caches.
+// MACHINE_LOCAL is shared by the cores: physical memory, page map, IDT.
+// With USE_SMP, the process is one machine, whose cores run on threads.
+#ifdef USE_SMP
+#define MACHINE_LOCAL
+#else
+#define MACHINE_LOCAL __thread
+#endif
+#define CORE_LOCAL __thread
+
 /*======================================*/
 /*      wrap of the memory              */
 /*======================================*/
@@ -15,6 +15,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "headers/common.h"
 #include "headers/instruction.h"
 
 /*======================================*/
@@ -193,7 +194,7 @@ typedef struct
         uint8_t  r15b;
     };
 } cpu_reg_t;
-cpu_reg_t cpu_reg;
+extern CORE_LOCAL cpu_reg_t cpu_reg;
 
 /*======================================*/
 /*      cpu core                        */
@@ -226,23 +227,41 @@ cpu_reg_t cpu_reg;
     test    test
 */
 
-// the 4 flags be a uint64_t in total
-typedef union
+// the operation which produces the condition codes
+// the condition codes are computed lazily when they are read
+typedef enum
+{
+    FLAGS_EVALUATED,    // CF, ZF, SF, OF are up to date
+    FLAGS_ADD,          // result = dst + src
+    FLAGS_SUB,          // result = dst - src
+} flags_op_t;
+
+typedef struct
 {
-    uint64_t __flags_value;
-    struct
-    {    
-        // carry flag: detect overflow for unsigned operations
-        uint16_t CF;
-        // zero flag: result is zero
-        uint16_t ZF;
-        // sign flag: result is negative: highest bit
-        uint16_t SF;
-        // overflow flag: detect overflow for signed operations
-        uint16_t OF;
-    };        
+    // the 4 flags be a uint64_t in total
+    union
+    {
+        uint64_t __flags_value;
+        struct
+        {    
+            // carry flag: detect overflow for unsigned operations
+            uint16_t CF;
+            // zero flag: result is zero
+            uint16_t ZF;
+            // sign flag: result is negative: highest bit
+            uint16_t SF;
+            // overflow flag: detect overflow for signed operations
+            uint16_t OF;
+        };
+    };
+
+    // the latest flag-producing operation, its operands and result
+    flags_op_t  lazy_op;
+    uint64_t    lazy_src;
+    uint64_t    lazy_dst;
+    uint64_t    lazy_result;
 } cpu_flags_t;
-cpu_flags_t cpu_flags;
+extern CORE_LOCAL cpu_flags_t cpu_flags;
 
 // program counter or instruction pointer
 typedef union
@@ -250,7 +269,7 @@ typedef union
     uint64_t rip;
     uint32_t eip;
 } cpu_pc_t;
-cpu_pc_t cpu_pc;
+extern CORE_LOCAL cpu_pc_t cpu_pc;
 
 // we only use stack0 of TSS
 // This information is stored in main memory
@@ -262,9 +281,9 @@ typedef struct TSS_S0
 
 // TSS are stored in DRAM
 // Intel thinks that each process can have its own TSS.
-// But we can use only one TSS globally.
+// But we can use only one TSS globally (in each core).
 // pointing to Task-State Segment (in main memory) of the current process
-tss_s0_t tr_global_tss;
+extern CORE_LOCAL tss_s0_t tr_global_tss;
 
 // control registers
 typedef struct
@@ -275,27 +294,151 @@ typedef struct
     uint64_t cr3;   // should be a 40-bit PPN for PGD in DRAM
                     // but we are using 48-bit virutal address on simulator's heap
                     // (by malloc())
+    uint64_t asid;  // address space id tagging the TLB lines, as PCID of x86-64
+                    // loaded with cr3 when the process is switched to
 } cpu_cr_t;
-cpu_cr_t cpu_controls;
+extern CORE_LOCAL cpu_cr_t cpu_controls;
+
+// encoding of the instructions fetched by CPU
+// switched with the process, as CR3
+extern CORE_LOCAL inst_encoding_t cpu_inst_encoding;
 
 // move to common.h to be shared by linker
 // #define MAX_INSTRUCTION_CHAR 64
-#define NUM_INSTRTYPE 14
+#define NUM_INSTRTYPE 18
+
 
 // CPU's instruction cycle: execution of instructions
 void instruction_cycle();
 
+// execution of at most max_instructions instructions
+void cpu_run(uint64_t max_instructions);
+
+// compute the condition codes of the latest flag-producing operation
+void evaluate_flags();
+
+#ifdef USE_BLOCK_CACHE
+// execution of a basic block of instructions
+void block_cycle();
+#endif
+
+#ifdef USE_JIT
+// the basic block compiled to host code, called with the address of cpu_reg
+// return 1 if the block is completed
+typedef int (*jit_code_t)(uint8_t *);
+#endif
+
+
+/*--------------------------------------*/
+// the architectural state of one core
+// the registers above are the state of the core running on this thread,
+// core_t is used to load them into a core and to store them back
+typedef struct CORE_STRUCT
+{
+    uint64_t        id;
+    cpu_reg_t       reg;
+    cpu_flags_t     flags;
+    cpu_pc_t        pc;
+    cpu_cr_t        controls;       // CR3 of the process running on the core
+    tss_s0_t        tss;            // ESP0 to the kernel stack of the process
+    inst_encoding_t inst_encoding;
+} core_t;
+
+#ifdef USE_SMP
+// run the cores on host threads in parallel, sharing the physical memory
+// each core executes at most max_instructions instructions
+// the TLB, decode cache and timer of each core are private
+void smp_run(core_t *cores, int num_cores, uint64_t max_instructions);
+
+// TLB shootdown: the TLB of a core is private, so the core replacing a
+// physical page stops the other cores at their instruction boundary,
+// and they flush their TLB when resumed. One stop at a time.
+void smp_stop_cores();
+void smp_resume_cores();
+// called by the core between the instructions
+void smp_check_stop();
+#endif
+
 /*--------------------------------------*/
 // place the functions here because they requires the core_t type
 
 /*--------------------------------------*/
 // mmu functions
 
-uint64_t mmu_vaddr_pagefault;
+extern CORE_LOCAL uint64_t mmu_vaddr_pagefault;
+
+// counted up when any translation is invalidated, so the caches that
+// skip the translation, e.g. the links of blocks, translate again
+extern CORE_LOCAL uint64_t mmu_generation;
 
 // translate the virtual address to physical address in MMU
 // each MMU is owned by each core
 uint64_t va2pa(uint64_t vaddr);
+// translate the address of instruction, by iTLB if the TLB hierarchy is used
+uint64_t va2pa_fetch(uint64_t vaddr);
+// translate the address written, MMU sets the dirty bit of the page
+uint64_t va2pa_write(uint64_t vaddr);
+
+// invalidate all the translations cached in TLB
+void tlb_flush_all();
+
+// invalidate the translation of one virtual page in the address space
+void tlb_invalidate_page(uint64_t asid, uint64_t vaddr);
+
+// invalidate all the translations of the address space
+void tlb_invalidate_asid(uint64_t asid);
+
+// the paging-structure cache skips the upper levels of the page walk
+typedef struct
+{
+    uint64_t walks;         // the page walks on TLB misses
+    uint64_t hits[3];       // the walks started from PUD, PMD and PT
+    uint64_t table_reads;   // the page table entries read by the walks
+} page_walk_stat_t;
+
+// the total of this core since it started
+void page_walk_read_stat(page_walk_stat_t *stat);
+
+// the TLB hierarchy: L1 iTLB and dTLB, and the shared STLB
+typedef enum
+{
+    TLB_RANDOM,
+    TLB_LRU,
+    TLB_PLRU,       // tree-based pseudo LRU, the number of ways is power of 2
+} tlb_replacement_t;
+
+typedef struct
+{
+    int num_sets;   // power of 2, and 0 for no such TLB
+    int num_ways;
+    tlb_replacement_t replacement;
+} tlb_geometry_t;
+
+typedef struct
+{
+    tlb_geometry_t itlb;
+    tlb_geometry_t dtlb;
+    tlb_geometry_t stlb;
+} tlb_config_t;
+
+typedef struct
+{
+    uint64_t hit;
+    uint64_t miss;
+    uint64_t eviction;  // the valid lines replaced
+} tlb_level_stat_t;
+
+typedef struct
+{
+    tlb_level_stat_t itlb;
+    tlb_level_stat_t dtlb;
+    tlb_level_stat_t stlb;
+} tlb_stat_t;
+
+// rebuild the TLBs with the geometry, all the lines and counters are cleared
+void tlb_configure(const tlb_config_t *config);
+void tlb_read_stat(tlb_stat_t *stat);
+
 
 // end of include guard
 #endif
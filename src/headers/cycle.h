@@ -0,0 +1,63 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// include guards to prevent double declaration of any identifiers
+// such as types, enums and static variables
+#ifndef CYCLE_GUARD
+#define CYCLE_GUARD
+
+#include <stdint.h>
+#include <stdio.h>
+#include "headers/common.h"
+
+// the hardware events costing simulated cycles
+typedef enum CYCLE_EVENT
+{
+    CYCLE_INSTRUCTION,      // base cost of one executed instruction
+    CYCLE_DRAM_ACCESS,      // 8-byte access to DRAM without SRAM cache
+    CYCLE_CACHE_HIT,        // 8-byte access through SRAM cache: the hit time
+    CYCLE_CACHE_MISS,       // one missing cache line, besides the line transfer
+    CYCLE_CACHE_EVICTION,   // write back of a dirty victim line
+    CYCLE_BUS_READ,         // one cache line from DRAM: bus_read_cacheline
+    CYCLE_TLB_HIT,
+    CYCLE_TLB_MISS,
+    CYCLE_STLB_HIT,         // L1 TLB miss translated by the second level TLB
+    CYCLE_PAGE_WALK,        // one level of page table read by MMU
+    CYCLE_SWAP_IN,          // one page read from swap space
+    CYCLE_SWAP_OUT,         // one page written to swap space
+    NUM_CYCLE_EVENT,
+} cycle_event_t;
+
+// the latencies in cycles of the events, shared by all cores of machine
+// set them before running to predict another hardware
+extern MACHINE_LOCAL uint64_t cycle_latency[NUM_CYCLE_EVENT];
+
+// the accumulated events and cycles
+typedef struct CYCLE_STAT_STRUCT
+{
+    uint64_t cycles;
+    uint64_t count[NUM_CYCLE_EVENT];
+    uint64_t event_cycles[NUM_CYCLE_EVENT];
+} cycle_stat_t;
+
+// called by the hardware: cost the latency of the event to this core
+void cycle_charge(cycle_event_t event);
+
+// the total of this core since it started
+void cycle_read_stat(cycle_stat_t *stat);
+
+// add the cycles since the last accounting to stat, called by the OS
+// on context switching to charge the cycles to the old process
+void cycle_account(cycle_stat_t *stat);
+
+// print cycles, CPI and the CPI contribution of each event
+void cycle_report(FILE *stream, cycle_stat_t *stat);
+
+#endif
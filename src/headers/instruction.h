@@ -30,9 +30,68 @@ typedef enum OPERAND_TYPE
 typedef struct OPERAND_STRUCT
 {
     od_type_t   type;   // OD_IMM, OD_REG, OD_MEM
-    uint64_t    value;  // the value
+    uint64_t    value;  // the value: immediate number, register address, or memory displacement
+
+    // memory operand `value(reg1, reg2, scal)`
+    // the effective address is computed by ALU in execution
+    // so the decoded operand does not depend on register values
+    uint64_t    reg1;   // address of base register, 0 if absent
+    uint64_t    reg2;   // address of index register, 0 if absent
+    uint64_t    scal;   // scale of index register: 1, 2, 4, 8
 } od_t;
 
+typedef enum INST_OPERATOR
+{
+    INST_MOV,           // 0
+    INST_PUSH,          // 1
+    INST_POP,           // 2
+    INST_LEAVE,         // 3
+    INST_CALL,          // 4
+    INST_RET,           // 5
+    INST_ADD,           // 6
+    INST_SUB,           // 7
+    INST_CMP,           // 8
+    INST_JNE,           // 9
+    INST_JMP,           // 10
+    INST_LEA,           // 11
+    INST_INT,           // 12
+    INST_REP,           // 13: prefix, only before the string operations
+    INST_MOVSB,         // 14
+    INST_MOVSQ,         // 15
+    INST_STOSB,         // 16
+    INST_STOSQ,         // 17
+} op_type_t;
+
+// the handlers specialized by the operator and the operand types
+// so the operand types are not checked again in execution
+typedef enum INST_HANDLER
+{
+    HANDLER_ILLEGAL,        // 0: the operands are not supported
+    HANDLER_MOV_REG_REG,
+    HANDLER_MOV_REG_MEM,
+    HANDLER_MOV_MEM_REG,
+    HANDLER_MOV_IMM_REG,
+    HANDLER_PUSH_REG,
+    HANDLER_POP_REG,
+    HANDLER_LEAVE,
+    HANDLER_CALL,
+    HANDLER_RET,
+    HANDLER_ADD_REG_REG,
+    HANDLER_SUB_IMM_REG,
+    HANDLER_CMP_IMM_MEM,
+    HANDLER_JNE,
+    HANDLER_JMP,
+    HANDLER_LEA_MEM_REG,
+    HANDLER_INT_IMM,
+    // string operations repeated %rcx times
+    HANDLER_REP_MOVSB,
+    HANDLER_REP_MOVSQ,
+    HANDLER_REP_STOSB,
+    HANDLER_REP_STOSQ,
+    NUM_HANDLER,
+
+} handler_type_t;
+
 // handler table storing the handlers to different instruction types
 typedef void (*op_t)(od_t *, od_t *);
 
@@ -42,11 +101,20 @@ typedef void (*op_t)(od_t *, od_t *);
 // Chapter 7 Linking: 7.5 Symbols and Symbol Tables
 typedef struct INST_STRUCT
 {
-    op_t    op;         // enum of operators. e.g. mov, call, etc.
-    od_t    src;        // operand src of instruction
-    od_t    dst;        // operand dst of instruction
+    op_type_t       opcode;     // enum of operators. e.g. mov, call, etc.
+    handler_type_t  handler;    // selected by opcode and operand types in decoding
+    od_t            src;        // operand src of instruction
+    od_t            dst;        // operand dst of instruction
 } inst_t;
 
+// encoding of the instructions in memory
+// like the mode bit of the x86 code segment, it is selected per process
+typedef enum INST_ENCODING
+{
+    INST_ENCODING_TEXT,         // 0: assembly string of MAX_INSTRUCTION_CHAR bytes
+    INST_ENCODING_BINARY,       // 1: variable-length x86-64 machine code
+} inst_encoding_t;
+
 #define MAX_NUM_INSTRUCTION_CYCLE 100
 
 #endif
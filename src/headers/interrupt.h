@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <setjmp.h>
+#include "headers/common.h"
 
 // include guards to prevent double declaration of any identifiers 
 // such as types, enums and static variables
@@ -65,7 +66,7 @@ uint64_t get_kstack_RSP();
  *              process 1, ret addr
  * 
  *                  instruction_cycle
- *                      int_handler
+ *                      int_imm_handler
  *                          increase_pc // this must be called before interrupt
  *                          interrupt_stack_switching
  *                                      // so the pushed RIP will be the next instruction
@@ -82,7 +83,7 @@ uint64_t get_kstack_RSP();
  *              process 1, ret addr
  * 
  *                  instruction_cycle
- *                      add_handler
+ *                      add_reg_reg_handler
  *                      interrupt_stack_switching
  *                                  // so the pushed RIP will be the next instruction
  *                          timer_handler
@@ -96,7 +97,7 @@ uint64_t get_kstack_RSP();
  *                      address translation phase. Check this call stack
  *                  
  *                  instruction_cycle
- *                      mov_handler
+ *                      mov_reg_mem_handler
  *                          va2pa
  *                              page_walk
  *                                  interrupt_stack_switching
@@ -113,6 +114,6 @@ uint64_t get_kstack_RSP();
  *                          cpu_write64bits_dram    // will not be executed due to non-local jump
  *                          increase_pc             // will not be executed due to non-local jump
  */
-jmp_buf USER_INSTRUCTION_ON_IRET;
+extern CORE_LOCAL jmp_buf USER_INSTRUCTION_ON_IRET;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// include guards to prevent double declaration of any identifiers
+// such as types, enums and static variables
+#ifndef LOG_GUARD
+#define LOG_GUARD
+
+#include <stdint.h>
+
+typedef enum LOG_LEVEL
+{
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+} log_level_t;
+
+// the subsystems to be selected by the mask
+#define LOG_MMU             (0x1)
+#define LOG_PAGEFAULT       (0x2)
+#define LOG_SCHEDULE        (0x4)
+#define LOG_INTERRUPT       (0x8)
+#define LOG_SYSCALL         (0x10)
+#define LOG_ALL             (0xff)
+
+#define LOG_MAX_ARGS        (4)
+
+// runtime configuration, shared by all machines of the process
+// a record is kept if its level <= log_level and its subsystem is in log_mask
+extern log_level_t log_level;
+extern uint64_t log_mask;
+
+// The record is not formatted when logging: only the format string and
+// the arguments are copied to the ring, and printf is called in flushing.
+// So the format must be a string literal, and the arguments are integers
+// passed as uint64_t: use the `l` length modifier, e.g. %ld, %lx.
+#define LOG(subsystem, level, format, ...) \
+    do \
+    { \
+        if ((level) <= log_level && (log_mask & (subsystem)) != 0) \
+        { \
+            uint64_t log_args_[] = {0, ##__VA_ARGS__}; \
+            log_record((level), (format), &log_args_[1], \
+                sizeof(log_args_) / sizeof(uint64_t) - 1); \
+        } \
+    } while (0)
+
+void log_record(log_level_t level, const char *format, uint64_t *args, int num_args);
+
+// format and print the records in the ring to stdout
+// called on demand, by the flusher thread, at the high-water mark and at exit
+void log_flush();
+
+// flush the ring every period_us microseconds on a host thread
+// return 0 if the thread cannot be created
+int log_start_flusher(uint64_t period_us);
+void log_stop_flusher();
+
+#endif
@@ -14,6 +14,7 @@
 #define MEMORY_GUARD
 
 #include <stdint.h>
+#include "headers/common.h"
 
 /*======================================*/
 /*      physical memory on dram chips   */
@@ -23,16 +24,27 @@
 // in this simulator, there are 4 + 6 + 6 = 16 bit physical adderss
 // then the physical space is (1 << 16) = 65536
 // total 16 physical memory
+#ifdef USE_HUGE_PAGE
+// one 2MB page takes 512 contiguous physical pages,
+// so the physical address is 22 bits for 2 huge pages
+#define PHYSICAL_MEMORY_SPACE   (4194304)
+#define MAX_NUM_PHYSICAL_PAGE (1024)    // 1 + MAX_INDEX_PHYSICAL_PAGE
+#else
 #define PHYSICAL_MEMORY_SPACE   (65536)
 #define MAX_NUM_PHYSICAL_PAGE (16)    // 1 + MAX_INDEX_PHYSICAL_PAGE
+#endif
 
 #define PAGE_TABLE_ENTRY_NUM    (512)
 #define PAGE_SIZE    (4096)
 
+// the 2MB page mapped by PMD
+#define HUGE_PAGE_SIZE    (2097152)
+#define HUGE_PAGE_FRAME_NUM    (512)    // 4KB physical pages in one 2MB page
+
 // physical memory
 // 16 physical memory pages
 // used only for user process
-uint8_t pm[PHYSICAL_MEMORY_SPACE];
+extern MACHINE_LOCAL uint8_t pm[PHYSICAL_MEMORY_SPACE];
 
 // page table entry struct
 
@@ -49,8 +61,8 @@ typedef union
         uint64_t writethough        : 1;
         uint64_t cachedisabled      : 1;
         uint64_t reference          : 1;
-        uint64_t unused6            : 1;
-        uint64_t smallpage          : 1;
+        uint64_t dirty              : 1;    // 2MB page only
+        uint64_t hugepage           : 1;    // PMD only - 1: paddr is the 2MB page
         uint64_t global             : 1;
         uint64_t unused9_11         : 3;
         /*
@@ -109,6 +121,12 @@ uint64_t cpu_read64bits_dram(uint64_t paddr);
 void cpu_write64bits_dram(uint64_t paddr, uint64_t data);
 void cpu_readinst_dram(uint64_t paddr, char *buf);
 void cpu_writeinst_dram(uint64_t paddr, const char *str);
+void cpu_readcode_dram(uint64_t paddr, uint8_t *buf, uint64_t size);
+void cpu_writecode_dram(uint64_t paddr, const uint8_t *buf, uint64_t size);
+
+// used by string instructions: bulk access inside one physical page
+void cpu_movs_dram(uint64_t dst_paddr, uint64_t src_paddr, uint64_t size, uint64_t width);
+void cpu_stos_dram(uint64_t paddr, uint64_t data, uint64_t size, uint64_t width);
 
 
 void bus_read_cacheline(uint64_t paddr, uint8_t *block);
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "headers/memory.h"
+#include "headers/cycle.h"
 
 // include guards to prevent double declaration of any identifiers 
 // such as types, enums and static variables
@@ -49,20 +50,72 @@ typedef struct PROCESS_CONTROL_BLOCK_STRUCT
             pte123_t *pgd;
         };
 
+        // address space id, loaded with pgd to tag the TLB lines
+        // the processes with the same asid are flushed on switching
+        uint64_t asid;
+
+        // the faults on the 2MB regions without level 4 table
+        // are mapped by 2MB pages, as transparent huge pages
+        int hugepage;
+
         // TODO: vm area
     } mm;
     
     kstack_t *kstack;
 
+    // encoding of the instructions in text section
+    inst_encoding_t inst_encoding;
+
     // it's easier to store the context to PCB
     context_t context;
 
+    // simulated cycles spent by this process, accounted on switching
+    cycle_stat_t cycles;
+
     struct PROCESS_CONTROL_BLOCK_STRUCT *next;
     struct PROCESS_CONTROL_BLOCK_STRUCT *prev;
 } pcb_t;
 
+// physical page descriptor
+typedef struct
+{
+    int allocated;
+    int dirty;
+    int time;   // LRU cache: 0 - Fresh, aged by the scans of reference bit
+
+    // real world: mapping to anon_vma or address_space
+    // we simply the situation here
+    // TODO: if multiple processes are using this page? E.g. Shared library
+    pte4_t *pte4;       // the reversed mapping: from PPN to page table entry
+    uint64_t daddr;   // binding the revesed mapping with mapping to disk
+
+    // the physical page is in a 2MB page, whose first physical page
+    // holds the mapping: pte4 points to the PMD entry, and the
+    // 512 pages are swapped at daddr, daddr + 1, ..., daddr + 511
+    int hugepage;
+
+    // the virtual page mapped to, invalidated in TLB on unmapping
+    // vaddr is -1 if unknown, e.g. mapped by map_pte4 directly
+    uint64_t asid;
+    uint64_t vaddr;
+
+} pd_t;
+
+// the reversed mapping of physical pages, defined in pagefault.c
+extern MACHINE_LOCAL pd_t page_map[MAX_NUM_PHYSICAL_PAGE];
+
 void syscall_init();
 
 pcb_t *get_current_pcb();
 
+// allocate the address space id of the process, defined in schedule.c
+void asid_init();
+void allocate_asid(pcb_t *pcb);
+
+// save the whole machine to file, and restore it by mapping the file:
+// physical memory, registers, page tables, PCB ring, kernel stacks, swap
+// return 1 on success, 0 if the file cannot be written or restored
+int machine_checkpoint(const char *filename);
+int machine_restore(const char *filename);
+
 #endif
\ No newline at end of file
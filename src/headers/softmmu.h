@@ -0,0 +1,99 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// include guards to prevent double declaration of any identifiers
+// such as types, enums and static variables
+#ifndef SOFTMMU_GUARD
+#define SOFTMMU_GUARD
+
+#include <stdint.h>
+#include <string.h>
+#include "headers/common.h"
+#include "headers/memory.h"
+#include "headers/address.h"
+
+// A direct-mapped TLB of host pointers, looked up before va2pa.
+// The entry of a virtual page caches the host address of its physical
+// page in pm, so the access within the page is one tag compare and
+// one host load or store. Only the misses translate by va2pa.
+#define SOFTMMU_INDEX_LENGTH (8)
+
+// the tag of the virtual page, 0 is invalid so the zeroed TLB is empty
+#define SOFTMMU_TAG(vaddr) (((vaddr) >> PHYSICAL_PAGE_OFFSET_LENGTH) + 1)
+
+typedef struct
+{
+    uint64_t    read_tag;
+    uint64_t    write_tag;  // valid if the page is writable without the slow path
+    uint8_t     *page;      // the physical page in pm
+    uint64_t    padding;    // 32 bytes, indexed by shifting
+} softmmu_entry_t;
+
+extern CORE_LOCAL softmmu_entry_t softmmu_tlb[(1 << SOFTMMU_INDEX_LENGTH)];
+
+// set by the write to a page holding decoded instructions
+extern CORE_LOCAL uint8_t softmmu_code_written;
+
+// the slow paths: translate and fill the entry, return the host address
+uint8_t *softmmu_fill_read(uint64_t vaddr);
+uint8_t *softmmu_fill_write(uint64_t vaddr);
+
+// called when the translations are changed: unmapping and CR3
+void softmmu_flush();
+void softmmu_invalidate_page(uint64_t vaddr);
+
+// called when an instruction in the physical page is decoded
+void softmmu_protect_code_page(uint64_t ppn);
+
+static inline softmmu_entry_t *get_softmmu_entry(uint64_t vaddr)
+{
+    return &softmmu_tlb[(vaddr >> PHYSICAL_PAGE_OFFSET_LENGTH) & ((1 << SOFTMMU_INDEX_LENGTH) - 1)];
+}
+
+// the 8 bytes must be in the page for the fast path
+static inline int is_softmmu_in_page(uint64_t vaddr)
+{
+    return (vaddr & (PAGE_SIZE - 1)) <= PAGE_SIZE - 8;
+}
+
+static inline uint64_t softmmu_load64(uint64_t vaddr)
+{
+    softmmu_entry_t *entry = get_softmmu_entry(vaddr);
+    uint8_t *host;
+    if (entry->read_tag == SOFTMMU_TAG(vaddr) && is_softmmu_in_page(vaddr))
+    {
+        host = entry->page + (vaddr & (PAGE_SIZE - 1));
+    }
+    else
+    {
+        host = softmmu_fill_read(vaddr);
+    }
+    // little-endian host as the guest
+    uint64_t data;
+    memcpy(&data, host, sizeof(uint64_t));
+    return data;
+}
+
+static inline void softmmu_store64(uint64_t vaddr, uint64_t data)
+{
+    softmmu_entry_t *entry = get_softmmu_entry(vaddr);
+    uint8_t *host;
+    if (entry->write_tag == SOFTMMU_TAG(vaddr) && is_softmmu_in_page(vaddr))
+    {
+        host = entry->page + (vaddr & (PAGE_SIZE - 1));
+    }
+    else
+    {
+        host = softmmu_fill_write(vaddr);
+    }
+    memcpy(host, &data, sizeof(uint64_t));
+}
+
+#endif
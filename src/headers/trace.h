@@ -0,0 +1,54 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// include guards to prevent double declaration of any identifiers
+// such as types, enums and static variables
+#ifndef TRACE_GUARD
+#define TRACE_GUARD
+
+#include <stdint.h>
+
+// the kind of one trace record
+typedef enum TRACE_KIND
+{
+    TRACE_INST,     // rip of an executed instruction
+    TRACE_FETCH,    // address translation of the instruction fetch
+    TRACE_READ,     // 8-byte data read
+    TRACE_WRITE,    // 8-byte data write
+} trace_kind_t;
+
+// the result of replaying a trace on the TLB and SRAM cache
+typedef struct TRACE_STAT_STRUCT
+{
+    uint64_t instructions;
+    uint64_t fetches;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t tlb_hit;
+    uint64_t tlb_miss;
+    uint64_t cache_hit;
+    uint64_t cache_miss;
+} trace_stat_t;
+
+// recording: all instructions executed by this core between start and stop
+void trace_start(const char *filename);
+void trace_stop();
+
+// called by the hardware in recording
+void trace_instruction(uint64_t rip);
+void trace_translation(uint64_t vaddr);
+void trace_fetch(uint64_t vaddr, uint64_t paddr);
+void trace_memory_access(uint64_t paddr, trace_kind_t kind);
+void trace_cache_miss();
+
+// replaying: drive the TLB and SRAM cache without executing instructions
+void trace_replay(const char *filename, trace_stat_t *stat);
+
+#endif
@@ -0,0 +1,493 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// throughput of the simulator on a set of guest workloads
+// the configuration to measure is selected in compiling, e.g.
+//      -DUSE_NAVIE_VA2PA
+//      -DUSE_PAGETABLE_VA2PA -DUSE_TLB_HARDWARE -DUSE_SRAM_CACHE
+// usage: bench [workload ...], all workloads by default
+// each workload prints one line:
+//      <config> <workload> <instructions> <seconds> <MIPS>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+#if defined(USE_NAVIE_VA2PA)
+#define BENCH_CONFIG "navie"
+#elif defined(USE_JIT)
+#define BENCH_CONFIG "pagetable+softmmu+jit"
+#elif defined(USE_SOFTMMU)
+#define BENCH_CONFIG "pagetable+softmmu"
+#elif defined(USE_PAGE_WALK_CACHE)
+#define BENCH_CONFIG "pagetable+tlb+pwc"
+#elif defined(USE_TLB_HARDWARE) && defined(USE_SRAM_CACHE)
+#define BENCH_CONFIG "pagetable+tlb+sram"
+#elif defined(USE_TLB_HARDWARE)
+#define BENCH_CONFIG "pagetable+tlb"
+#elif defined(USE_SRAM_CACHE)
+#define BENCH_CONFIG "pagetable+sram"
+#else
+#define BENCH_CONFIG "pagetable"
+#endif
+
+void page_map_init();
+
+// from isa.c
+void read_timer(uint64_t *time, uint64_t *countdown);
+
+#ifdef USE_DECODE_CACHE
+void invalidate_decode_cache(uint64_t paddr, uint64_t size);
+#endif
+
+#ifdef USE_SRAM_CACHE
+void sram_cache_invalidate();
+#endif
+
+// The guest address space. With NAVIE va2pa the virtual address is taken
+// modulo the physical memory, so the regions are kept apart in 64KB:
+//  code    0x0000 - 0x1fff
+//  data    0x4000 - 0xdfff
+//  stack   0xe000 - 0xefff
+#define CODE_BASE       (0x00400000)
+#define DATA_BASE       (0x7fffffe04000)
+#define STACK_TOP       (0x7ffffffeeff0)
+// far away from the others, only used with page table
+#define SWAP_DATA_BASE  (0x7fff00000000)
+
+// the instruction cycles of one cpu_run
+#define RUN_LENGTH (256)
+
+// two code pages
+#define MAX_PROGRAM_LENGTH (2 * PAGE_SIZE / MAX_INSTRUCTION_CHAR)
+
+typedef struct
+{
+    char inst[MAX_PROGRAM_LENGTH][MAX_INSTRUCTION_CHAR];
+    int count;
+    int entry;      // index of the first instruction to run
+    int halt;       // index of the dead loop ending the program
+} program_t;
+
+// append an instruction, return its index
+static int emit(program_t *p, const char *format, ...)
+{
+    assert(p->count < MAX_PROGRAM_LENGTH);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(p->inst[p->count], MAX_INSTRUCTION_CHAR, format, args);
+    va_end(args);
+    p->count += 1;
+    return p->count - 1;
+}
+
+// overwrite an instruction: a forward jump after its target is known
+static void patch(program_t *p, int index, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(p->inst[index], MAX_INSTRUCTION_CHAR, format, args);
+    va_end(args);
+}
+
+// the virtual address of the instruction
+static uint64_t at(int index)
+{
+    return CODE_BASE + index * MAX_INSTRUCTION_CHAR;
+}
+
+static void emit_halt(program_t *p)
+{
+    p->halt = p->count;
+    emit(p, "jmp    0x%lx", at(p->halt));
+}
+
+/*======================================*/
+/*      workloads                       */
+/*======================================*/
+
+// each workload leaves its result in %rax before halting
+
+static void build_array_sum(program_t *p)
+{
+    // 512 qwords of 3, summed 200 times
+    emit(p, "mov    $0x%lx,%%rdi", DATA_BASE);
+    emit(p, "mov    $0x200,%%rcx");
+    emit(p, "mov    $0x3,%%rax");
+    emit(p, "rep    stosq");
+    emit(p, "mov    $0xc8,%%rbx");
+    int outer = emit(p, "mov    $0x%lx,%%rsi", DATA_BASE);
+    emit(p, "mov    $0x200,%%rcx");
+    emit(p, "mov    $0x0,%%rax");
+    int inner = emit(p, "mov    (%%rsi),%%rdx");
+    emit(p, "add    %%rdx,%%rax");
+    emit(p, "lea    0x8(%%rsi),%%rsi");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(inner));
+    emit(p, "sub    $0x1,%%rbx");
+    emit(p, "jne    0x%lx", at(outer));
+    emit_halt(p);
+}
+
+static void build_fibonacci(program_t *p)
+{
+    // recursive fib(22), call and return heavy
+    int fib = emit(p, "push   %%rbp");
+    emit(p, "mov    %%rsp,%%rbp");
+    emit(p, "sub    $0x10,%%rsp");
+    emit(p, "mov    %%rdi,-0x8(%%rbp)");
+    emit(p, "cmpq   $0x0,-0x8(%%rbp)");
+    int jne_one = emit(p, "");
+    emit(p, "mov    $0x0,%%rax");
+    int jmp_zero = emit(p, "");
+    patch(p, jne_one, "jne    0x%lx", at(p->count));
+    emit(p, "cmpq   $0x1,-0x8(%%rbp)");
+    int jne_rec = emit(p, "");
+    emit(p, "mov    $0x1,%%rax");
+    int jmp_one = emit(p, "");
+    patch(p, jne_rec, "jne    0x%lx", at(p->count));
+    emit(p, "mov    -0x8(%%rbp),%%rdi");
+    emit(p, "sub    $0x1,%%rdi");
+    emit(p, "callq  0x%lx", at(fib));
+    emit(p, "mov    %%rax,-0x10(%%rbp)");
+    emit(p, "mov    -0x8(%%rbp),%%rdi");
+    emit(p, "sub    $0x2,%%rdi");
+    emit(p, "callq  0x%lx", at(fib));
+    emit(p, "mov    -0x10(%%rbp),%%rdx");
+    emit(p, "add    %%rdx,%%rax");
+    patch(p, jmp_zero, "jmp    0x%lx", at(p->count));
+    patch(p, jmp_one, "jmp    0x%lx", at(p->count));
+    emit(p, "leaveq ");
+    emit(p, "retq   ");
+
+    p->entry = emit(p, "mov    $0x16,%%rdi");
+    emit(p, "callq  0x%lx", at(fib));
+    emit_halt(p);
+}
+
+static void build_memcpy(program_t *p)
+{
+    // copy 4KB qword by qword, 150 times
+    emit(p, "mov    $0x%lx,%%rdi", DATA_BASE);
+    emit(p, "mov    $0x200,%%rcx");
+    emit(p, "mov    $0x5,%%rax");
+    emit(p, "rep    stosq");
+    emit(p, "mov    $0x96,%%rbx");
+    int outer = emit(p, "mov    $0x%lx,%%rsi", DATA_BASE);
+    emit(p, "mov    $0x%lx,%%rdi", DATA_BASE + 0x2000);
+    emit(p, "mov    $0x200,%%rcx");
+    int inner = emit(p, "mov    (%%rsi),%%rdx");
+    emit(p, "mov    %%rdx,(%%rdi)");
+    emit(p, "lea    0x8(%%rsi),%%rsi");
+    emit(p, "lea    0x8(%%rdi),%%rdi");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(inner));
+    emit(p, "sub    $0x1,%%rbx");
+    emit(p, "jne    0x%lx", at(outer));
+    emit(p, "mov    -0x8(%%rdi),%%rax");
+    emit_halt(p);
+}
+
+static void build_pointer_chase(program_t *p)
+{
+    // a ring of 64 nodes over 10 pages, followed 0x40000 steps
+    emit(p, "mov    $0x%lx,%%rsi", DATA_BASE);
+    emit(p, "mov    $0x3f,%%rcx");
+    int link = emit(p, "lea    0x248(%%rsi),%%rdx");
+    emit(p, "mov    %%rdx,(%%rsi)");
+    emit(p, "mov    %%rdx,%%rsi");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(link));
+    emit(p, "mov    $0x%lx,%%rdx", DATA_BASE);
+    emit(p, "mov    %%rdx,(%%rsi)");
+    emit(p, "mov    $0x40000,%%rcx");
+    int chase = emit(p, "mov    (%%rsi),%%rsi");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(chase));
+    emit(p, "mov    %%rsi,%%rax");
+    emit_halt(p);
+}
+
+static void build_matrix_multiply(program_t *p)
+{
+    // C = A * B of 8x8 qwords, 100 times
+    // there is no multiplication in ISA: A[i][k] is added B[k][j] times
+    uint64_t a = DATA_BASE, b = DATA_BASE + 0x200, c = DATA_BASE + 0x400;
+    emit(p, "mov    $0x%lx,%%rdi", a);
+    emit(p, "mov    $0x40,%%rcx");
+    emit(p, "mov    $0x2,%%rax");
+    emit(p, "rep    stosq");
+    emit(p, "mov    $0x%lx,%%rdi", b);
+    emit(p, "mov    $0x40,%%rcx");
+    emit(p, "mov    $0x3,%%rax");
+    emit(p, "rep    stosq");
+    emit(p, "mov    $0x64,%%r15");
+    int loop_r = emit(p, "mov    $0x%lx,%%r11", a);
+    emit(p, "mov    $0x%lx,%%r13", c);
+    emit(p, "mov    $0x8,%%r8");
+    int loop_i = emit(p, "mov    $0x%lx,%%r14", b);
+    emit(p, "mov    $0x8,%%r9");
+    int loop_j = emit(p, "mov    $0x0,%%rax");
+    emit(p, "mov    %%r11,%%rsi");
+    emit(p, "mov    %%r14,%%rdi");
+    emit(p, "mov    $0x8,%%r10");
+    int loop_k = emit(p, "mov    (%%rsi),%%rdx");
+    emit(p, "mov    (%%rdi),%%rcx");
+    int loop_m = emit(p, "add    %%rdx,%%rax");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(loop_m));
+    emit(p, "lea    0x8(%%rsi),%%rsi");
+    emit(p, "lea    0x40(%%rdi),%%rdi");
+    emit(p, "sub    $0x1,%%r10");
+    emit(p, "jne    0x%lx", at(loop_k));
+    emit(p, "mov    %%rax,(%%r13)");
+    emit(p, "lea    0x8(%%r13),%%r13");
+    emit(p, "lea    0x8(%%r14),%%r14");
+    emit(p, "sub    $0x1,%%r9");
+    emit(p, "jne    0x%lx", at(loop_j));
+    emit(p, "lea    0x40(%%r11),%%r11");
+    emit(p, "sub    $0x1,%%r8");
+    emit(p, "jne    0x%lx", at(loop_i));
+    emit(p, "sub    $0x1,%%r15");
+    emit(p, "jne    0x%lx", at(loop_r));
+    emit_halt(p);
+}
+
+static void build_syscall(program_t *p)
+{
+    // 50000 getpid, the counter is kept in the user stack
+    emit(p, "mov    $0xc350,%%rbx");
+    emit(p, "push   %%rbx");
+    int loop = emit(p, "mov    $0x27,%%rax");
+    emit(p, "int    $0x80");
+    emit(p, "mov    (%%rsp),%%rcx");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "mov    %%rcx,(%%rsp)");
+    emit(p, "cmpq   $0x0,(%%rsp)");
+    emit(p, "jne    0x%lx", at(loop));
+    emit(p, "mov    (%%rsp),%%rax");
+    emit_halt(p);
+}
+
+static void build_page_fault(program_t *p)
+{
+    // 32 pages written in turn by 20 rounds, more than the physical pages,
+    // so nearly every write swaps a page out and another in
+    emit(p, "mov    $0x14,%%rbx");
+    int outer = emit(p, "mov    $0x%lx,%%rsi", SWAP_DATA_BASE);
+    emit(p, "mov    $0x20,%%rcx");
+    int inner = emit(p, "mov    %%rbx,(%%rsi)");
+    emit(p, "lea    0x1000(%%rsi),%%rsi");
+    emit(p, "sub    $0x1,%%rcx");
+    emit(p, "jne    0x%lx", at(inner));
+    emit(p, "sub    $0x1,%%rbx");
+    emit(p, "jne    0x%lx", at(outer));
+    emit(p, "mov    -0x1000(%%rsi),%%rax");
+    emit_halt(p);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*build)(program_t *p);
+    uint64_t result;    // expected %rax at halt
+    int paging;         // 1 if it needs page faults, not run with NAVIE
+} workload_t;
+
+static workload_t workloads[] = {
+    {"array_sum",       build_array_sum,        0x600,                          0},
+    {"fibonacci",       build_fibonacci,        17711,                          0},
+    {"memcpy",          build_memcpy,           0x5,                            0},
+    {"pointer_chase",   build_pointer_chase,    DATA_BASE + 0x3f * 0x248,       0},
+    {"matrix_multiply", build_matrix_multiply,  0x30,                           0},
+    {"syscall",         build_syscall,          0x0,                            0},
+    {"page_fault",      build_page_fault,       0x1,                            1},
+};
+
+/*======================================*/
+/*      machine                         */
+/*======================================*/
+
+static double wall_clock()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// the program runs as the only process
+static pcb_t p1;
+static pte123_t pgd[PAGE_TABLE_ENTRY_NUM];
+static pte123_t pud[PAGE_TABLE_ENTRY_NUM];
+static pte123_t pmd[PAGE_TABLE_ENTRY_NUM];
+static pte4_t pt[PAGE_TABLE_ENTRY_NUM];
+static uint8_t stack_buf[KERNEL_STACK_SIZE * 2];
+
+// boot a fresh machine running the program as a single process
+// the page tables of the faulting pages are not freed: it is a benchmark
+static void boot_workload(program_t *program)
+{
+    memset(pm, 0, PHYSICAL_MEMORY_SPACE);
+    memset(&cpu_reg, 0, sizeof(cpu_reg));
+    memset(&cpu_flags, 0, sizeof(cpu_flags));
+    page_map_init();
+    tlb_flush_all();
+    asid_init();
+#ifdef USE_SRAM_CACHE
+    sram_cache_invalidate();
+#endif
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(0, PHYSICAL_MEMORY_SPACE);
+#endif
+
+    memset(&p1, 0, sizeof(pcb_t));
+    p1.pid = 1;
+    p1.next = &p1;
+    p1.prev = &p1;
+
+    memset(pgd, 0, sizeof(pgd));
+    memset(pud, 0, sizeof(pud));
+    memset(pmd, 0, sizeof(pmd));
+    memset(pt, 0, sizeof(pt));
+    p1.mm.pgd = pgd;
+    allocate_asid(&p1);
+
+    // the code pages are physical page 1 and 2
+    for (int i = 0; i < 2; ++ i)
+    {
+        address_t code_addr = {.address_value = CODE_BASE + i * PAGE_SIZE};
+        link_page_table(pgd, pud, pmd, pt, 1 + i, &code_addr);
+    }
+    cpu_controls.cr3 = p1.mm.pgd_paddr;
+    cpu_controls.asid = p1.mm.asid;
+    for (int i = 0; i < program->count; ++ i)
+    {
+        cpu_writeinst_dram(va2pa(at(i)), program->inst[i]);
+    }
+
+    p1.kstack = (kstack_t *)((((uint64_t)stack_buf + KERNEL_STACK_SIZE) >> 13) << 13);
+    p1.kstack->threadinfo.pcb = &p1;
+    tr_global_tss.ESP0 = (uint64_t)p1.kstack + KERNEL_STACK_SIZE;
+
+    idt_init();
+    syscall_init();
+
+    cpu_reg.rsp = STACK_TOP;
+    cpu_reg.rbp = STACK_TOP;
+    cpu_pc.rip = at(program->entry);
+}
+
+static void run_workload(workload_t *w)
+{
+    static program_t program;
+    memset(&program, 0, sizeof(program_t));
+    w->build(&program);
+    uint64_t halt = at(program.halt);
+
+#ifndef USE_BLOCK_CACHE
+    // the interrupts return into cpu_run, so the halting is only checked
+    // between the runs and the last run goes on looping at the halt.
+    // Count the runs in a dry run, then the measured run steps the last
+    // one instruction by instruction to stop exactly at the halt
+    boot_workload(&program);
+    uint64_t runs = 0;
+    while (cpu_pc.rip != halt)
+    {
+        cpu_run(RUN_LENGTH);
+        runs += 1;
+    }
+#endif
+
+    boot_workload(&program);
+
+    uint64_t begin_time, end_time, countdown;
+    read_timer(&begin_time, &countdown);
+#ifdef USE_PAGE_WALK_CACHE
+    page_walk_stat_t begin_walk, end_walk;
+    page_walk_read_stat(&begin_walk);
+#endif
+    double begin = wall_clock();
+
+#ifdef USE_BLOCK_CACHE
+    // a block ends at the jump to the halt
+    while (cpu_pc.rip != halt)
+    {
+        block_cycle();
+    }
+#else
+    for (uint64_t i = 1; i < runs && cpu_pc.rip != halt; ++ i)
+    {
+        cpu_run(RUN_LENGTH);
+    }
+    while (cpu_pc.rip != halt)
+    {
+        instruction_cycle();
+    }
+#endif
+
+    double seconds = wall_clock() - begin;
+    read_timer(&end_time, &countdown);
+    uint64_t instructions = end_time - begin_time;
+
+    if (cpu_reg.rax != w->result)
+    {
+        printf("%s: wrong result 0x%lx, expected 0x%lx\n", w->name, cpu_reg.rax, w->result);
+        exit(1);
+    }
+
+    printf("%-20s %-16s %12lu %10.3f %10.3f\n", BENCH_CONFIG, w->name,
+        instructions, seconds, instructions / seconds / 1e6);
+#ifdef USE_PAGE_WALK_CACHE
+    // the walks saved by the paging-structure cache
+    page_walk_read_stat(&end_walk);
+    printf("    page walks %lu, started from PUD/PMD/PT %lu/%lu/%lu, table reads %lu\n",
+        end_walk.walks - begin_walk.walks,
+        end_walk.hits[0] - begin_walk.hits[0],
+        end_walk.hits[1] - begin_walk.hits[1],
+        end_walk.hits[2] - begin_walk.hits[2],
+        end_walk.table_reads - begin_walk.table_reads);
+#endif
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_workloads = sizeof(workloads) / sizeof(workload_t);
+    for (int i = 0; i < num_workloads; ++ i)
+    {
+        int selected = (argc == 1);
+        for (int j = 1; j < argc; ++ j)
+        {
+            selected = selected || (strcmp(argv[j], workloads[i].name) == 0);
+        }
+
+#ifdef USE_NAVIE_VA2PA
+        // without page table, there is no page fault
+        selected = selected && (workloads[i].paging == 0);
+#endif
+
+        if (selected == 1)
+        {
+            run_workload(&workloads[i]);
+        }
+    }
+    return 0;
+}
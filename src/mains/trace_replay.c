@@ -0,0 +1,69 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+// replay a recorded execution trace on the TLB and SRAM cache
+// the geometry is passed in by the marcos, e.g.
+//      -DTLB_CACHE_INDEX_LENGTH=3 -DNUM_TLB_CACHE_LINE_PER_SET=4
+//      -DSRAM_CACHE_INDEX_LENGTH=5 -DNUM_CACHE_LINE_PER_SET=2
+// so one captured run can be compared over many configurations
+// with -DUSE_TLB_HIERARCHY, the levels of TLB are counted separately
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "headers/cpu.h"
+#include "headers/address.h"
+#include "headers/trace.h"
+
+static double ratio(uint64_t a, uint64_t b)
+{
+    return b == 0 ? 0.0 : 100.0 * a / b;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        printf("usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    clock_t begin = clock();
+    trace_stat_t stat;
+    trace_replay(argv[1], &stat);
+    double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    printf("instructions    %lu\n", stat.instructions);
+    printf("fetches         %lu\n", stat.fetches);
+    printf("reads           %lu\n", stat.reads);
+    printf("writes          %lu\n", stat.writes);
+    printf("TLB     sets %d    hit %lu    miss %lu    miss rate %.2f%%\n",
+        (1 << TLB_CACHE_INDEX_LENGTH),
+        stat.tlb_hit, stat.tlb_miss, ratio(stat.tlb_miss, stat.tlb_hit + stat.tlb_miss));
+#ifdef USE_TLB_HIERARCHY
+    tlb_stat_t tlb;
+    tlb_read_stat(&tlb);
+    tlb_level_stat_t *levels[3] = {&tlb.itlb, &tlb.dtlb, &tlb.stlb};
+    const char *names[3] = {"iTLB", "dTLB", "STLB"};
+    for (int i = 0; i < 3; ++ i)
+    {
+        printf("  %s  hit %lu    miss %lu    eviction %lu    miss rate %.2f%%\n",
+            names[i], levels[i]->hit, levels[i]->miss, levels[i]->eviction,
+            ratio(levels[i]->miss, levels[i]->hit + levels[i]->miss));
+    }
+#endif
+    printf("SRAM    sets %d    hit %lu    miss %lu    miss rate %.2f%%\n",
+        (1 << SRAM_CACHE_INDEX_LENGTH),
+        stat.cache_hit, stat.cache_miss, ratio(stat.cache_miss, stat.cache_hit + stat.cache_miss));
+    printf("replayed in %.3f s\n", seconds);
+
+    return 0;
+}
@@ -0,0 +1,522 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+
+/*  The checkpoint file is laid out to be mapped, not read:
+
+    +-------------------+ 0
+    |  header           |   registers, timer, page map, section offsets
+    +-------------------+ PAGE_SIZE aligned
+    |  physical memory  |   mapped onto `pm` directly
+    +-------------------+
+    |  page tables      |   4KB each, PGD/PUD/PMD entries hold file offsets
+    +-------------------+
+    |  PCB ring         |   next/prev/kstack/pgd hold file offsets
+    +-------------------+ KERNEL_STACK_SIZE aligned
+    |  kernel stacks    |   8KB each, aligned for get_kstack_RSP
+    +-------------------+
+    |  swap pages       |   raw 4KB pages and their disk addresses
+    +-------------------+
+
+    Restoring maps the file privately (copy-on-write) and relocates the
+    offsets to the pointers into the mapping. Only the pages holding the
+    pointers are copied by kernel, the physical memory is never copied.
+ */
+
+#ifdef USE_HUGE_PAGE
+#error "checkpoint relocates PMD entries as pointers, not the 2MB pages"
+#endif
+
+#define CHECKPOINT_MAGIC "BCSTCKP3"
+#define MAX_CHECKPOINT_TABLES (1024)
+#define MAX_CHECKPOINT_PCBS (64)
+#define MAX_CHECKPOINT_SWAP_PAGES (256)
+
+typedef struct
+{
+    char        magic[8];
+    uint64_t    size;
+
+    uint64_t    pm_offset;
+    uint64_t    num_tables;
+    uint64_t    table_offset;
+    uint64_t    num_pcbs;
+    uint64_t    pcb_offset;
+    uint64_t    kstack_offset;
+    uint64_t    num_swap_pages;
+    uint64_t    swap_offset;
+
+    // the core: CR3 and ESP0 are file offsets
+    core_t      core;
+    uint64_t    global_time;
+    uint64_t    timer_countdown;
+
+    // the level (1 to 4) of each table
+    uint8_t     table_level[MAX_CHECKPOINT_TABLES];
+
+    // pte4 pointers are file offsets
+    pd_t        page_map[MAX_NUM_PHYSICAL_PAGE];
+    uint64_t    swap_daddr[MAX_CHECKPOINT_SWAP_PAGES];
+} checkpoint_header_t;
+
+// from isa.c
+void read_timer(uint64_t *time, uint64_t *countdown);
+void write_timer(uint64_t time, uint64_t countdown);
+
+// from swap.c
+void read_swappage(uint64_t daddr, uint8_t *page);
+uint64_t copy_swappage(uint8_t *page);
+
+#ifdef USE_DECODE_CACHE
+void invalidate_decode_cache(uint64_t paddr, uint64_t size);
+#endif
+
+#ifdef USE_SRAM_CACHE
+void sram_cache_flush();
+void sram_cache_invalidate();
+#endif
+
+// the mapping of the last restored checkpoint of this machine
+static MACHINE_LOCAL uint8_t *restored_base = NULL;
+static MACHINE_LOCAL uint64_t restored_size = 0;
+
+static inline uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/*======================================*/
+/*      checkpoint                      */
+/*======================================*/
+
+// the objects to save, found from the current process
+typedef struct
+{
+    pte123_t    *tables[MAX_CHECKPOINT_TABLES];
+    pcb_t       *pcbs[MAX_CHECKPOINT_PCBS];
+    checkpoint_header_t header;
+} checkpoint_t;
+
+static uint64_t find_table(checkpoint_t *ckpt, pte123_t *table)
+{
+    for (uint64_t i = 0; i < ckpt->header.num_tables; ++ i)
+    {
+        if (ckpt->tables[i] == table)
+        {
+            return i;
+        }
+    }
+    assert(0);
+    return 0;
+}
+
+static uint64_t find_pcb(checkpoint_t *ckpt, pcb_t *pcb)
+{
+    for (uint64_t i = 0; i < ckpt->header.num_pcbs; ++ i)
+    {
+        if (ckpt->pcbs[i] == pcb)
+        {
+            return i;
+        }
+    }
+    assert(0);
+    return 0;
+}
+
+// collect the table and its present sub-tables
+static void collect_table(checkpoint_t *ckpt, pte123_t *table, int level)
+{
+    for (uint64_t i = 0; i < ckpt->header.num_tables; ++ i)
+    {
+        if (ckpt->tables[i] == table)
+        {
+            // shared by processes
+            return;
+        }
+    }
+    assert(ckpt->header.num_tables < MAX_CHECKPOINT_TABLES);
+    ckpt->tables[ckpt->header.num_tables] = table;
+    ckpt->header.table_level[ckpt->header.num_tables] = level;
+    ckpt->header.num_tables += 1;
+
+    if (level == 4)
+    {
+        return;
+    }
+    for (int i = 0; i < PAGE_TABLE_ENTRY_NUM; ++ i)
+    {
+        if (table[i].present == 1)
+        {
+            collect_table(ckpt, (pte123_t *)((uint64_t)table[i].paddr), level + 1);
+        }
+    }
+}
+
+static void collect_swap_page(checkpoint_t *ckpt, uint64_t daddr)
+{
+    if (daddr == 0)
+    {
+        return;
+    }
+    for (uint64_t i = 0; i < ckpt->header.num_swap_pages; ++ i)
+    {
+        if (ckpt->header.swap_daddr[i] == daddr)
+        {
+            return;
+        }
+    }
+    assert(ckpt->header.num_swap_pages < MAX_CHECKPOINT_SWAP_PAGES);
+    ckpt->header.swap_daddr[ckpt->header.num_swap_pages] = daddr;
+    ckpt->header.num_swap_pages += 1;
+}
+
+static uint64_t table_entry_offset(checkpoint_t *ckpt, void *entry)
+{
+    for (uint64_t i = 0; i < ckpt->header.num_tables; ++ i)
+    {
+        uint64_t table = (uint64_t)ckpt->tables[i];
+        if (table <= (uint64_t)entry && (uint64_t)entry < table + PAGE_SIZE)
+        {
+            return ckpt->header.table_offset + i * PAGE_SIZE + ((uint64_t)entry - table);
+        }
+    }
+    assert(0);
+    return 0;
+}
+
+// return 1 if all bytes are written
+static int write_at(FILE *fw, uint64_t offset, void *buf, uint64_t size)
+{
+    if (fseek(fw, offset, SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    uint64_t written = fwrite(buf, 1, size, fw);
+    return written == size;
+}
+
+// called between instructions, the current process is found by TSS
+// return 1 if the checkpoint file is written, 0 on I/O failure
+int machine_checkpoint(const char *filename)
+{
+    checkpoint_t *ckpt = calloc(1, sizeof(checkpoint_t));
+    if (ckpt == NULL)
+    {
+        return 0;
+    }
+    checkpoint_header_t *h = &ckpt->header;
+
+#ifdef USE_SRAM_CACHE
+    // the dirty lines are the latest data of physical memory
+    sram_cache_flush();
+#endif
+
+    // the PCB ring starting from the current process
+    pcb_t *current = ((kstack_t *)(tr_global_tss.ESP0 - KERNEL_STACK_SIZE))->threadinfo.pcb;
+    pcb_t *pcb = current;
+    do
+    {
+        assert(h->num_pcbs < MAX_CHECKPOINT_PCBS);
+        ckpt->pcbs[h->num_pcbs] = pcb;
+        h->num_pcbs += 1;
+        collect_table(ckpt, pcb->mm.pgd, 1);
+        pcb = pcb->next;
+    } while (pcb != current);
+
+    // the swap pages: of the mapped pages and of the swapped out pages
+    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        if (page_map[i].allocated == 1)
+        {
+            collect_swap_page(ckpt, page_map[i].daddr);
+        }
+    }
+    for (uint64_t i = 0; i < h->num_tables; ++ i)
+    {
+        pte4_t *pt = (pte4_t *)ckpt->tables[i];
+        for (int j = 0; j < PAGE_TABLE_ENTRY_NUM && h->table_level[i] == 4; ++ j)
+        {
+            if (pt[j].present == 0)
+            {
+                collect_swap_page(ckpt, pt[j].daddr);
+            }
+        }
+    }
+
+    // layout
+    uint64_t offset = align_up(sizeof(checkpoint_header_t), PAGE_SIZE);
+    h->pm_offset = offset;
+    offset += PHYSICAL_MEMORY_SPACE;
+    h->table_offset = offset;
+    offset += h->num_tables * PAGE_SIZE;
+    h->pcb_offset = offset;
+    offset += h->num_pcbs * sizeof(pcb_t);
+    h->kstack_offset = align_up(offset, KERNEL_STACK_SIZE);
+    offset = h->kstack_offset + h->num_pcbs * KERNEL_STACK_SIZE;
+    h->swap_offset = offset;
+    offset += h->num_swap_pages * PAGE_SIZE;
+    h->size = offset;
+    memcpy(h->magic, CHECKPOINT_MAGIC, 8);
+
+    FILE *fw = fopen(filename, "wb");
+    if (fw == NULL)
+    {
+        free(ckpt);
+        return 0;
+    }
+
+    // 1 if all writes succeed
+    int ok = write_at(fw, h->pm_offset, pm, PHYSICAL_MEMORY_SPACE);
+
+    // page tables: the pointers to the sub-tables become file offsets
+    for (uint64_t i = 0; i < h->num_tables; ++ i)
+    {
+        pte123_t table[PAGE_TABLE_ENTRY_NUM];
+        memcpy(table, ckpt->tables[i], PAGE_SIZE);
+        for (int j = 0; j < PAGE_TABLE_ENTRY_NUM && h->table_level[i] < 4; ++ j)
+        {
+            if (table[j].present == 1)
+            {
+                uint64_t k = find_table(ckpt, (pte123_t *)((uint64_t)table[j].paddr));
+                table[j].paddr = h->table_offset + k * PAGE_SIZE;
+            }
+        }
+        ok &= write_at(fw, h->table_offset + i * PAGE_SIZE, table, PAGE_SIZE);
+    }
+
+    // PCBs and their kernel stacks
+    for (uint64_t i = 0; i < h->num_pcbs; ++ i)
+    {
+        pcb_t p = *ckpt->pcbs[i];
+        p.mm.pgd_paddr = h->table_offset + find_table(ckpt, p.mm.pgd) * PAGE_SIZE;
+        p.kstack = (kstack_t *)(h->kstack_offset + i * KERNEL_STACK_SIZE);
+        p.next = (pcb_t *)(h->pcb_offset + find_pcb(ckpt, p.next) * sizeof(pcb_t));
+        p.prev = (pcb_t *)(h->pcb_offset + find_pcb(ckpt, p.prev) * sizeof(pcb_t));
+        ok &= write_at(fw, h->pcb_offset + i * sizeof(pcb_t), &p, sizeof(pcb_t));
+
+        kstack_t ks = *ckpt->pcbs[i]->kstack;
+        ks.threadinfo.pcb = (pcb_t *)(h->pcb_offset + i * sizeof(pcb_t));
+        ok &= write_at(fw, h->kstack_offset + i * KERNEL_STACK_SIZE, &ks, KERNEL_STACK_SIZE);
+    }
+
+    // swap pages
+    for (uint64_t i = 0; i < h->num_swap_pages; ++ i)
+    {
+        uint8_t page[PAGE_SIZE];
+        read_swappage(h->swap_daddr[i], page);
+        ok &= write_at(fw, h->swap_offset + i * PAGE_SIZE, page, PAGE_SIZE);
+    }
+
+    // page map: the reversed mappings point to the level 4 tables
+    memcpy(h->page_map, page_map, sizeof(page_map));
+    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        if (page_map[i].pte4 != NULL)
+        {
+            h->page_map[i].pte4 = (pte4_t *)table_entry_offset(ckpt, page_map[i].pte4);
+        }
+    }
+
+    // the core
+    memcpy(&h->core.reg, &cpu_reg, sizeof(cpu_reg_t));
+    memcpy(&h->core.flags, &cpu_flags, sizeof(cpu_flags_t));
+    h->core.pc = cpu_pc;
+    h->core.controls = cpu_controls;
+    h->core.controls.cr3 = h->table_offset + find_table(ckpt, (pte123_t *)cpu_controls.cr3) * PAGE_SIZE;
+    h->core.tss = tr_global_tss;
+    h->core.tss.ESP0 = h->kstack_offset + find_pcb(ckpt, current) * KERNEL_STACK_SIZE + KERNEL_STACK_SIZE;
+    h->core.inst_encoding = cpu_inst_encoding;
+    read_timer(&h->global_time, &h->timer_countdown);
+
+    ok &= write_at(fw, 0, h, sizeof(checkpoint_header_t));
+    // the buffered writes may fail on closing
+    if (fclose(fw) != 0)
+    {
+        ok = 0;
+    }
+    // the file is extended to the full size even without swap pages
+    if (ok == 1 && truncate(filename, h->size) != 0)
+    {
+        ok = 0;
+    }
+
+    free(ckpt);
+    return ok;
+}
+
+/*======================================*/
+/*      restore                         */
+/*======================================*/
+
+// file offset to the pointer into the mapping
+static inline uint64_t relocate(uint64_t offset)
+{
+    return (uint64_t)restored_base + offset;
+}
+
+// return 1 if the machine is restored, 0 if the file cannot be mapped
+// or is not a checkpoint. The running machine is kept on failure
+int machine_restore(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(checkpoint_header_t))
+    {
+        close(fd);
+        return 0;
+    }
+    uint64_t size = st.st_size;
+
+    // the kernel stacks must be KERNEL_STACK_SIZE aligned in memory,
+    // so reserve more and map the file at an aligned address inside
+    uint8_t *reserved = mmap(NULL, size + KERNEL_STACK_SIZE, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        close(fd);
+        return 0;
+    }
+    uint8_t *base = (uint8_t *)align_up((uint64_t)reserved, KERNEL_STACK_SIZE);
+    if (base > reserved)
+    {
+        munmap(reserved, base - reserved);
+    }
+    munmap(base + size, reserved + size + KERNEL_STACK_SIZE - (base + size));
+    uint8_t *mapped = mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    checkpoint_header_t *h = (checkpoint_header_t *)base;
+    if (mapped != base ||
+        memcmp(h->magic, CHECKPOINT_MAGIC, 8) != 0 || h->size != size)
+    {
+        munmap(base, size);
+        close(fd);
+        return 0;
+    }
+
+    // physical memory: the file pages replace the pages of pm
+    assert(((uint64_t)pm & (PAGE_SIZE - 1)) == 0);
+    void *pm_mapped = mmap(pm, PHYSICAL_MEMORY_SPACE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+        fd, h->pm_offset);
+    close(fd);
+    if (pm_mapped != (void *)pm)
+    {
+        munmap(base, size);
+        return 0;
+    }
+
+    // drop the last restored machine
+    if (restored_base != NULL)
+    {
+        munmap(restored_base, restored_size);
+    }
+    restored_base = base;
+    restored_size = size;
+
+    // the swap pages are copied to new disk addresses
+    uint64_t new_daddr[MAX_CHECKPOINT_SWAP_PAGES];
+    for (uint64_t i = 0; i < h->num_swap_pages; ++ i)
+    {
+        new_daddr[i] = copy_swappage(base + h->swap_offset + i * PAGE_SIZE);
+    }
+
+    // page tables
+    for (uint64_t i = 0; i < h->num_tables; ++ i)
+    {
+        pte123_t *table = (pte123_t *)(base + h->table_offset + i * PAGE_SIZE);
+        for (int j = 0; j < PAGE_TABLE_ENTRY_NUM; ++ j)
+        {
+            if (h->table_level[i] < 4 && table[j].present == 1)
+            {
+                table[j].paddr = relocate(table[j].paddr);
+            }
+            else if (h->table_level[i] == 4 && table[j].present == 0 && table[j].daddr != 0)
+            {
+                for (uint64_t k = 0; k < h->num_swap_pages; ++ k)
+                {
+                    if (h->swap_daddr[k] == table[j].daddr)
+                    {
+                        table[j].daddr = new_daddr[k];
+                    }
+                }
+            }
+        }
+    }
+
+    // PCBs and kernel stacks
+    for (uint64_t i = 0; i < h->num_pcbs; ++ i)
+    {
+        pcb_t *pcb = (pcb_t *)(base + h->pcb_offset + i * sizeof(pcb_t));
+        pcb->mm.pgd_paddr = relocate(pcb->mm.pgd_paddr);
+        pcb->kstack = (kstack_t *)relocate((uint64_t)pcb->kstack);
+        pcb->next = (pcb_t *)relocate((uint64_t)pcb->next);
+        pcb->prev = (pcb_t *)relocate((uint64_t)pcb->prev);
+        pcb->kstack->threadinfo.pcb = (pcb_t *)relocate((uint64_t)pcb->kstack->threadinfo.pcb);
+    }
+
+    // page map
+    memcpy(page_map, h->page_map, sizeof(page_map));
+    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        if (page_map[i].pte4 != NULL)
+        {
+            page_map[i].pte4 = (pte4_t *)relocate((uint64_t)page_map[i].pte4);
+        }
+        for (uint64_t k = 0; k < h->num_swap_pages; ++ k)
+        {
+            if (page_map[i].daddr == h->swap_daddr[k])
+            {
+                page_map[i].daddr = new_daddr[k];
+            }
+        }
+    }
+
+    // the core
+    memcpy(&cpu_reg, &h->core.reg, sizeof(cpu_reg_t));
+    memcpy(&cpu_flags, &h->core.flags, sizeof(cpu_flags_t));
+    cpu_pc = h->core.pc;
+    cpu_controls = h->core.controls;
+    cpu_controls.cr3 = relocate(cpu_controls.cr3);
+    tr_global_tss = h->core.tss;
+    tr_global_tss.ESP0 = relocate(tr_global_tss.ESP0);
+    cpu_inst_encoding = h->core.inst_encoding;
+    write_timer(h->global_time, h->timer_countdown);
+
+    // the handlers are host function pointers, not saved
+    idt_init();
+    syscall_init();
+
+    // the caches of the core hold the translations and data of the old machine
+    tlb_flush_all();
+#ifdef USE_SRAM_CACHE
+    sram_cache_invalidate();
+#endif
+#ifdef USE_DECODE_CACHE
+    invalidate_decode_cache(0, PHYSICAL_MEMORY_SPACE);
+#endif
+
+    return 1;
+}
@@ -0,0 +1,92 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz 
+ * and shall not be used for commercial and profitting purpose 
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/instruction.h"
+#include "headers/linker.h"
+
+uint64_t va2pa(uint64_t vaddr);
+
+#ifdef USE_DECODE_CACHE
+void parse_instruction(char *inst_str, inst_t *inst);
+void write_decode_cache(uint64_t paddr, inst_t *inst);
+#endif
+
+static sh_entry_t *get_text_section(elf_t *eof)
+{
+    for (int i = 0; i < eof->sht_count; ++ i)
+    {
+        if (strcmp(eof->sht[i].sh_name, ".text") == 0)
+        {
+            return &eof->sht[i];
+        }
+    }
+    return NULL;
+}
+
+// load the .text section of the EOF to its run-time address
+// the page table of the process should be ready in cr3
+// return the number of loaded instructions
+uint64_t load_text_section(elf_t *eof)
+{
+    sh_entry_t *text = get_text_section(eof);
+    if (text == NULL)
+    {
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < text->sh_size; ++ i)
+    {
+        char *inst_str = eof->buffer[text->sh_offset + i];
+        uint64_t paddr = va2pa(text->sh_addr + i * MAX_INSTRUCTION_CHAR * sizeof(char));
+
+        // the text is still in DRAM so that it can be read as data
+        cpu_writeinst_dram(paddr, inst_str);
+
+#ifdef USE_DECODE_CACHE
+        // pre-decode the instruction at load time, so the instruction
+        // cycle fetches the decoded form and never parses the string.
+        // any later write to the text invalidates the decoded form.
+        inst_t inst;
+        parse_instruction(inst_str, &inst);
+        write_decode_cache(paddr, &inst);
+#endif
+    }
+
+    return text->sh_size;
+}
+
+// load the x86-64 machine code, e.g. the bytes dumped by objdump,
+// to the virtual address `vaddr` of the current process.
+// the process should run with INST_ENCODING_BINARY,
+// and its page table should be ready in cr3
+void load_machine_code(uint64_t vaddr, uint8_t *code, uint64_t size)
+{
+    uint64_t i = 0;
+    while (i < size)
+    {
+        // write the bytes page by page
+        // the physical pages of continuous virtual pages may be apart
+        uint64_t n = PAGE_SIZE - ((vaddr + i) & (PAGE_SIZE - 1));
+        if (n > size - i)
+        {
+            n = size - i;
+        }
+        cpu_writecode_dram(va2pa(vaddr + i), &code[i], n);
+        i += n;
+    }
+}
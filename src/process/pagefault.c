@@ -17,6 +17,32 @@
 #include "headers/address.h"
 #include "headers/interrupt.h"
 #include "headers/process.h"
+#include "headers/log.h"
+
+#ifdef USE_SMP
+#include <pthread.h>
+
+// the page map is shared by the cores
+// the page faults are fixed one by one
+static pthread_mutex_t page_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void lock_page_map()
+{
+    // the core holding the lock may be stopping the others,
+    // the waiting core must stop for it, or they wait forever
+    while (pthread_mutex_trylock(&page_map_lock) != 0)
+    {
+        smp_check_stop();
+    }
+}
+
+static void unlock_page_map()
+{
+    // the stopped cores flush their TLB and go on
+    smp_resume_cores();
+    pthread_mutex_unlock(&page_map_lock);
+}
+#endif
 
 // search paddr from main memory and disk
 // TODO: raise exception 14 (page fault) here
@@ -26,33 +52,24 @@
 // swap in/out
 int swap_in(uint64_t daddr, uint64_t ppn);
 int swap_out(uint64_t daddr, uint64_t ppn);
-
-// physical page descriptor
-typedef struct
-{
-    int allocated;
-    int dirty;
-    int time;   // LRU cache: 0 - Fresh
-
-    // real world: mapping to anon_vma or address_space
-    // we simply the situation here
-    // TODO: if multiple processes are using this page? E.g. Shared library
-    pte4_t *pte4;       // the reversed mapping: from PPN to page table entry
-    uint64_t daddr;   // binding the revesed mapping with mapping to disk
-} pd_t;
+uint64_t copy_swappage(uint8_t *page);
+#ifdef USE_HUGE_PAGE
+uint64_t copy_swappages(uint8_t *pages, uint64_t num);
+int swap_in_hugepage(uint64_t daddr, uint64_t ppn);
+int swap_out_hugepage(uint64_t daddr, uint64_t ppn);
+#endif
 
 // for each pagable (swappable) physical page
 // create one reversed mapping
-static pd_t page_map[MAX_NUM_PHYSICAL_PAGE];
+MACHINE_LOCAL pd_t page_map[MAX_NUM_PHYSICAL_PAGE];
 
-// get the level 4 page table entry
-static pte4_t *get_entry4(pte123_t *pgd, address_t *vaddr)
+// get the level 1 to 3 page table entry
+static pte123_t *get_entry123(pte123_t *pgd, address_t *vaddr, int entry_level)
 {
-    int vpns[4] = {
+    int vpns[3] = {
         vaddr->vpn1,
         vaddr->vpn2,
         vaddr->vpn3,
-        vaddr->vpn4,
     };
 
     assert(pgd != NULL);
@@ -60,7 +77,7 @@ static pte4_t *get_entry4(pte123_t *pgd, address_t *vaddr)
 
     int level = 0;
     pte123_t *tab = pgd;
-    while (level < 4)
+    while (level < entry_level - 1)
     {
         int vpn = vpns[level];
         if (tab[vpn].present != 1)
@@ -70,7 +87,7 @@ static pte4_t *get_entry4(pte123_t *pgd, address_t *vaddr)
             // note that this is a 48-bit address !!!
             // the high bits are all zero
             // And sizeof(pte123_t) == sizeof(pte4_t)
-            pte123_t *new_tab = (pte123_t *)malloc(PAGE_TABLE_ENTRY_NUM * sizeof(pte123_t));
+            pte123_t *new_tab = (pte123_t *)calloc(PAGE_TABLE_ENTRY_NUM, sizeof(pte123_t));
             
             // .paddr field is 50 bits
             tab[vpn].paddr = (uint64_t)new_tab;
@@ -82,7 +99,22 @@ static pte4_t *get_entry4(pte123_t *pgd, address_t *vaddr)
         level += 1;
     }
 
-    pte4_t *pt = (pte4_t *)tab;
+    return &tab[vpns[level]];
+}
+
+// get the level 4 page table entry
+static pte4_t *get_entry4(pte123_t *pgd, address_t *vaddr)
+{
+    pte123_t *pmd = get_entry123(pgd, vaddr, 3);
+    if (pmd->present != 1)
+    {
+        pte123_t *new_tab = (pte123_t *)calloc(PAGE_TABLE_ENTRY_NUM, sizeof(pte123_t));
+        pmd->paddr = (uint64_t)new_tab;
+        pmd->present = 1;
+    }
+    assert(pmd->hugepage == 0);
+
+    pte4_t *pt = (pte4_t *)((uint64_t)pmd->paddr);
     return &pt[vaddr->vpn4];
 }
 
@@ -94,27 +126,46 @@ void page_map_init()
         page_map[k].dirty = 0;
         page_map[k].time = 0;
         page_map[k].pte4 = NULL;
+        page_map[k].asid = 0;
+        page_map[k].vaddr = -1;
+        page_map[k].hugepage = 0;
     }
 }
 
+// the first physical page of the 2MB page holds the mapping
+static inline uint64_t pagemap_head(uint64_t ppn)
+{
+    if (page_map[ppn].hugepage == 1)
+    {
+        return ppn & ~(uint64_t)(HUGE_PAGE_FRAME_NUM - 1);
+    }
+    return ppn;
+}
+
+static inline int is_hugepage_tail(uint64_t ppn)
+{
+    return pagemap_head(ppn) != ppn;
+}
+
+// the page is used by the kernel, as MMU sets the reference bit
+// it is the most recently used at the next scan
 void pagemap_update_time(uint64_t ppn)
 {
     assert(0 <= ppn && ppn < MAX_NUM_PHYSICAL_PAGE);
+    ppn = pagemap_head(ppn);
     assert(page_map[ppn].allocated == 1);
     assert(page_map[ppn].pte4->present == 1);
-    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
-    {
-        page_map[i].time += 1;
-    }
-    page_map[ppn].time = 0;
+    page_map[ppn].pte4->reference = 1;
 }
 
 void pagemap_dirty(uint64_t ppn)
 {
     assert(0 <= ppn && ppn < MAX_NUM_PHYSICAL_PAGE);
+    ppn = pagemap_head(ppn);
     assert(page_map[ppn].allocated == 1);
     assert(page_map[ppn].pte4->present == 1);
     page_map[ppn].dirty = 1;
+    // the dirty bit of PMD entry is at the same bit of PTE
     page_map[ppn].pte4->dirty = 1;
 }
 
@@ -134,9 +185,13 @@ void map_pte4(pte4_t *pte, uint64_t ppn)
     assert(page_map[ppn].dirty == 0);
     assert(page_map[ppn].pte4 == NULL);
 
+    // the swap address shares the bits with ppn, read it before mapping
+    uint64_t daddr = pte->present == 0 ? pte->daddr : 0;
+
     // map the level 4 page table
     pte->present = 1;
     pte->ppn = ppn;
+    pte->reference = 0;
     pte->dirty = 0;
 
     // reversed mapping
@@ -144,11 +199,14 @@ void map_pte4(pte4_t *pte, uint64_t ppn)
     page_map[ppn].dirty = 0;        // allocated as clean
     page_map[ppn].time = 0;         // most recently used physical page
     page_map[ppn].pte4 = pte;
+    // set by the page fault handler, which knows the faulting address
+    page_map[ppn].asid = 0;
+    page_map[ppn].vaddr = -1;
 
     // Let's consider this, where can we store the swap address on disk?
     // In this case of physical page being allocated and mapped,
     // the swap address is stored in reversed mapping array
-    page_map[ppn].daddr = pte->daddr;
+    page_map[ppn].daddr = daddr;
 
     /*  When mapped
         Page table entry: present = 1, ppn
@@ -163,9 +221,20 @@ void unmap_pte4(uint64_t ppn)
     // Get the page table entry from reversed mapping array by ppn
     // Note that in this case the page MUST be allocated
     assert(page_map[ppn].allocated == 1);
+    assert(page_map[ppn].hugepage == 0);
     pte4_t *pte = page_map[ppn].pte4;
     assert(pte->present == 1);
 
+    // the TLB may still cache the translation to this page
+    if (page_map[ppn].vaddr != (uint64_t)-1)
+    {
+        tlb_invalidate_page(page_map[ppn].asid, page_map[ppn].vaddr);
+    }
+    else
+    {
+        tlb_flush_all();
+    }
+
     pte->pte_value = 0;
     pte->present = 0;
     // In this case, page_map[ppn] would be mapped by other page table.
@@ -187,6 +256,169 @@ void unmap_pte4(uint64_t ppn)
     // now page_map[ppn] can be used by other page table entry
 }
 
+#ifdef USE_HUGE_PAGE
+// map the 512 physical pages from ppn by the PMD entry
+void map_hugepage(pte123_t *pmd, uint64_t ppn)
+{
+    assert(ppn % HUGE_PAGE_FRAME_NUM == 0);
+    assert(ppn + HUGE_PAGE_FRAME_NUM <= MAX_NUM_PHYSICAL_PAGE);
+
+    uint64_t daddr = pmd->present == 0 ? pmd->daddr : 0;
+
+    pmd->pte_value = 0;
+    pmd->present = 1;
+    pmd->hugepage = 1;
+    // not a pointer to the next level, but the physical address
+    pmd->paddr = ppn << PHYSICAL_PAGE_OFFSET_LENGTH;
+
+    for (uint64_t i = ppn; i < ppn + HUGE_PAGE_FRAME_NUM; ++ i)
+    {
+        assert(page_map[i].allocated == 0);
+        page_map[i].allocated = 1;
+        page_map[i].dirty = 0;
+        page_map[i].time = 0;
+        page_map[i].pte4 = NULL;
+        page_map[i].daddr = 0;
+        page_map[i].asid = 0;
+        page_map[i].vaddr = -1;
+        page_map[i].hugepage = 1;
+    }
+
+    // the reversed mapping is on the first physical page
+    // PMD entry and PTE share the present and dirty bits
+    page_map[ppn].pte4 = (pte4_t *)pmd;
+    page_map[ppn].daddr = daddr;
+}
+
+void unmap_hugepage(uint64_t ppn)
+{
+    assert(ppn % HUGE_PAGE_FRAME_NUM == 0);
+    assert(page_map[ppn].allocated == 1);
+    assert(page_map[ppn].hugepage == 1);
+    pte123_t *pmd = (pte123_t *)page_map[ppn].pte4;
+    assert(pmd->present == 1 && pmd->hugepage == 1);
+
+    // the TLB may still cache the translation to this 2MB page
+    if (page_map[ppn].vaddr != (uint64_t)-1)
+    {
+        tlb_invalidate_page(page_map[ppn].asid, page_map[ppn].vaddr);
+    }
+    else
+    {
+        tlb_flush_all();
+    }
+
+    // the swapped out 2MB page is found by the non-zero daddr of PMD
+    pmd->pte_value = 0;
+    pmd->present = 0;
+    pmd->daddr = page_map[ppn].daddr;
+
+    for (uint64_t i = ppn; i < ppn + HUGE_PAGE_FRAME_NUM; ++ i)
+    {
+        page_map[i].allocated = 0;
+        page_map[i].dirty = 0;
+        page_map[i].time = 0;
+        page_map[i].pte4 = NULL;
+        page_map[i].hugepage = 0;
+    }
+}
+
+static uint64_t map_faulting_hugepage(pte123_t *pmd);
+#endif
+
+static uint64_t map_faulting_page(pte4_t *pte);
+
+// MMU sets the reference and dirty bits of the page table entries,
+// the OS reads them only when a victim is needed:
+//  -   the referenced page is the most recently used, the others
+//      get older by one scan, as the aging of the LRU time
+//  -   the dirty page must be written back before reused
+// The reference bit is cleared with the TLB line, or the TLB hits
+// would never set it again. With USE_SMP, the other cores are stopped
+// during the scan and flush their TLB when resumed.
+static void pagemap_scan()
+{
+    int flush = 0;
+    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        if (page_map[i].allocated == 0 || is_hugepage_tail(i) == 1)
+        {
+            continue;
+        }
+
+        // the PMD entry of 2MB page has the bits at the same place
+        pte4_t *pte = page_map[i].pte4;
+        assert(pte->present == 1);
+        if (pte->dirty == 1)
+        {
+            page_map[i].dirty = 1;
+        }
+
+        if (pte->reference == 0)
+        {
+            page_map[i].time += 1;
+            continue;
+        }
+        pte->reference = 0;
+        page_map[i].time = 0;
+        if (page_map[i].vaddr != (uint64_t)-1)
+        {
+            tlb_invalidate_page(page_map[i].asid, page_map[i].vaddr);
+        }
+        else
+        {
+            flush = 1;
+        }
+    }
+
+    if (flush == 1)
+    {
+        tlb_flush_all();
+    }
+}
+
+// write back the victim to swap space before unmapping
+static void write_back_page(uint64_t ppn)
+{
+#ifdef USE_HUGE_PAGE
+    if (page_map[ppn].hugepage == 1)
+    {
+        if (page_map[ppn].daddr == 0)
+        {
+            set_pagemap_swapaddr(ppn, copy_swappages(&pm[ppn << PHYSICAL_PAGE_OFFSET_LENGTH], HUGE_PAGE_FRAME_NUM));
+        }
+        else
+        {
+            swap_out_hugepage(page_map[ppn].daddr, ppn);
+        }
+        return;
+    }
+#endif
+    if (page_map[ppn].daddr == 0)
+    {
+        // the anonymous page mapped from a free ppn has no swap page yet,
+        // allocate one for it on the first write back
+        set_pagemap_swapaddr(ppn, copy_swappage(&pm[ppn << PHYSICAL_PAGE_OFFSET_LENGTH]));
+    }
+    else
+    {
+        swap_out(page_map[ppn].daddr, ppn);
+    }
+}
+
+// the victim may be a 2MB page, which frees 512 physical pages
+static void unmap_victim(uint64_t ppn)
+{
+#ifdef USE_HUGE_PAGE
+    if (page_map[ppn].hugepage == 1)
+    {
+        unmap_hugepage(ppn);
+        return;
+    }
+#endif
+    unmap_pte4(ppn);
+}
+
 void fix_pagefault()
 {
     // get page table directory from rsp
@@ -196,9 +428,43 @@ void fix_pagefault()
     // get the faulting address from MMU register
     address_t vaddr = {.address_value = mmu_vaddr_pagefault};
 
+#ifdef USE_HUGE_PAGE
+    // the 2MB region without level 4 table, or swapped out as 2MB page
+    pte123_t *pmd = get_entry123(pgd, &vaddr, 3);
+    if (pmd->present == 0 && (pcb->mm.hugepage == 1 || pmd->daddr != 0))
+    {
+#ifdef USE_SMP
+        lock_page_map();
+#endif
+        uint64_t ppn = map_faulting_hugepage(pmd);
+        page_map[ppn].asid = pcb->mm.asid;
+        page_map[ppn].vaddr = vaddr.vaddr_value & ~(uint64_t)(HUGE_PAGE_SIZE - 1);
+#ifdef USE_SMP
+        unlock_page_map();
+#endif
+        return;
+    }
+#endif
+
     // get the level 4 page table entry
     pte4_t *pte = get_entry4(pgd, &vaddr);
-    
+
+#ifdef USE_SMP
+    lock_page_map();
+#endif
+    uint64_t ppn = map_faulting_page(pte);
+    // the reversed mapping to the virtual page, for TLB invalidation
+    page_map[ppn].asid = pcb->mm.asid;
+    page_map[ppn].vaddr = vaddr.vaddr_value;
+#ifdef USE_SMP
+    unlock_page_map();
+#endif
+}
+
+// find a physical page for the faulting page table entry
+// return the ppn mapped
+static uint64_t map_faulting_page(pte4_t *pte)
+{
     // 1. try to request one free physical page from DRAM
     // kernel's responsibility
     for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
@@ -208,20 +474,26 @@ void fix_pagefault()
             // found i as free ppn
             map_pte4(pte, i);
          
-            printf("\033[34;1m\tPageFault: use free ppn %d\033[0m\n", i);
-            return;
+            LOG(LOG_PAGEFAULT, LOG_INFO, "\033[34;1m\tPageFault: use free ppn %ld\033[0m\n", i);
+            return i;
         }
     }
 
     // 2. no free physical page: select one clean page (LRU) and overwrite
     // in this case, there is no DRAM - DISK transaction
     // you know you can optimize this loop in the previous one.
+#ifdef USE_SMP
+    // the victim may be cached by the TLB of the other cores
+    smp_stop_cores();
+#endif
+    pagemap_scan();
     int lru_ppn = -1;
     int lru_time = -1;
     for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
     {
         if (page_map[i].dirty == 0 && 
-            lru_time < page_map[i].time)
+            lru_time < page_map[i].time &&
+            is_hugepage_tail(i) == 0)
         {
             lru_time = page_map[i].time;
             lru_ppn = i;
@@ -233,15 +505,15 @@ void fix_pagefault()
     {
         // reversed mapping will find the victim page table
         // unmap the victim (LRU)
-        unmap_pte4(lru_ppn);
+        unmap_victim(lru_ppn);
 
         // load page from disk to physical memory
         // at the victim's ppn
         swap_in(pte->daddr, lru_ppn);
         map_pte4(pte, lru_ppn);
 
-        printf("\033[34;1m\tPageFault: discard clean ppn %d as victim\033[0m\n", lru_ppn);
-        return;
+        LOG(LOG_PAGEFAULT, LOG_INFO, "\033[34;1m\tPageFault: discard clean ppn %ld as victim\033[0m\n", lru_ppn);
+        return lru_ppn;
     }
 
     // 3. no free nor clean physical page: select one LRU victim
@@ -250,7 +522,8 @@ void fix_pagefault()
     lru_time = -1;
     for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
     {
-        if (lru_time < page_map[i].time)
+        if (lru_time < page_map[i].time &&
+            is_hugepage_tail(i) == 0)
         {
             lru_time = page_map[i].time;
             lru_ppn = i;
@@ -259,14 +532,79 @@ void fix_pagefault()
     assert(0 <= lru_ppn && lru_ppn < MAX_NUM_PHYSICAL_PAGE);
 
     // write back
-    swap_out(page_map[lru_ppn].daddr, lru_ppn);
+    write_back_page(lru_ppn);
 
     // unmap victim
-    unmap_pte4(lru_ppn);
+    unmap_victim(lru_ppn);
 
     // load page from disk to physical memory
     swap_in(pte->daddr, lru_ppn);
     map_pte4(pte, lru_ppn);
 
-    printf("\033[34;1m\tPageFault: write back & use ppn %d\033[0m\n", lru_ppn);
-}
\ No newline at end of file
+    LOG(LOG_PAGEFAULT, LOG_INFO, "\033[34;1m\tPageFault: write back & use ppn %ld\033[0m\n", lru_ppn);
+    return lru_ppn;
+}
+
+#ifdef USE_HUGE_PAGE
+// find 512 contiguous physical pages aligned to 2MB
+// return the first ppn mapped
+static uint64_t map_faulting_hugepage(pte123_t *pmd)
+{
+    // 1. try to find the free 2MB physical pages
+    uint64_t head = MAX_NUM_PHYSICAL_PAGE;
+    for (uint64_t i = 0; i < MAX_NUM_PHYSICAL_PAGE && head == MAX_NUM_PHYSICAL_PAGE; i += HUGE_PAGE_FRAME_NUM)
+    {
+        head = i;
+        for (uint64_t j = i; j < i + HUGE_PAGE_FRAME_NUM; ++ j)
+        {
+            if (page_map[j].allocated == 1)
+            {
+                head = MAX_NUM_PHYSICAL_PAGE;
+                break;
+            }
+        }
+    }
+
+    if (head == MAX_NUM_PHYSICAL_PAGE)
+    {
+        // 2. no free 2MB: evict all the pages in the 2MB of the LRU page
+#ifdef USE_SMP
+        smp_stop_cores();
+#endif
+        pagemap_scan();
+        int lru_ppn = -1;
+        int lru_time = -1;
+        for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+        {
+            if (page_map[i].allocated == 1 &&
+                lru_time < page_map[i].time &&
+                is_hugepage_tail(i) == 0)
+            {
+                lru_time = page_map[i].time;
+                lru_ppn = i;
+            }
+        }
+        assert(0 <= lru_ppn && lru_ppn < MAX_NUM_PHYSICAL_PAGE);
+
+        head = lru_ppn & ~(uint64_t)(HUGE_PAGE_FRAME_NUM - 1);
+        for (uint64_t i = head; i < head + HUGE_PAGE_FRAME_NUM; ++ i)
+        {
+            if (page_map[i].allocated == 1 && is_hugepage_tail(i) == 0)
+            {
+                if (page_map[i].dirty == 1)
+                {
+                    write_back_page(i);
+                }
+                unmap_victim(i);
+            }
+        }
+    }
+
+    // load the 2MB page from disk to the physical pages
+    swap_in_hugepage(pmd->daddr, head);
+    map_hugepage(pmd, head);
+
+    LOG(LOG_PAGEFAULT, LOG_INFO, "\033[34;1m\tPageFault: use 2MB from ppn %ld\033[0m\n", head);
+    return head;
+}
+#endif
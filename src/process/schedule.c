@@ -17,6 +17,41 @@
 #include "headers/memory.h"
 #include "headers/interrupt.h"
 #include "headers/process.h"
+#include "headers/log.h"
+
+#ifdef USE_SOFTMMU
+// from mmu.c
+void softmmu_flush();
+#endif
+
+// the ASID is 12 bits as PCID of x86-64, ASID 0 is never allocated
+// and left to the processes set up without the allocator
+#define ASID_LENGTH     (12)
+#define NUM_ASID        (1 << ASID_LENGTH)
+
+static MACHINE_LOCAL uint64_t asid_next = 1;
+
+// the page table whose translations the TLB lines of each ASID carry
+// on this core, recorded on switching out. An ASID is recycled when
+// the allocator wraps, then the new page table does not match the
+// recorded one and the lines are flushed on switching in
+static CORE_LOCAL uint64_t asid_pgd[NUM_ASID];
+
+void asid_init()
+{
+    asid_next = 1;
+    memset(asid_pgd, 0, sizeof(asid_pgd));
+}
+
+void allocate_asid(pcb_t *pcb)
+{
+    pcb->mm.asid = asid_next;
+    asid_next = asid_next % (NUM_ASID - 1) + 1;
+
+    // the lines left by the last owner of the ASID
+    tlb_invalidate_asid(pcb->mm.asid);
+    asid_pgd[pcb->mm.asid] = 0;
+}
 
 pcb_t *get_current_pcb()
 {
@@ -52,7 +87,12 @@ void os_schedule()
 
     // pcb_new should be selected by the scheduling algorithm
     pcb_t *pcb_new = pcb_old->next;
-    printf("    \033[31;1mOS schedule [%ld] -> [%ld]\033[0m\n", pcb_old->pid, pcb_new->pid);
+    LOG(LOG_SCHEDULE, LOG_DEBUG, "    \033[31;1mOS schedule [%ld] -> [%ld]\033[0m\n", pcb_old->pid, pcb_new->pid);
+
+#ifdef USE_CYCLE_MODEL
+    // the cycles since the last switching are spent by the old process
+    cycle_account(&pcb_old->cycles);
+#endif
 
     // context switch
 
@@ -66,6 +106,25 @@ void os_schedule()
     tr_global_tss.ESP0 = get_kstack_RSP() + KERNEL_STACK_SIZE;
 
     // update CR3 -> page table in MMU
-    // will cause the refreshing of MMU TLB cache
+    // the TLB lines are tagged by ASID, so they are kept for the old process.
+    // Only when the lines of the ASID are from another page table,
+    // e.g. the ASID is shared or recycled, the lines are invalidated
+    assert(cpu_controls.asid < NUM_ASID && pcb_new->mm.asid < NUM_ASID);
+    asid_pgd[cpu_controls.asid] = cpu_controls.cr3;
+    if (asid_pgd[pcb_new->mm.asid] != (uint64_t)(pcb_new->mm.pgd))
+    {
+        tlb_invalidate_asid(pcb_new->mm.asid);
+    }
+#ifdef USE_SOFTMMU
+    // the host pointers are translated in the old address space
+    if (cpu_controls.cr3 != (uint64_t)(pcb_new->mm.pgd))
+    {
+        softmmu_flush();
+    }
+#endif
     cpu_controls.cr3 = (uint64_t)(pcb_new->mm.pgd);
+    cpu_controls.asid = pcb_new->mm.asid;
+
+    // the new process may use another instruction encoding
+    cpu_inst_encoding = pcb_new->inst_encoding;
 }
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include "headers/cpu.h"
 #include "headers/memory.h"
 #include "headers/interrupt.h"
+#include "headers/log.h"
 
 typedef void (*syscall_handler_t)();
 
@@ -26,7 +27,7 @@ typedef struct SYSCALL_ENTRY_STRUCT
 } syscall_entry_t;
 
 // table of syscalls
-syscall_entry_t syscall_table[64];
+MACHINE_LOCAL syscall_entry_t syscall_table[64];
 
 // handlers of syscalls
 static void write_handler();
@@ -67,12 +68,24 @@ static void write_handler()
 
     destory_user_registers();
 
+    // the log lines deferred in the ring are printed before the output
+    log_flush();
+
     // The following resource are allocated on KERNEL STACK
     // TODO: this works only with NAVIE VA2PA
-    for (int i = 0; i < buf_length; ++ i)
+    // the bytes are copied to the buffer and written in one call
+    char buf[64];
+    for (int i = 0; i < buf_length; i += sizeof(buf))
     {
+        int size = buf_length - i < sizeof(buf) ? buf_length - i : sizeof(buf);
+        for (int j = 0; j < size; ++ j)
+        {
+            buf[j] = pm[va2pa(buf_vaddr + i + j)];
+        }
         // print as yellow
-        printf("\033[33;1m%c\033[0m", pm[va2pa(buf_vaddr + i)]);
+        fputs("\033[33;1m", stdout);
+        fwrite(buf, 1, size, stdout);
+        fputs("\033[0m", stdout);
     }
 }
 
@@ -92,7 +105,7 @@ static void exit_handler()
     // assembly end
 
     // The following resource are allocated on KERNEL STACK
-    printf("\033[33;1mGood Bye ~~~\n\033[0m");
+    LOG(LOG_SYSCALL, LOG_INFO, "\033[33;1mGood Bye ~~~\n\033[0m");
 }
 
 static void wait_handler()
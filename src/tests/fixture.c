@@ -0,0 +1,153 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+// from pagefault.c
+void map_pte4(pte4_t *pte, uint64_t ppn);
+void page_map_init();
+void pagemap_dirty(uint64_t ppn);
+
+MACHINE_LOCAL pcb_t fixture_pcb[FIXTURE_NUM_PROCESSES];
+MACHINE_LOCAL page_tables_t fixture_tables[FIXTURE_NUM_PROCESSES];
+
+// aligned to the kernel stacks inside
+static MACHINE_LOCAL uint8_t stack_buf[KERNEL_STACK_SIZE * (FIXTURE_NUM_PROCESSES + 1)];
+
+void link_page_table(pte123_t *pgd, pte123_t *pud, pte123_t *pmd, pte4_t *pt,
+    int ppn, address_t *vaddr)
+{
+    (&(pgd[vaddr->vpn1]))->paddr = (uint64_t)&pud[0];
+    (&(pgd[vaddr->vpn1]))->present = 1;
+
+    (&(pud[vaddr->vpn2]))->paddr = (uint64_t)&pmd[0];
+    (&(pud[vaddr->vpn2]))->present = 1;
+
+    (&(pmd[vaddr->vpn3]))->paddr = (uint64_t)&pt[0];
+    (&(pmd[vaddr->vpn3]))->present = 1;
+
+    map_pte4(&pt[vaddr->vpn4], ppn);
+}
+
+// boot the machine with num processes, each with the code page at 0x400000
+// the data and stack pages are mapped on page fault
+static void create_processes(int num)
+{
+    assert(0 < num && num <= FIXTURE_NUM_PROCESSES);
+
+    memset(&cpu_reg, 0, sizeof(cpu_reg));
+    memset(&cpu_flags, 0, sizeof(cpu_flags));
+    cpu_pc.rip = 0x00400000;
+
+    memset(&fixture_pcb, 0, sizeof(fixture_pcb));
+    memset(&fixture_tables, 0, sizeof(fixture_tables));
+    // the pages are not cleared when mapped on page fault
+    memset(pm, 0, PHYSICAL_MEMORY_SPACE);
+
+    page_map_init();
+    tlb_flush_all();
+    asid_init();
+
+    uint64_t stack_bottom = (((uint64_t)stack_buf + KERNEL_STACK_SIZE) >> 13) << 13;
+
+    address_t code_addr = {.address_value = 0x00400000};
+    for (int k = 0; k < num; ++ k)
+    {
+        pcb_t *p = &fixture_pcb[k];
+        page_tables_t *t = &fixture_tables[k];
+
+        p->pid = k + 1;
+        p->next = &fixture_pcb[(k + 1) % num];
+        p->prev = &fixture_pcb[(k + num - 1) % num];
+        p->mm.pgd = &t->pgd[0];
+        allocate_asid(p);
+
+        link_page_table(&t->pgd[0], &t->pud[0], &t->pmd[0], &t->pt[0], k + 1, &code_addr);
+
+        p->kstack = (kstack_t *)(stack_bottom + k * KERNEL_STACK_SIZE);
+        p->kstack->threadinfo.pcb = p;
+
+        if (k > 0)
+        {
+            // start from the trap frame when scheduled
+            trapframe_t tf = {
+                .rip = code_addr.vaddr_value,
+            };
+            uint64_t tf_addr = (uint64_t)p->kstack + KERNEL_STACK_SIZE - sizeof(trapframe_t);
+            memcpy((trapframe_t *)tf_addr, &tf, sizeof(trapframe_t));
+            p->context.regs.rsp = tf_addr - sizeof(userframe_t);
+        }
+    }
+
+    tr_global_tss.ESP0 = (uint64_t)fixture_pcb[0].kstack + KERNEL_STACK_SIZE;
+    cpu_controls.cr3 = fixture_pcb[0].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[0].mm.asid;
+
+    idt_init();
+    syscall_init();
+}
+
+void load_processes(char (*assembly)[FIXTURE_NUM_PROCESSES][MAX_INSTRUCTION_CHAR],
+    int count, int num)
+{
+    create_processes(num);
+    for (int k = 0; k < num; ++ k)
+    {
+        for (int i = 0; i < count; ++ i)
+        {
+            cpu_writeinst_dram((k + 1) * PAGE_SIZE + i * MAX_INSTRUCTION_CHAR, assembly[i][k]);
+        }
+        // written back instead of lost when swapped out
+        pagemap_dirty(k + 1);
+    }
+}
+
+void load_program(char (*assembly)[MAX_INSTRUCTION_CHAR], int count)
+{
+    create_processes(1);
+    for (int i = 0; i < count; ++ i)
+    {
+        cpu_writeinst_dram(PAGE_SIZE + i * MAX_INSTRUCTION_CHAR, assembly[i]);
+    }
+    // written back instead of lost when swapped out
+    pagemap_dirty(1);
+}
+
+cpu_reg_t *user_reg(int k)
+{
+    uint64_t top = (uint64_t)fixture_pcb[k].kstack + KERNEL_STACK_SIZE;
+    if (tr_global_tss.ESP0 == top)
+    {
+        return &cpu_reg;
+    }
+    // saved in the user frame when switched out
+    return &((userframe_t *)(top - sizeof(trapframe_t) - sizeof(userframe_t)))->regs;
+}
+
+uint64_t user_rip(int k)
+{
+    uint64_t top = (uint64_t)fixture_pcb[k].kstack + KERNEL_STACK_SIZE;
+    if (tr_global_tss.ESP0 == top)
+    {
+        return cpu_pc.rip;
+    }
+    return ((trapframe_t *)(top - sizeof(trapframe_t)))->rip;
+}
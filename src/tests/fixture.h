@@ -0,0 +1,56 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdint.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/process.h"
+
+// include guards to prevent double declaration of any identifiers 
+// such as types, enums and static variables
+#ifndef     FIXTURE_GUARD
+#define     FIXTURE_GUARD
+
+// the processes set up by the tests, shared by the test targets
+#define     FIXTURE_NUM_PROCESSES   (2)
+
+// the page tables of a process, from PGD to the level 4 table
+typedef struct
+{
+    pte123_t pgd[512];
+    pte123_t pud[512];
+    pte123_t pmd[512];
+    pte4_t pt[512];
+} page_tables_t;
+
+// process k is in fixture_pcb[k] with the page tables in fixture_tables[k]
+extern MACHINE_LOCAL pcb_t fixture_pcb[FIXTURE_NUM_PROCESSES];
+extern MACHINE_LOCAL page_tables_t fixture_tables[FIXTURE_NUM_PROCESSES];
+
+// map the virtual page to ppn, linking the page tables from pgd
+void link_page_table(pte123_t *pgd, pte123_t *pud, pte123_t *pmd, pte4_t *pt,
+    int ppn, address_t *vaddr);
+
+// load the programs as num processes scheduled round robin,
+// process k runs the code of assembly[i][k] at 0x400000 in ppn k + 1
+void load_processes(char (*assembly)[FIXTURE_NUM_PROCESSES][MAX_INSTRUCTION_CHAR],
+    int count, int num);
+
+// load the program at 0x400000 in ppn 1 as the only process
+void load_program(char (*assembly)[MAX_INSTRUCTION_CHAR], int count);
+
+// the user registers and rip of process k
+cpu_reg_t *user_reg(int k);
+uint64_t user_rip(int k);
+
+#endif
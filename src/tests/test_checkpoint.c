@@ -0,0 +1,126 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+#define HALT_RIP (0x00400000 + 19 * MAX_INSTRUCTION_CHAR)
+
+// the interrupt returns into the instruction cycle, not this loop,
+// so the program halts in a dead loop instead of running out
+static int run_to_halt(int max_cycles)
+{
+    int time = 0;
+    while (cpu_pc.rip != HALT_RIP && time < max_cycles)
+    {
+        instruction_cycle();
+        time ++;
+    }
+    return time;
+}
+
+// checkpoint sum(n) in the middle, then restore and finish it again
+static void TestCheckpointRestore()
+{
+    printf("Testing machine checkpoint and restore ...\n");
+
+    uint64_t n = 3;
+
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",              // 0
+        "mov    %rsp,%rbp",         // 1
+        "sub    $0x10,%rsp",        // 2
+        "mov    %rdi,-0x8(%rbp)",   // 3
+        "cmpq   $0x0,-0x8(%rbp)",   // 4
+        "jne    0x400200",          // 5: jump to 8
+        "mov    $0x0,%eax",         // 6
+        "jmp    0x400380",          // 7: jump to 14
+        "mov    -0x8(%rbp),%rax",   // 8
+        "sub    $0x1,%rax",         // 9
+        "mov    %rax,%rdi",         // 10
+        "callq  0x00400000",        // 11
+        "mov    -0x8(%rbp),%rdx",   // 12
+        "add    %rdx,%rax",         // 13
+        "leaveq ",                  // 14
+        "retq   ",                  // 15
+        "mov    $0x0,%edi",         // 16: n is written below
+        "callq  0x00400000",        // 17
+        "mov    %rax,-0x8(%rbp)",   // 18
+        "jmp    0x4004c0",          // 19: halt
+    };
+    sprintf(assembly[16], "mov    $0x%lx,%%edi", n);
+
+    // a single process scheduled to itself by the timer
+    // the code page is physical page 1, the stack is mapped on page fault
+    load_program(assembly, 20);
+    cpu_reg.rsp = 0x7ffffffee0f0;
+    cpu_reg.rbp = 0x7ffffffee100;
+    cpu_pc.rip = 0x00400000 + 16 * MAX_INSTRUCTION_CHAR;
+
+    // in the middle of the recursion, after the stack page is mapped
+    run_to_halt(20);
+    assert(cpu_pc.rip != HALT_RIP);
+    uint64_t rip = cpu_pc.rip;
+    uint64_t rsp = cpu_reg.rsp;
+    int written = machine_checkpoint("./bin/machine.ckpt");
+    assert(written == 1);
+    // the failures are returned instead of asserted
+    written = machine_checkpoint("./bin/no-such-dir/machine.ckpt");
+    assert(written == 0);
+    assert(cpu_pc.rip == rip);
+
+    int cycles = run_to_halt(10000);
+    assert(cpu_reg.rax == n * (n + 1) / 2);
+
+    // the restored machine does not depend on the original one
+    kstack_t *kstack = fixture_pcb[0].kstack;
+    for (int i = 0; i < 2; ++ i)
+    {
+        memset(&cpu_reg, 0, sizeof(cpu_reg_t));
+        memset(pm, 0, PHYSICAL_MEMORY_SPACE);
+        memset(kstack, 0, KERNEL_STACK_SIZE);
+        memset(&fixture_tables, 0, sizeof(fixture_tables));
+        memset(&fixture_pcb, 0, sizeof(fixture_pcb));
+        cpu_pc.rip = 0;
+
+        // a missing file keeps the running machine
+        int restored = machine_restore("./bin/no-such-file.ckpt");
+        assert(restored == 0);
+        assert(cpu_pc.rip == 0);
+
+        restored = machine_restore("./bin/machine.ckpt");
+        assert(restored == 1);
+        assert(cpu_pc.rip == rip);
+        assert(cpu_reg.rsp == rsp);
+        assert(cpu_controls.cr3 != (uint64_t)&fixture_tables[0].pgd[0]);
+
+        // the same instructions to the same result
+        assert(run_to_halt(10000) == cycles);
+        assert(cpu_reg.rax == n * (n + 1) / 2);
+    }
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestCheckpointRestore();
+    return 0;
+}
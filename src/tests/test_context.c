@@ -87,6 +87,9 @@ static void TestContextSwitching()
 
     // prepare 3 processes as circular doubly linked list
     pcb_t p1, p2, p3;
+    memset(&p1, 0, sizeof(pcb_t));
+    memset(&p2, 0, sizeof(pcb_t));
+    memset(&p3, 0, sizeof(pcb_t));
     p1.next = &p2;
     p2.next = &p3;
     p3.next = &p1;
@@ -104,6 +107,9 @@ static void TestContextSwitching()
     pte123_t p1_pgd[512];
     pte123_t p2_pgd[512];
     pte123_t p3_pgd[512];
+    memset(&p1_pgd, 0, sizeof(pte123_t) * 512);
+    memset(&p2_pgd, 0, sizeof(pte123_t) * 512);
+    memset(&p3_pgd, 0, sizeof(pte123_t) * 512);
     p1.mm.pgd = &p1_pgd[0];
     p2.mm.pgd = &p2_pgd[0];
     p3.mm.pgd = &p3_pgd[0];
@@ -117,6 +123,9 @@ static void TestContextSwitching()
     pte123_t p1_pud[512];
     pte123_t p1_pmd[512];
     pte4_t p1_pt_code[512];
+    memset(&p1_pud, 0, sizeof(pte123_t) * 512);
+    memset(&p1_pmd, 0, sizeof(pte123_t) * 512);
+    memset(&p1_pt_code, 0, sizeof(pte4_t) * 512);
     link_page_table(&p1_pgd[0], &p1_pud[0], &p1_pmd[0], &p1_pt_code[0], 1, &code_addr);
     load_code_physically(1, &code_addr);
 
@@ -124,6 +133,9 @@ static void TestContextSwitching()
     pte123_t p2_pud[512];
     pte123_t p2_pmd[512];
     pte4_t p2_pt_code[512];
+    memset(&p2_pud, 0, sizeof(pte123_t) * 512);
+    memset(&p2_pmd, 0, sizeof(pte123_t) * 512);
+    memset(&p2_pt_code, 0, sizeof(pte4_t) * 512);
     link_page_table(&p2_pgd[0], &p2_pud[0], &p2_pmd[0], &p2_pt_code[0], 3, &code_addr);
     load_code_physically(2, &code_addr);
 
@@ -131,6 +143,9 @@ static void TestContextSwitching()
     pte123_t p3_pud[512];
     pte123_t p3_pmd[512];
     pte4_t p3_pt_code[512];
+    memset(&p3_pud, 0, sizeof(pte123_t) * 512);
+    memset(&p3_pmd, 0, sizeof(pte123_t) * 512);
+    memset(&p3_pt_code, 0, sizeof(pte4_t) * 512);
     link_page_table(&p3_pgd[0], &p3_pud[0], &p3_pmd[0], &p3_pt_code[0], 5, &code_addr);
     load_code_physically(3, &code_addr);
 
@@ -0,0 +1,118 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "headers/cycle.h"
+#include "tests/fixture.h"
+
+// from isa.c
+void read_timer(uint64_t *time, uint64_t *countdown);
+
+// estimate the cycles of sum(n) computed recursively
+static void TestCycleModel()
+{
+    printf("Testing simulated cycle cost model ...\n");
+
+    uint64_t n = 3;
+
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",              // 0
+        "mov    %rsp,%rbp",         // 1
+        "sub    $0x10,%rsp",        // 2
+        "mov    %rdi,-0x8(%rbp)",   // 3
+        "cmpq   $0x0,-0x8(%rbp)",   // 4
+        "jne    0x400200",          // 5: jump to 8
+        "mov    $0x0,%eax",         // 6
+        "jmp    0x400380",          // 7: jump to 14
+        "mov    -0x8(%rbp),%rax",   // 8
+        "sub    $0x1,%rax",         // 9
+        "mov    %rax,%rdi",         // 10
+        "callq  0x00400000",        // 11
+        "mov    -0x8(%rbp),%rdx",   // 12
+        "add    %rdx,%rax",         // 13
+        "leaveq ",                  // 14
+        "retq   ",                  // 15
+        "mov    $0x0,%edi",         // 16: n is written below
+        "callq  0x00400000",        // 17
+        "mov    %rax,-0x8(%rbp)",   // 18
+        "jmp    0x4004c0",          // 19: halt
+    };
+    sprintf(assembly[16], "mov    $0x%lx,%%edi", n);
+
+    // a single process scheduled to itself by the timer
+    // the code page is physical page 1, the stack is mapped on page fault
+    load_program(assembly, 20);
+    cpu_reg.rsp = 0x7ffffffee0f0;
+    cpu_reg.rbp = 0x7ffffffee100;
+    cpu_pc.rip = 0x00400000 + 16 * MAX_INSTRUCTION_CHAR;
+
+    // the interrupt returns into the instruction cycle, not this loop,
+    // so the program halts in a dead loop instead of running out
+    int time = 0;
+    while (cpu_pc.rip != 0x00400000 + 19 * MAX_INSTRUCTION_CHAR &&
+        time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+    assert(cpu_reg.rax == n * (n + 1) / 2);
+
+    cycle_stat_t stat;
+    cycle_read_stat(&stat);
+    cycle_report(stdout, &stat);
+
+    // the cycles are the latencies of all events
+    uint64_t cycles = 0;
+    for (int i = 0; i < NUM_CYCLE_EVENT; ++ i)
+    {
+        assert(stat.event_cycles[i] == stat.count[i] * cycle_latency[i]);
+        cycles += stat.event_cycles[i];
+    }
+    assert(stat.cycles == cycles);
+
+    // the instructions re-executed after the page faults are counted twice
+    uint64_t global_time, countdown;
+    read_timer(&global_time, &countdown);
+    assert(stat.count[CYCLE_INSTRUCTION] == global_time);
+
+    // the data accesses are through the cache, and each missing line is loaded
+    assert(stat.count[CYCLE_DRAM_ACCESS] == 0);
+    assert(stat.count[CYCLE_CACHE_HIT] == 18 + 13);
+    assert(stat.count[CYCLE_CACHE_MISS] == stat.count[CYCLE_BUS_READ]);
+    assert(stat.count[CYCLE_CACHE_MISS] > 0);
+
+    // each TLB miss walks the page table till the faulting level
+    assert(stat.count[CYCLE_TLB_MISS] <= stat.count[CYCLE_PAGE_WALK]);
+    assert(stat.count[CYCLE_PAGE_WALK] <= stat.count[CYCLE_TLB_MISS] * 4);
+
+    // the timer switches the process to itself: all cycles are spent by it,
+    // except those since the last switching
+    assert(fixture_pcb[0].cycles.cycles > 0 && fixture_pcb[0].cycles.cycles <= stat.cycles);
+    cycle_account(&fixture_pcb[0].cycles);
+    assert(memcmp(&fixture_pcb[0].cycles, &stat, sizeof(cycle_stat_t)) == 0);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestCycleModel();
+    return 0;
+}
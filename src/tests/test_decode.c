@@ -0,0 +1,173 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/instruction.h"
+
+void parse_instruction(const char *str, inst_t *inst);
+uint64_t decode_instruction(uint8_t *code, uint64_t size, uint64_t vaddr, inst_t *inst,
+    void (*read_next_page)(uint64_t vaddr, uint8_t *buf, uint64_t size));
+
+static int operand_equal(od_t *a, od_t *b)
+{
+    int equal = 1;
+    equal = equal && (a->type == b->type);
+    equal = equal && (a->value == b->value);
+    equal = equal && (a->reg1 == b->reg1);
+    equal = equal && (a->reg2 == b->reg2);
+    equal = equal && (a->scal == b->scal);
+
+    return equal;
+}
+
+static int instruction_equal(inst_t *a, inst_t *b)
+{
+    int equal = 1;
+    equal = equal && (a->opcode == b->opcode);
+    equal = equal && (a->handler == b->handler);
+    equal = equal && operand_equal(&a->src, &b->src);
+    equal = equal && operand_equal(&a->dst, &b->dst);
+
+    return equal;
+}
+
+// the code at 0x401000, the rest of the instruction crossing the page
+static uint64_t next_page_vaddr = 0;
+
+static void read_next_page(uint64_t vaddr, uint8_t *buf, uint64_t size)
+{
+    uint8_t next_page[] = {0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f};
+    next_page_vaddr = vaddr;
+    memcpy(buf, next_page, size < sizeof(next_page) ? size : sizeof(next_page));
+}
+
+static void TestDecodingMachineCode()
+{
+    printf("Testing machine code decoding ...\n");
+
+    // sum() of test_run_isa.c, compiled at 0x400000
+    // the branch targets are the absolute addresses in assembly
+    uint8_t code[] = {
+        0x55,                               // 400000: push   %rbp
+        0x48, 0x89, 0xe5,                   // 400001: mov    %rsp,%rbp
+        0x48, 0x83, 0xec, 0x10,             // 400004: sub    $0x10,%rsp
+        0x48, 0x89, 0x7d, 0xf8,             // 400008: mov    %rdi,-0x8(%rbp)
+        0x48, 0x83, 0x7d, 0xf8, 0x00,       // 40000c: cmpq   $0x0,-0x8(%rbp)
+        0x75, 0x07,                         // 400011: jne    40001a
+        0xb8, 0x00, 0x00, 0x00, 0x00,       // 400013: mov    $0x0,%eax
+        0xeb, 0x17,                         // 400018: jmp    400031
+        0x48, 0x8b, 0x45, 0xf8,             // 40001a: mov    -0x8(%rbp),%rax
+        0x48, 0x83, 0xe8, 0x01,             // 40001e: sub    $0x1,%rax
+        0x48, 0x89, 0xc7,                   // 400022: mov    %rax,%rdi
+        0xe8, 0xd6, 0xff, 0xff, 0xff,       // 400025: callq  400000
+        0x48, 0x8b, 0x55, 0xf8,             // 40002a: mov    -0x8(%rbp),%rdx
+        0x48, 0x01, 0xd0,                   // 40002e: add    %rdx,%rax
+        0xc9,                               // 400031: leaveq
+        0xc3,                               // 400032: retq
+        0x48, 0x8d, 0x4c, 0x98, 0x08,       // 400033: lea    0x8(%rax,%rbx,4),%rcx
+        0x48, 0xbb, 0x68, 0x65, 0x6c, 0x6c,
+        0x6f, 0x20, 0x77, 0x6f,             // 400038: movq   $0x6f77206f6c6c6568,%rbx
+        0xcd, 0x80,                         // 400042: int    $0x80
+        0xf3, 0xa4,                         // 400044: rep movsb
+        0xf3, 0x48, 0xa5,                   // 400046: rep movsq
+        0xf3, 0xaa,                         // 400049: rep stosb
+        0xf3, 0x48, 0xab,                   // 40004b: rep stosq
+        0x4f, 0x8b, 0x1c, 0xd1,             // 40004e: mov    (%r9,%r10,8),%r11
+    };
+
+    char assembly[24][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",
+        "mov    %rsp,%rbp",
+        "sub    $0x10,%rsp",
+        "mov    %rdi,-0x8(%rbp)",
+        "cmpq   $0x0,-0x8(%rbp)",
+        "jne    0x40001a",
+        "mov    $0x0,%eax",
+        "jmp    0x400031",
+        "mov    -0x8(%rbp),%rax",
+        "sub    $0x1,%rax",
+        "mov    %rax,%rdi",
+        "callq  0x400000",
+        "mov    -0x8(%rbp),%rdx",
+        "add    %rdx,%rax",
+        "leaveq ",
+        "retq   ",
+        "lea    0x8(%rax,%rbx,4),%rcx",
+        "movq   $0x6f77206f6c6c6568,%rbx",
+        "int    $0x80",
+        "rep movsb",
+        "rep    movsq",
+        "rep stosb",
+        "rep    stosq",
+        "mov    (%r9,%r10,8),%r11",
+    };
+
+    uint64_t offset = 0;
+    for (int i = 0; i < 24; ++ i)
+    {
+        inst_t decoded, parsed;
+        offset += decode_instruction(&code[offset], sizeof(code) - offset, 0x400000 + offset,
+            &decoded, NULL);
+        parse_instruction(assembly[i], &parsed);
+
+        if (instruction_equal(&decoded, &parsed) == 0)
+        {
+            printf("%s\n", assembly[i]);
+            assert(0);
+        }
+    }
+    assert(offset == sizeof(code));
+
+    // mov    0x10(%rip),%rax
+    uint8_t rip_relative[] = {0x48, 0x8b, 0x05, 0x10, 0x00, 0x00, 0x00};
+    inst_t inst;
+    assert(decode_instruction(rip_relative, 7, 0x400000, &inst, NULL) == 7);
+    assert(inst.handler == HANDLER_MOV_MEM_REG);
+    assert(inst.src.type == OD_MEM);
+    assert(inst.src.value == 0x400017);
+    assert(inst.src.reg1 == 0);
+    assert(inst.dst.value == (uint64_t)&cpu_reg.rax);
+
+    // jne    400016, the two-byte opcode
+    uint8_t jne_rel32[] = {0x0f, 0x85, 0x10, 0x00, 0x00, 0x00};
+    assert(decode_instruction(jne_rel32, 6, 0x400000, &inst, NULL) == 6);
+    assert(inst.handler == HANDLER_JNE);
+    assert(inst.src.value == 0x400016);
+
+    // movq   $0x6f77206f6c6c6568,%rbx at 400ffd
+    // the next page is read only by the instruction crossing the boundary
+    uint8_t crossing[16] = {0x48, 0xbb, 0x68};
+    assert(decode_instruction(crossing, 3, 0x400ffd, &inst, &read_next_page) == 10);
+    assert(next_page_vaddr == 0x401000);
+    assert(inst.handler == HANDLER_MOV_IMM_REG);
+    assert(inst.src.value == 0x6f77206f6c6c6568);
+    assert(inst.dst.value == (uint64_t)&cpu_reg.rbx);
+
+    // retq at 400fff ends in the page
+    next_page_vaddr = 0;
+    uint8_t ending[16] = {0xc3};
+    assert(decode_instruction(ending, 1, 0x400fff, &inst, &read_next_page) == 1);
+    assert(next_page_vaddr == 0);
+    assert(inst.handler == HANDLER_RET);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestDecodingMachineCode();
+    return 0;
+}
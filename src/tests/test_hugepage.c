@@ -0,0 +1,143 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+void map_hugepage(pte123_t *pmd, uint64_t ppn);
+
+// 1 process with the code at 0x400000 in ppn 1, faulting in 2MB pages
+static void load_process(char (*assembly)[MAX_INSTRUCTION_CHAR], int count)
+{
+    load_program(assembly, count);
+    fixture_pcb[0].mm.hugepage = 1;
+}
+
+// the PMD entry of vaddr, whose PGD and PUD entries are present
+static pte123_t *get_pmd_entry(uint64_t vaddr_value)
+{
+    pte123_t *pgd = fixture_tables[0].pgd;
+    address_t vaddr = {.address_value = vaddr_value};
+    assert(pgd[vaddr.vpn1].present == 1);
+    pte123_t *pud = (pte123_t *)((uint64_t)pgd[vaddr.vpn1].paddr);
+    assert(pud[vaddr.vpn2].present == 1);
+    pte123_t *pmd = (pte123_t *)((uint64_t)pud[vaddr.vpn2].paddr);
+    return &pmd[vaddr.vpn3];
+}
+
+static void TestHugePageWalk()
+{
+    printf("Testing 2MB page translated by PMD ...\n");
+
+    char assembly[1][MAX_INSTRUCTION_CHAR] = {
+        "jmp    0x400000",
+    };
+    load_process(assembly, 1);
+    pte123_t *pgd = fixture_tables[0].pgd;
+
+    // the 2MB page at 0x7fffffe00000 in ppn 512 to 1023
+    static pte123_t data_pud[512], data_pmd[512];
+    memset(&data_pud, 0, sizeof(data_pud));
+    memset(&data_pmd, 0, sizeof(data_pmd));
+    address_t data_addr = {.address_value = 0x7fffffe00000};
+    pgd[data_addr.vpn1].paddr = (uint64_t)&data_pud[0];
+    pgd[data_addr.vpn1].present = 1;
+    data_pud[data_addr.vpn2].paddr = (uint64_t)&data_pmd[0];
+    data_pud[data_addr.vpn2].present = 1;
+    map_hugepage(&data_pmd[data_addr.vpn3], 512);
+
+    assert(va2pa(0x7fffffe12345) == 0x212345);
+    assert(va2pa(0x7ffffffff008) == 0x3ff008);
+    assert(va2pa(0x00400008) == 0x1008);
+
+    // the whole 2MB is cached by one TLB line
+    data_pmd[data_addr.vpn3].paddr = 0;
+    assert(va2pa(0x7fffffe12345) == 0x212345);
+    assert(va2pa(0x7fffffe00008) == 0x200008);
+    tlb_invalidate_page(1, 0x7fffffe80000);
+    assert(va2pa(0x7fffffe12345) == 0x12345);
+    assert(va2pa(0x00400008) == 0x1008);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestHugePageSwapping()
+{
+    printf("Testing 2MB pages faulted in and swapped ...\n");
+
+    // 2 regions of 2MB, but only one 2MB of free physical pages,
+    // so the 2MB pages are swapped out and in as a whole
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x7fffffe00000,%rdi",  // 0
+        "mov    $0x10,%rcx",            // 1: 16 pages
+        "mov    $0x1000,%rdx",          // 2
+        "mov    %rcx,(%rdi)",           // 3: write loop of A
+        "add    %rdx,%rdi",             // 4
+        "sub    $0x1,%rcx",             // 5
+        "jne    0x4000c0",              // 6
+        "mov    $0x7fffffc00000,%rsi",  // 7
+        "mov    $0x100,%rbx",           // 8
+        "mov    %rbx,(%rsi)",           // 9: B faults, A is swapped out
+        "mov    $0x7fffffe00000,%rdi",  // 10
+        "mov    $0x10,%rcx",            // 11
+        "mov    $0x0,%rax",             // 12
+        "mov    (%rdi),%rbx",           // 13: sum loop of A, swapped in
+        "add    %rbx,%rax",             // 14
+        "add    %rdx,%rdi",             // 15
+        "sub    $0x1,%rcx",             // 16
+        "jne    0x400340",              // 17
+        "mov    (%rsi),%rbx",           // 18: B is swapped in
+        "jmp    0x4004c0",              // 19: halt
+    };
+    load_process(assembly, 20);
+
+    int time = 0;
+    while (cpu_pc.rip != 0x004004c0 && time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+
+    assert(cpu_pc.rip == 0x004004c0);
+    // 16 + 15 + ... + 1
+    assert(cpu_reg.rax == 136);
+    assert(cpu_reg.rbx == 0x100);
+
+    // B is mapped by 2MB page, and A is on the swap pages
+    pte123_t *pmd_a = get_pmd_entry(0x7fffffe00000);
+    pte123_t *pmd_b = get_pmd_entry(0x7fffffc00000);
+    assert(pmd_b->present == 1 && pmd_b->hugepage == 1);
+    assert(pmd_a->present == 0 && pmd_a->daddr != 0);
+
+    uint64_t ppn_b = pmd_b->paddr >> PHYSICAL_PAGE_OFFSET_LENGTH;
+    assert(ppn_b % HUGE_PAGE_FRAME_NUM == 0);
+    assert(page_map[ppn_b].hugepage == 1);
+    assert(page_map[ppn_b].pte4 == (pte4_t *)pmd_b);
+    assert(page_map[ppn_b + HUGE_PAGE_FRAME_NUM - 1].hugepage == 1);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestHugePageWalk();
+    TestHugePageSwapping();
+    return 0;
+}
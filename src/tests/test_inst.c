@@ -12,25 +12,13 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "headers/cpu.h"
 #include "headers/memory.h"
 #include "headers/common.h"
 #include "headers/algorithm.h"
 #include "headers/instruction.h"
 
-void mov_handler             (od_t *src_od, od_t *dst_od) {};
-void push_handler            (od_t *src_od, od_t *dst_od) {};
-void pop_handler             (od_t *src_od, od_t *dst_od) {};
-void leave_handler           (od_t *src_od, od_t *dst_od) {};
-void call_handler            (od_t *src_od, od_t *dst_od) {};
-void ret_handler             (od_t *src_od, od_t *dst_od) {};
-void add_handler             (od_t *src_od, od_t *dst_od) {};
-void sub_handler             (od_t *src_od, od_t *dst_od) {};
-void cmp_handler             (od_t *src_od, od_t *dst_od) {};
-void jne_handler             (od_t *src_od, od_t *dst_od) {};
-void jmp_handler             (od_t *src_od, od_t *dst_od) {};
-void lea_handler             (od_t *src_od, od_t *dst_od) {};
-
 void parse_instruction(const char *str, inst_t *inst);
 void parse_operand(const char *str, od_t *od);
 uint64_t compute_operand(od_t *od);
@@ -50,6 +38,9 @@ static int operand_equal(od_t *a, od_t *b)
     int equal = 1;
     equal = equal && (a->type == b->type);
     equal = equal && (a->value == b->value);
+    equal = equal && (a->reg1 == b->reg1);
+    equal = equal && (a->reg2 == b->reg2);
+    equal = equal && (a->scal == b->scal);
 
     return equal;
 }
@@ -67,7 +58,8 @@ static int instruction_equal(inst_t *a, inst_t *b)
     }
 
     int equal = 1;
-    equal = equal && (a->op == b->op);
+    equal = equal && (a->opcode == b->opcode);
+    equal = equal && (a->handler == b->handler);
     equal = equal && operand_equal(&a->src, &b->src);
     equal = equal && operand_equal(&a->dst, &b->dst);
 
@@ -99,7 +91,8 @@ static void TestParsingInstruction()
     inst_t std_inst[15] = {
         // push   %rbp
         {
-            .op = &push_handler,
+            .opcode = INST_PUSH,
+            .handler = HANDLER_PUSH_REG,
             .src = 
                 {
                     .type = OD_REG,
@@ -113,7 +106,8 @@ static void TestParsingInstruction()
         },        
         // mov    %rsp,%rbp
         {
-            .op = &mov_handler, 
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_REG,
             .src = {
                 .type = OD_REG, 
                 .value = (uint64_t)(&cpu_reg.rsp), 
@@ -125,34 +119,40 @@ static void TestParsingInstruction()
         },
         // mov    %rdi,-0x18(%rbp)
         {
-            .op = &mov_handler, 
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_MEM,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rdi), 
             }, 
             .dst = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x18,
+                .value = -0x18,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             }
         },
         // mov    %rsi,-0x20(%rbp)
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_MEM,
             .src = {
                 .type = OD_REG, 
                 .value = (uint64_t)(&cpu_reg.rsi),
             }, 
             .dst = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x20,
+                .value = -0x20,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             }
         },
         // mov    -0x18(%rbp),%rdx
         {
-            .op = &mov_handler, 
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
             .src = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x18,
+                .value = -0x18,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             },
             .dst = {
                 .type = OD_REG,
@@ -161,10 +161,12 @@ static void TestParsingInstruction()
         },
         // mov    -0x20(%rbp),%rax
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
             .src = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x20,
+                .value = -0x20,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             },
             .dst = {
                 .type = OD_REG,
@@ -173,7 +175,8 @@ static void TestParsingInstruction()
         },
         // add    %rdx,%rax
         {
-            .op = &add_handler,
+            .opcode = INST_ADD,
+            .handler = HANDLER_ADD_REG_REG,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rdx),
@@ -185,22 +188,26 @@ static void TestParsingInstruction()
         },
         // mov    %rax,-0x8(%rbp)
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_MEM,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rax),
             },
             .dst = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x8,
+                .value = -0x8,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             }
         },
         // mov    -0x8(%rbp),%rax
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
             .src = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x8,
+                .value = -0x8,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             },
             .dst = {
                 .type = OD_REG,
@@ -209,7 +216,8 @@ static void TestParsingInstruction()
         },
         // pop    %rbp
         {
-            .op = &pop_handler,
+            .opcode = INST_POP,
+            .handler = HANDLER_POP_REG,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rbp),
@@ -221,7 +229,8 @@ static void TestParsingInstruction()
         },
         // retq
         {
-            .op = &ret_handler,
+            .opcode = INST_RET,
+            .handler = HANDLER_RET,
             .src = {
                 .type = OD_EMPTY,
                 .value = 0,
@@ -233,7 +242,8 @@ static void TestParsingInstruction()
         },
         // mov    %rdx,%rsi
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_REG,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rdx),
@@ -245,7 +255,8 @@ static void TestParsingInstruction()
         },
         // mov    %rax,%rdi
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_REG,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rax),
@@ -257,7 +268,8 @@ static void TestParsingInstruction()
         },
         // callq  0
         {
-            .op = &call_handler,
+            .opcode = INST_CALL,
+            .handler = HANDLER_CALL,
             .src = {
                 .type = OD_MEM,
                 .value = 0,
@@ -270,14 +282,16 @@ static void TestParsingInstruction()
         },
         // mov    %rax,-0x8(%rbp)
         {
-            .op = &mov_handler,
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_MEM,
             .src = {
                 .type = OD_REG,
                 .value = (uint64_t)(&cpu_reg.rax),
             },
             .dst = {
                 .type = OD_MEM,
-                .value = cpu_reg.rbp - 0x8,
+                .value = -0x8,
+                .reg1 = (uint64_t)(&cpu_reg.rbp),
             }
         },
     };
@@ -293,8 +307,200 @@ static void TestParsingInstruction()
     printf("\033[32;1m\tPass\033[0m\n");
 }
 
+static void TestParsingEffectiveAddress()
+{
+    printf("Testing effective address parsing ...\n");
+
+    char assembly[4][MAX_INSTRUCTION_CHAR] = {
+        "mov    0x10(%rax,%rbx,8),%rcx",    // 0
+        "lea    0x0(,%rax,8),%rdx",         // 1
+        "mov    (%rax,%rbx),%rcx",          // 2
+        "mov    %rcx,0x7fff1234",           // 3
+    };
+
+    inst_t std_inst[4] = {
+        // mov    0x10(%rax,%rbx,8),%rcx
+        {
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
+            .src = {
+                .type = OD_MEM,
+                .value = 0x10,
+                .reg1 = (uint64_t)(&cpu_reg.rax),
+                .reg2 = (uint64_t)(&cpu_reg.rbx),
+                .scal = 8,
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.rcx),
+            }
+        },
+        // lea    0x0(,%rax,8),%rdx
+        {
+            .opcode = INST_LEA,
+            .handler = HANDLER_LEA_MEM_REG,
+            .src = {
+                .type = OD_MEM,
+                .value = 0,
+                .reg2 = (uint64_t)(&cpu_reg.rax),
+                .scal = 8,
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.rdx),
+            }
+        },
+        // mov    (%rax,%rbx),%rcx
+        {
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
+            .src = {
+                .type = OD_MEM,
+                .reg1 = (uint64_t)(&cpu_reg.rax),
+                .reg2 = (uint64_t)(&cpu_reg.rbx),
+                .scal = 1,
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.rcx),
+            }
+        },
+        // mov    %rcx,0x7fff1234
+        {
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_MEM,
+            .src = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.rcx),
+            },
+            .dst = {
+                .type = OD_MEM,
+                .value = 0x7fff1234,
+            }
+        },
+    };
+
+    inst_t inst_parsed;
+
+    for (int i = 0; i < 4; ++ i)
+    {
+        // the decoding result must not depend on the register values
+        cpu_reg.rax = 0x1234 * i;
+        cpu_reg.rbx = 0xabcd * i;
+        parse_instruction(assembly[i], &inst_parsed);
+        assert(instruction_equal(&std_inst[i], &inst_parsed) == 1);
+    }
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestParsingExtendedRegisters()
+{
+    printf("Testing %%r8 - %%r15 parsing ...\n");
+
+    char assembly[3][MAX_INSTRUCTION_CHAR] = {
+        "mov    %r8,%r15",                  // 0
+        "mov    0x8(%r12,%r13,4),%r9",      // 1
+        "lea    0x0(,%r10,8),%r11",         // 2
+    };
+
+    inst_t std_inst[3] = {
+        // mov    %r8,%r15
+        {
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_REG_REG,
+            .src = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.r8),
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.r15),
+            }
+        },
+        // mov    0x8(%r12,%r13,4),%r9
+        {
+            .opcode = INST_MOV,
+            .handler = HANDLER_MOV_MEM_REG,
+            .src = {
+                .type = OD_MEM,
+                .value = 0x8,
+                .reg1 = (uint64_t)(&cpu_reg.r12),
+                .reg2 = (uint64_t)(&cpu_reg.r13),
+                .scal = 4,
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.r9),
+            }
+        },
+        // lea    0x0(,%r10,8),%r11
+        {
+            .opcode = INST_LEA,
+            .handler = HANDLER_LEA_MEM_REG,
+            .src = {
+                .type = OD_MEM,
+                .value = 0,
+                .reg2 = (uint64_t)(&cpu_reg.r10),
+                .scal = 8,
+            },
+            .dst = {
+                .type = OD_REG,
+                .value = (uint64_t)(&cpu_reg.r11),
+            }
+        },
+    };
+
+    inst_t inst_parsed;
+
+    for (int i = 0; i < 3; ++ i)
+    {
+        parse_instruction(assembly[i], &inst_parsed);
+        assert(instruction_equal(&std_inst[i], &inst_parsed) == 1);
+    }
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestParsingPerformance()
+{
+    printf("Testing instruction parsing performance ...\n");
+
+    char assembly[8][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",
+        "mov    %rsp,%rbp",
+        "mov    %rdi,-0x18(%rbp)",
+        "mov    -0x20(%rbp),%rax",
+        "add    %rdx,%rax",
+        "lea    0x0(,%rax,8),%rdx",
+        "callq  0x00400000",
+        "retq",
+    };
+
+    inst_t inst_parsed;
+    uint64_t count = 0;
+
+    long t0 = clock();
+    for (int k = 0; k < 100000; ++ k)
+    {
+        for (int i = 0; i < 8; ++ i)
+        {
+            parse_instruction(assembly[i], &inst_parsed);
+            count += 1;
+        }
+    }
+    double seconds = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    printf("\tdecoded %lu instructions in %.3f s: %.0f instructions/s\n",
+        count, seconds, count / seconds);
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
 int main()
 {
     TestParsingInstruction();
+    TestParsingEffectiveAddress();
+    TestParsingExtendedRegisters();
+    TestParsingPerformance();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+void map_pte4(pte4_t *pte, uint64_t ppn);
+void pagemap_dirty(uint64_t ppn);
+
+// from jit.c
+uint64_t jit_compiled_blocks();
+
+static void run_blocks(uint64_t halt, int max_blocks)
+{
+    int time = 0;
+    while (cpu_pc.rip != halt && time < max_blocks)
+    {
+        block_cycle();
+        time ++;
+    }
+    assert(cpu_pc.rip == halt);
+}
+
+static uint64_t read_guest(uint64_t vaddr)
+{
+    return cpu_read64bits_dram(va2pa(vaddr));
+}
+
+static void TestCompiledCall()
+{
+    printf("Testing compiled call, push, pop and flags ...\n");
+
+    char assembly[15][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x7ffffffee000,%rsp",      // 0
+        "mov    $0x0,%rax",                 // 1
+        "mov    $0x1,%rbx",                 // 2
+        "mov    $0x3e8,%rcx",               // 3: 1000 rounds
+        "callq  0x400280",                  // 4: loop
+        "sub    $0x1,%rcx",                 // 5
+        "jne    0x400100",                  // 6
+        "jmp    0x4001c0",                  // 7: halt
+        "jmp    0x4001c0",                  // 8
+        "jmp    0x4001c0",                  // 9
+        "push   %rbx",                      // 10: add rbx to rax
+        "add    %rbx,%rax",                 // 11
+        "lea    0x1(%rbx),%rbx",            // 12
+        "pop    %rdx",                      // 13
+        "retq   ",                          // 14
+    };
+    load_program(assembly, 15);
+
+    uint64_t blocks = jit_compiled_blocks();
+    run_blocks(0x004001c0, 100000);
+
+    assert(cpu_reg.rax == 500500);
+    assert(cpu_reg.rbx == 1001);
+    assert(cpu_reg.rcx == 0);
+    assert(cpu_reg.rdx == 1000);
+    assert(cpu_reg.rsp == 0x7ffffffee000);
+    // the return address of the last call
+    assert(read_guest(0x7ffffffedff8) == 0x00400140);
+    assert(jit_compiled_blocks() > blocks);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestCompiledPageFault()
+{
+    printf("Testing page faults and timer in compiled blocks ...\n");
+
+    // the loop is compiled before the later pages are touched,
+    // so they fault in the compiled code and the writes are resumed
+    char assembly[8][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x7fffffe00000,%rdi",      // 0
+        "mov    $0xc0,%rcx",                // 1: 12 pages, 16 writes each
+        "mov    $0x100,%rdx",               // 2
+        "mov    %rcx,(%rdi)",               // 3: loop
+        "add    %rdx,%rdi",                 // 4
+        "sub    $0x1,%rcx",                 // 5
+        "jne    0x4000c0",                  // 6
+        "jmp    0x4001c0",                  // 7: halt
+    };
+    load_program(assembly, 8);
+
+    uint64_t blocks = jit_compiled_blocks();
+    run_blocks(0x004001c0, 100000);
+
+    assert(cpu_reg.rcx == 0);
+    assert(cpu_reg.rdi == 0x7fffffe00000 + 0xc0 * 0x100);
+    for (int i = 0; i < 0xc0; ++ i)
+    {
+        assert(read_guest(0x7fffffe00000 + i * 0x100) == 0xc0 - i);
+    }
+    assert(jit_compiled_blocks() > blocks);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestLinkedCodePages()
+{
+    printf("Testing code pages reached by block links under page replacement ...\n");
+
+    // the loop goes from page A to page B by the direct links only,
+    // while the data pages more than the memory are swapped
+    char assembly[5][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x7fffffe00000,%rdi",      // 0
+        "mov    $0x40,%rcx",                // 1: 64 pages
+        "mov    $0x1000,%rdx",              // 2
+        "mov    %rcx,(%rdi)",               // 3: loop
+        "jmp    0x401000",                  // 4
+    };
+    char page_b[4][MAX_INSTRUCTION_CHAR] = {
+        "add    %rdx,%rdi",                 // 0x401000
+        "sub    $0x1,%rcx",                 // 0x401040
+        "jne    0x4000c0",                  // 0x401080
+        "jmp    0x4010c0",                  // 0x4010c0: halt
+    };
+    load_program(assembly, 5);
+    pte4_t *pt = fixture_tables[0].pt;
+    address_t code_addr = {.address_value = 0x00400000};
+    map_pte4(&pt[code_addr.vpn4 + 1], 2);
+    for (int i = 0; i < 4; ++ i)
+    {
+        cpu_writeinst_dram(2 * PAGE_SIZE + i * MAX_INSTRUCTION_CHAR, page_b[i]);
+    }
+    pagemap_dirty(2);
+
+    run_blocks(0x004010c0, 100000);
+    assert(cpu_reg.rcx == 0);
+    assert(read_guest(0x7fffffe00000 + 0x3f * 0x1000) == 1);
+
+    // both code pages are referenced in each scan, never the victims
+    assert(pt[code_addr.vpn4].present == 1 && pt[code_addr.vpn4].ppn == 1);
+    assert(pt[code_addr.vpn4 + 1].present == 1 && pt[code_addr.vpn4 + 1].ppn == 2);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestCompiledCall();
+    TestCompiledPageFault();
+    TestLinkedCodePages();
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "headers/linker.h"
+
+void map_pte4(pte4_t *pte, uint64_t ppn);
+void page_map_init();
+
+// from loader.c
+uint64_t load_text_section(elf_t *eof);
+void load_machine_code(uint64_t vaddr, uint8_t *code, uint64_t size);
+
+static pcb_t p1;
+static pte123_t pgd[512], pud[512], pmd[512];
+static pte4_t pt[512];
+static uint8_t *stack_buf = NULL;
+
+// the only process with the level 4 table of 0x400000 ready
+// but no page mapped, the loaded pages are mapped by the test
+static void create_process(inst_encoding_t encoding)
+{
+    memset(&cpu_reg, 0, sizeof(cpu_reg));
+    memset(&cpu_flags, 0, sizeof(cpu_flags));
+    cpu_pc.rip = 0x00400000;
+
+    memset(&p1, 0, sizeof(pcb_t));
+    p1.pid = 1;
+    p1.next = &p1;
+    p1.prev = &p1;
+    p1.inst_encoding = encoding;
+    cpu_inst_encoding = encoding;
+
+    memset(&pgd, 0, sizeof(pte123_t) * 512);
+    memset(&pud, 0, sizeof(pte123_t) * 512);
+    memset(&pmd, 0, sizeof(pte123_t) * 512);
+    memset(&pt, 0, sizeof(pte4_t) * 512);
+    p1.mm.pgd = &pgd[0];
+
+    page_map_init();
+    tlb_flush_all();
+
+    address_t code_addr = {.address_value = 0x00400000};
+    (&(pgd[code_addr.vpn1]))->paddr = (uint64_t)&pud[0];
+    (&(pgd[code_addr.vpn1]))->present = 1;
+    (&(pud[code_addr.vpn2]))->paddr = (uint64_t)&pmd[0];
+    (&(pud[code_addr.vpn2]))->present = 1;
+    (&(pmd[code_addr.vpn3]))->paddr = (uint64_t)&pt[0];
+    (&(pmd[code_addr.vpn3]))->present = 1;
+
+    if (stack_buf == NULL)
+    {
+        stack_buf = malloc(KERNEL_STACK_SIZE * 2);
+    }
+    p1.kstack = (kstack_t *)((((uint64_t)stack_buf + KERNEL_STACK_SIZE) >> 13) << 13);
+    p1.kstack->threadinfo.pcb = &p1;
+
+    tr_global_tss.ESP0 = (uint64_t)p1.kstack + KERNEL_STACK_SIZE;
+    cpu_controls.cr3 = p1.mm.pgd_paddr;
+
+    idt_init();
+    syscall_init();
+}
+
+static void run_to_halt(uint64_t halt, int max_cycles)
+{
+    int time = 0;
+    while (cpu_pc.rip != halt && time < max_cycles)
+    {
+        instruction_cycle();
+        time ++;
+    }
+    assert(cpu_pc.rip == halt);
+}
+
+static void TestLoadTextSection()
+{
+    printf("Testing loading the .text section of EOF ...\n");
+
+    // the EOF as parsed from file, the .text lines after the header
+    char text[6][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x0,%rax",                 // 0x400000
+        "mov    $0xa,%rcx",                 // 0x400040
+        "add    %rcx,%rax",                 // 0x400080: loop
+        "sub    $0x1,%rcx",                 // 0x4000c0
+        "jne    0x400080",                  // 0x400100
+        "jmp    0x400140",                  // 0x400140: halt
+    };
+    elf_t *eof = malloc(sizeof(elf_t));
+    memset(eof, 0, sizeof(elf_t));
+    sh_entry_t sht[1] = {
+        {.sh_name = ".text", .sh_addr = 0x00400000, .sh_offset = 2, .sh_size = 6},
+    };
+    eof->sht_count = 1;
+    eof->sht = &sht[0];
+    eof->line_count = 2 + 6;
+    for (int i = 0; i < 6; ++ i)
+    {
+        strcpy(eof->buffer[2 + i], text[i]);
+    }
+
+    create_process(INST_ENCODING_TEXT);
+    address_t code_addr = {.address_value = 0x00400000};
+    map_pte4(&pt[code_addr.vpn4], 1);
+
+    assert(load_text_section(eof) == 6);
+    assert(strcmp((char *)&pm[PAGE_SIZE + 0x80], "add    %rcx,%rax") == 0);
+
+#ifdef USE_DECODE_CACHE
+    // the instructions are decoded at load time, so the strings
+    // are never parsed again: break them behind the decode cache
+    for (int i = 0; i < 6; ++ i)
+    {
+        strcpy((char *)&pm[PAGE_SIZE + i * MAX_INSTRUCTION_CHAR], "hlt");
+    }
+#endif
+
+    run_to_halt(0x00400140, 1000);
+    assert(cpu_reg.rax == 55);
+    assert(cpu_reg.rcx == 0);
+
+    free(eof);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestLoadMachineCode()
+{
+    printf("Testing loading and running x86-64 machine code ...\n");
+
+    // the loop crosses the page boundary inside `sub`
+    uint8_t code[] = {
+        0xb8, 0x00, 0x00, 0x00, 0x00,       // 400ff0: mov    $0x0,%eax
+        0xb9, 0x0a, 0x00, 0x00, 0x00,       // 400ff5: mov    $0xa,%ecx
+        0x48, 0x01, 0xc8,                   // 400ffa: add    %rcx,%rax
+        0x48, 0x83, 0xe9, 0x01,             // 400ffd: sub    $0x1,%rcx
+        0x75, 0xf7,                         // 401001: jne    400ffa
+        0xeb, 0xfe,                         // 401003: jmp    401003
+    };
+
+    create_process(INST_ENCODING_BINARY);
+    cpu_pc.rip = 0x00400ff0;
+
+    // the continuous virtual pages on the physical pages apart
+    address_t code_addr = {.address_value = 0x00400000};
+    map_pte4(&pt[code_addr.vpn4], 1);
+    map_pte4(&pt[code_addr.vpn4 + 1], 3);
+
+    load_machine_code(0x00400ff0, code, sizeof(code));
+    assert(pm[PAGE_SIZE + 0xfff] == 0xe9);
+    assert(pm[3 * PAGE_SIZE + 0x000] == 0x01);
+
+    run_to_halt(0x00401003, 1000);
+    assert(cpu_reg.rax == 55);
+    assert(cpu_reg.rcx == 0);
+
+    cpu_inst_encoding = INST_ENCODING_TEXT;
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestMachineCodeEndingThePage()
+{
+    printf("Testing machine code ending at the page boundary ...\n");
+
+    uint8_t code[] = {
+        0xb8, 0x07, 0x00, 0x00, 0x00,       // 401ff9: mov    $0x7,%eax
+        0xeb, 0xfe,                         // 401ffe: jmp    401ffe
+    };
+
+    create_process(INST_ENCODING_BINARY);
+    cpu_pc.rip = 0x00401ff9;
+
+    // the next page is not mapped
+    address_t code_addr = {.address_value = 0x00401000};
+    map_pte4(&pt[code_addr.vpn4], 1);
+    load_machine_code(0x00401ff9, code, sizeof(code));
+
+    for (int i = 0; i < 4; ++ i)
+    {
+        instruction_cycle();
+    }
+    assert(cpu_pc.rip == 0x00401ffe);
+    assert(cpu_reg.rax == 7);
+
+    // no instruction crosses the boundary, so the next
+    // page is never translated and never faults in
+    assert(pt[code_addr.vpn4 + 1].present == 0);
+
+    cpu_inst_encoding = INST_ENCODING_TEXT;
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestLoadTextSection();
+    TestLoadMachineCode();
+    TestMachineCodeEndingThePage();
+    free(stack_buf);
+    return 0;
+}
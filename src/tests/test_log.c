@@ -0,0 +1,110 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "headers/log.h"
+
+#define NUM_THREADS (4)
+// all records of the threads fit in the ring
+#define NUM_RECORDS (1000)
+#define LOG_FILE "./bin/log.txt"
+
+static void *log_thread(void *id)
+{
+    for (uint64_t i = 0; i < NUM_RECORDS; ++ i)
+    {
+        LOG(LOG_SCHEDULE, LOG_INFO, "thread %ld record %ld\n", (uint64_t)id, i);
+        // filtered out, never copied to the ring
+        LOG(LOG_SCHEDULE, LOG_DEBUG, "debug %ld\n", i);
+        LOG(LOG_MMU, LOG_INFO, "mmu %ld\n", i);
+    }
+    return NULL;
+}
+
+// each thread's records are printed in order, and none is dropped
+// the records of each thread are logged by rounds of NUM_RECORDS
+static void check_output(int rounds)
+{
+    fflush(stdout);
+    FILE *fr = fopen(LOG_FILE, "r");
+    assert(fr != NULL);
+
+    uint64_t next[NUM_THREADS] = {0};
+    uint64_t count = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fr) != NULL)
+    {
+        uint64_t id, i;
+        int matched = sscanf(line, "thread %ld record %ld", &id, &i);
+        assert(matched == 2);
+        assert(id < NUM_THREADS);
+        assert(i == next[id] % NUM_RECORDS);
+        next[id] += 1;
+        count += 1;
+    }
+    fclose(fr);
+
+    assert(count == rounds * NUM_THREADS * NUM_RECORDS);
+}
+
+static void TestLogRing()
+{
+    printf("Testing lock-free log ring ...\n");
+    fflush(stdout);
+
+    log_level = LOG_INFO;
+    log_mask = LOG_ALL & ~LOG_MMU;
+
+    // the records are printed to the file instead of terminal
+    FILE *console = fdopen(dup(fileno(stdout)), "w");
+    FILE *redirected = freopen(LOG_FILE, "w", stdout);
+    assert(redirected != NULL);
+
+    // flushed by the thread, concurrent with the producers
+    int started = log_start_flusher(100);
+    assert(started == 1);
+    pthread_t threads[NUM_THREADS];
+    for (uint64_t i = 0; i < NUM_THREADS; ++ i)
+    {
+        int error = pthread_create(&threads[i], NULL, &log_thread, (void *)i);
+        assert(error == 0);
+    }
+    for (int i = 0; i < NUM_THREADS; ++ i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    log_stop_flusher();
+    check_output(1);
+
+    // no flusher: the records exceeding the ring are flushed by the
+    // producer at the high-water mark instead of dropped
+    redirected = freopen(LOG_FILE, "w", stdout);
+    assert(redirected != NULL);
+    for (uint64_t i = 0; i < NUM_THREADS * 2; ++ i)
+    {
+        log_thread((void *)(i % NUM_THREADS));
+    }
+    log_flush();
+    check_output(2);
+
+    fprintf(console, "\033[32;1m\tPass\033[0m\n");
+    fclose(console);
+}
+
+int main()
+{
+    TestLogRing();
+    return 0;
+}
@@ -0,0 +1,102 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+#define NUM_MACHINES (4)
+
+// boot one machine on the calling thread and compute sum(n) recursively
+// the timer interrupts and the page faults of the stack are all handled
+// by the machine of this thread
+static void *run_machine(void *arg)
+{
+    uint64_t n = (uint64_t)arg;
+
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",              // 0
+        "mov    %rsp,%rbp",         // 1
+        "sub    $0x10,%rsp",        // 2
+        "mov    %rdi,-0x8(%rbp)",   // 3
+        "cmpq   $0x0,-0x8(%rbp)",   // 4
+        "jne    0x400200",          // 5: jump to 8
+        "mov    $0x0,%eax",         // 6
+        "jmp    0x400380",          // 7: jump to 14
+        "mov    -0x8(%rbp),%rax",   // 8
+        "sub    $0x1,%rax",         // 9
+        "mov    %rax,%rdi",         // 10
+        "callq  0x00400000",        // 11
+        "mov    -0x8(%rbp),%rdx",   // 12
+        "add    %rdx,%rax",         // 13
+        "leaveq ",                  // 14
+        "retq   ",                  // 15
+        "mov    $0x0,%edi",         // 16: n is written below
+        "callq  0x00400000",        // 17
+        "mov    %rax,-0x8(%rbp)",   // 18
+        "jmp    0x4004c0",          // 19: halt
+    };
+    sprintf(assembly[16], "mov    $0x%lx,%%edi", n);
+
+    // a single process scheduled to itself by the timer
+    // the code page is physical page 1, the stack is mapped on page fault
+    load_program(assembly, 20);
+    cpu_reg.rsp = 0x7ffffffee0f0;
+    cpu_reg.rbp = 0x7ffffffee100;
+    cpu_pc.rip = 0x00400000 + 16 * MAX_INSTRUCTION_CHAR;
+
+    // the interrupt returns into the instruction cycle, not this loop,
+    // so the program halts in a dead loop instead of running out
+    int time = 0;
+    while (cpu_pc.rip != 0x00400000 + 19 * MAX_INSTRUCTION_CHAR &&
+        time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+
+    assert(cpu_reg.rax == n * (n + 1) / 2);
+
+    return NULL;
+}
+
+static void TestParallelMachines()
+{
+    printf("Testing %d machines on parallel threads ...\n", NUM_MACHINES);
+
+    pthread_t threads[NUM_MACHINES];
+    for (uint64_t i = 0; i < NUM_MACHINES; ++ i)
+    {
+        // each machine computes a different sum
+        pthread_create(&threads[i], NULL, run_machine, (void *)(i + 3));
+    }
+    for (int i = 0; i < NUM_MACHINES; ++ i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestParallelMachines();
+    return 0;
+}
@@ -28,6 +28,8 @@ void pagemap_dirty(uint64_t ppn);
 void pagemap_update_time(uint64_t ppn);
 void set_pagemap_swapaddr(uint64_t ppn, uint64_t swap_address);
 uint64_t allocate_swappage(uint64_t ppn);
+void read_swappage(uint64_t daddr, uint8_t *page);
+void write_swappage(uint64_t daddr, uint8_t *page);
 
 static void link_page_table(pte123_t *pgd, pte123_t *pud, pte123_t *pmd, pte4_t *pt,
     int ppn, address_t *vaddr)
@@ -292,10 +294,133 @@ static void TestPageFaultHandlingCase3()
     printf("\033[32;1m\tPass; Check the swapped out files.\033[0m\n");
 }
 
+static void TestPageFaultHandlingCase4()
+{
+    printf("================\nTesting page fault case 4: Find a LRU dirty ppn without swap page ...\n");
+
+    cpu_pc.rip = 0x00400000;
+
+    address_t code_addr = {.address_value = cpu_pc.rip};
+
+    page_map_init();
+
+    pcb_t p1;
+    memset(&p1, 0, sizeof(pcb_t));
+    p1.pid = 1;
+    p1.next = &p1;
+    p1.prev = &p1;
+
+    pte123_t p1_pgd[512];
+    memset(&p1_pgd, 0, sizeof(pte123_t) * 512);
+    p1.mm.pgd = &p1_pgd[0];
+
+    pte123_t p1_pud[512];
+    pte123_t p1_pmd[512];
+    pte4_t   p1_pt[512];
+    memset(&p1_pud, 0, sizeof(pte123_t) * 512);
+    memset(&p1_pmd, 0, sizeof(pte123_t) * 512);
+    memset(&p1_pt, 0, sizeof(pte4_t) * 512);
+    link_page_table(&p1_pgd[0], &p1_pud[0], &p1_pmd[0], &p1_pt[0], 0, &code_addr);
+
+    char code[3][MAX_INSTRUCTION_CHAR] = {
+        "mov %rsp, 0x7fff1234",
+        "mov $1, %rax",
+        "mov $2, %rax",
+    };
+    memcpy(
+        (char *)(&pm[0 + code_addr.ppo]),
+        &code, sizeof(char) * 3 * MAX_INSTRUCTION_CHAR);
+
+    // the LRU page was mapped from a free ppn and written,
+    // it has never been written back, so no swap page yet
+    uint64_t lru_ppn = 14;
+    pte4_t other_process_pte4[MAX_NUM_PHYSICAL_PAGE];
+    memset(&other_process_pte4, 0, sizeof(other_process_pte4));
+    for (int i = 1; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        map_pte4(&other_process_pte4[i], i);
+        pagemap_dirty(i);
+        if (i != lru_ppn)
+        {
+            allocate_swappage(i);
+        }
+    }
+    pagemap_dirty(0);
+    *(uint64_t *)&pm[(lru_ppn << PHYSICAL_PAGE_OFFSET_LENGTH) + 8] = 0x12345678abcdef;
+
+    for (int i = 0; i < MAX_NUM_PHYSICAL_PAGE; ++ i)
+    {
+        if (i != lru_ppn)
+        {
+            pagemap_update_time(i);
+        }
+    }
+
+    uint8_t stack_buf[8192 * 2];
+    uint64_t p1_stack_bottom = (((uint64_t)&stack_buf[8192]) >> 13) << 13;
+    p1.kstack = (kstack_t *)p1_stack_bottom;
+    p1.kstack->threadinfo.pcb = &p1;
+
+    tr_global_tss.ESP0 = p1_stack_bottom + KERNEL_STACK_SIZE;
+
+    cpu_controls.cr3 = p1.mm.pgd_paddr;
+    idt_init();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        instruction_cycle();
+    }
+
+    // the swap page is allocated on the first write back
+    pte4_t *victim = &other_process_pte4[lru_ppn];
+    assert(victim->present == 0);
+    assert(victim->daddr != 0);
+    uint8_t page[PAGE_SIZE];
+    read_swappage(victim->daddr, page);
+    assert(*(uint64_t *)&page[8] == 0x12345678abcdef);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestSwapPageRoundTrip()
+{
+    printf("================\nTesting swap page write and read ...\n");
+
+    // the small values are padded by zeros, not spaces, in the page file
+    uint64_t page[PAGE_SIZE / 8];
+    for (int i = 0; i < PAGE_SIZE / 8; ++ i)
+    {
+        page[i] = (uint64_t)i << (i % 64);
+    }
+    page[0] = 0;
+    page[1] = 1;
+    page[2] = 0xffffffffffffffff;
+
+    uint64_t daddr = allocate_swappage(0);
+    write_swappage(daddr, (uint8_t *)page);
+
+    char filename[128];
+    sprintf(filename, "./files/swap/page-%ld.page.txt", daddr);
+    FILE *fr = fopen(filename, "r");
+    assert(fr != NULL);
+    char line[64];
+    char *str = fgets(line, 64, fr);
+    assert(str != NULL && strcmp(line, "0x0000000000000000\n") == 0);
+    fclose(fr);
+
+    uint64_t read[PAGE_SIZE / 8];
+    read_swappage(daddr, (uint8_t *)read);
+    assert(memcmp(page, read, PAGE_SIZE) == 0);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
 int main()
 {
+    TestSwapPageRoundTrip();
     TestPageFaultHandlingCase1();
     TestPageFaultHandlingCase2();
     TestPageFaultHandlingCase3();
+    TestPageFaultHandlingCase4();
     return 0;
 }
\ No newline at end of file
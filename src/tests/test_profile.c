@@ -0,0 +1,112 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+// from profile.c
+uint64_t profile_read_count(uint64_t rip);
+void profile_report(FILE *stream);
+void profile_write_collapsed(const char *filename);
+
+// compute sum(n) recursively under the profiler
+static void TestProfilingSum()
+{
+    printf("Testing guest instruction profiling ...\n");
+
+    uint64_t n = 3;
+
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",              // 0
+        "mov    %rsp,%rbp",         // 1
+        "sub    $0x10,%rsp",        // 2
+        "mov    %rdi,-0x8(%rbp)",   // 3
+        "cmpq   $0x0,-0x8(%rbp)",   // 4
+        "jne    0x400200",          // 5: jump to 8
+        "mov    $0x0,%eax",         // 6
+        "jmp    0x400380",          // 7: jump to 14
+        "mov    -0x8(%rbp),%rax",   // 8
+        "sub    $0x1,%rax",         // 9
+        "mov    %rax,%rdi",         // 10
+        "callq  0x00400000",        // 11
+        "mov    -0x8(%rbp),%rdx",   // 12
+        "add    %rdx,%rax",         // 13
+        "leaveq ",                  // 14
+        "retq   ",                  // 15
+        "mov    $0x0,%edi",         // 16: n is written below
+        "callq  0x00400000",        // 17
+        "mov    %rax,-0x8(%rbp)",   // 18
+        "jmp    0x4004c0",          // 19: halt
+    };
+    sprintf(assembly[16], "mov    $0x%lx,%%edi", n);
+
+    // a single process scheduled to itself by the timer
+    // the code page is physical page 1, the stack is mapped on page fault
+    load_program(assembly, 20);
+    cpu_reg.rsp = 0x7ffffffee0f0;
+    cpu_reg.rbp = 0x7ffffffee100;
+    cpu_pc.rip = 0x00400000 + 16 * MAX_INSTRUCTION_CHAR;
+
+    // the interrupt returns into the instruction cycle, not this loop,
+    // so the program halts in a dead loop instead of running out
+    int time = 0;
+    while (cpu_pc.rip != 0x00400000 + 19 * MAX_INSTRUCTION_CHAR &&
+        time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+
+    assert(cpu_reg.rax == n * (n + 1) / 2);
+
+    // the page faults of the stack re-execute the faulting instructions,
+    // so only the instructions not accessing memory are counted exactly
+    assert(profile_read_count(0x00400000 + 9 * MAX_INSTRUCTION_CHAR) == n);
+    assert(profile_read_count(0x00400000 + 10 * MAX_INSTRUCTION_CHAR) == n);
+    assert(profile_read_count(0x00400000 + 6 * MAX_INSTRUCTION_CHAR) == 1);
+    assert(profile_read_count(0x00400000 + 16 * MAX_INSTRUCTION_CHAR) == 1);
+    assert(profile_read_count(0x00400001) == 0);
+
+    profile_report(stdout);
+
+    // the deepest stack: main calls sum(3), sum(3) calls ... sum(0)
+    profile_write_collapsed("./bin/profile.folded");
+    FILE *fr = fopen("./bin/profile.folded", "r");
+    assert(fr != NULL);
+    char line[1024];
+    int deepest = 0;
+    while (fgets(line, sizeof(line), fr) != NULL)
+    {
+        if (strncmp(line, "root;0x400000;0x400000;0x400000;0x400000 ", 41) == 0)
+        {
+            deepest = 1;
+        }
+    }
+    fclose(fr);
+    assert(deepest == 1);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestProfilingSum();
+    return 0;
+}
@@ -0,0 +1,224 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+void page_map_init();
+void pagemap_dirty(uint64_t ppn);
+
+#define NUM_CORES (4)
+
+static void load_sum_program(uint64_t ppn, uint64_t n)
+{
+    char assembly[20][MAX_INSTRUCTION_CHAR] = {
+        "push   %rbp",              // 0
+        "mov    %rsp,%rbp",         // 1
+        "sub    $0x10,%rsp",        // 2
+        "mov    %rdi,-0x8(%rbp)",   // 3
+        "cmpq   $0x0,-0x8(%rbp)",   // 4
+        "jne    0x400200",          // 5: jump to 8
+        "mov    $0x0,%eax",         // 6
+        "jmp    0x400380",          // 7: jump to 14
+        "mov    -0x8(%rbp),%rax",   // 8
+        "sub    $0x1,%rax",         // 9
+        "mov    %rax,%rdi",         // 10
+        "callq  0x00400000",        // 11
+        "mov    -0x8(%rbp),%rdx",   // 12
+        "add    %rdx,%rax",         // 13
+        "leaveq ",                  // 14
+        "retq   ",                  // 15
+        "mov    $0x0,%edi",         // 16: n is written below
+        "callq  0x00400000",        // 17
+        "mov    %rax,-0x8(%rbp)",   // 18
+        "jmp    0x4004c0",          // 19: halt
+    };
+    sprintf(assembly[16], "mov    $0x%lx,%%edi", n);
+
+    for (int i = 0; i < 20; ++ i)
+    {
+        cpu_writeinst_dram(ppn * PAGE_SIZE + i * MAX_INSTRUCTION_CHAR, assembly[i]);
+    }
+}
+
+static void TestSymmetricMultiprocessing()
+{
+    printf("Testing %d cores sharing the physical memory ...\n", NUM_CORES);
+
+    page_map_init();
+    idt_init();
+    syscall_init();
+
+    // one process on each core, scheduled to itself by the core's timer
+    pcb_t pcb[NUM_CORES];
+    page_tables_t *tables = malloc(sizeof(page_tables_t) * NUM_CORES);
+    uint8_t *kstack_buf = malloc(KERNEL_STACK_SIZE * (NUM_CORES + 1));
+    uint64_t kstack_bottom = (((uint64_t)kstack_buf + KERNEL_STACK_SIZE) >> 13) << 13;
+
+    core_t cores[NUM_CORES];
+    memset(&cores, 0, sizeof(core_t) * NUM_CORES);
+    memset(tables, 0, sizeof(page_tables_t) * NUM_CORES);
+
+    address_t code_addr = {.address_value = 0x00400000};
+    for (int i = 0; i < NUM_CORES; ++ i)
+    {
+        memset(&pcb[i], 0, sizeof(pcb_t));
+        pcb[i].pid = i + 1;
+        pcb[i].next = &pcb[i];
+        pcb[i].prev = &pcb[i];
+        pcb[i].mm.pgd = &tables[i].pgd[0];
+
+        // the same virtual address on different physical pages
+        // each core computes a different sum
+        link_page_table(&tables[i].pgd[0], &tables[i].pud[0], &tables[i].pmd[0], &tables[i].pt[0],
+            i + 1, &code_addr);
+        load_sum_program(i + 1, i + 3);
+
+        pcb[i].kstack = (kstack_t *)(kstack_bottom + i * KERNEL_STACK_SIZE);
+        pcb[i].kstack->threadinfo.pcb = &pcb[i];
+
+        cores[i].id = i;
+        cores[i].reg.rsp = 0x7ffffffee0f0;
+        cores[i].reg.rbp = 0x7ffffffee100;
+        cores[i].pc.rip = 0x00400000 + 16 * MAX_INSTRUCTION_CHAR;
+        cores[i].controls.cr3 = pcb[i].mm.pgd_paddr;
+        cores[i].tss.ESP0 = (uint64_t)pcb[i].kstack + KERNEL_STACK_SIZE;
+    }
+
+    smp_run(cores, NUM_CORES, 2000);
+
+    for (uint64_t i = 0; i < NUM_CORES; ++ i)
+    {
+        uint64_t n = i + 3;
+        assert(cores[i].pc.rip == 0x00400000 + 19 * MAX_INSTRUCTION_CHAR);
+        assert(cores[i].reg.rax == n * (n + 1) / 2);
+    }
+
+    free(tables);
+    free(kstack_buf);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void write_program(uint64_t ppn, char (*assembly)[MAX_INSTRUCTION_CHAR], int num)
+{
+    for (int i = 0; i < num; ++ i)
+    {
+        cpu_writeinst_dram(ppn * PAGE_SIZE + i * MAX_INSTRUCTION_CHAR, assembly[i]);
+    }
+    // no swap page for the code, it is allocated when written back
+    pagemap_dirty(ppn);
+}
+
+static void TestTlbShootdown()
+{
+    printf("Testing the pages replaced by one core and cached by the other ...\n");
+
+    memset(pm, 0, PHYSICAL_MEMORY_SPACE);
+    page_map_init();
+    idt_init();
+    syscall_init();
+
+    // The clean pages are replaced first, so a core whose instruction
+    // needs two clean pages replaces them by each other for ever. Both
+    // cores keep their code pages dirty by writing a word in them.
+
+    // core 0 counts in the word of its code page, kept in its TLB
+    char counter[9][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x400800,%rsi",        // 0
+        "mov    $0x4e20,%rcx",          // 1: 20000 times
+        "mov    $0x1,%rdx",             // 2
+        "mov    (%rsi),%rax",           // 3
+        "add    %rdx,%rax",             // 4
+        "mov    %rax,(%rsi)",           // 5
+        "sub    $0x1,%rcx",             // 6
+        "jne    0x4000c0",              // 7: jump to 3
+        "jmp    0x400200",              // 8: halt
+    };
+    // core 1 writes 32 pages in turn by 4 rounds, more than the
+    // physical pages, so its page faults replace the page of core 0
+    char churn[13][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x4,%rbx",             // 0
+        "mov    $0x400800,%rdi",        // 1
+        "mov    $0x7fff00000000,%rsi",  // 2
+        "mov    $0x20,%rcx",            // 3
+        "mov    %rbx,(%rsi)",           // 4
+        "mov    %rbx,(%rdi)",           // 5
+        "lea    0x1000(%rsi),%rsi",     // 6
+        "sub    $0x1,%rcx",             // 7
+        "jne    0x400100",              // 8: jump to 4
+        "sub    $0x1,%rbx",             // 9
+        "jne    0x400080",              // 10: jump to 2
+        "mov    -0x1000(%rsi),%rax",    // 11
+        "jmp    0x400300",              // 12: halt
+    };
+
+    pcb_t pcb[2];
+    page_tables_t *tables = malloc(sizeof(page_tables_t) * 2);
+    uint8_t *kstack_buf = malloc(KERNEL_STACK_SIZE * 3);
+    uint64_t kstack_bottom = (((uint64_t)kstack_buf + KERNEL_STACK_SIZE) >> 13) << 13;
+
+    core_t cores[2];
+    memset(&cores, 0, sizeof(core_t) * 2);
+    memset(tables, 0, sizeof(page_tables_t) * 2);
+
+    address_t code_addr = {.address_value = 0x00400000};
+    for (int i = 0; i < 2; ++ i)
+    {
+        memset(&pcb[i], 0, sizeof(pcb_t));
+        pcb[i].pid = i + 1;
+        pcb[i].next = &pcb[i];
+        pcb[i].prev = &pcb[i];
+        pcb[i].mm.pgd = &tables[i].pgd[0];
+        link_page_table(&tables[i].pgd[0], &tables[i].pud[0], &tables[i].pmd[0], &tables[i].pt[0],
+            i + 1, &code_addr);
+
+        pcb[i].kstack = (kstack_t *)(kstack_bottom + i * KERNEL_STACK_SIZE);
+        pcb[i].kstack->threadinfo.pcb = &pcb[i];
+
+        cores[i].id = i;
+        cores[i].pc.rip = 0x00400000;
+        cores[i].controls.cr3 = pcb[i].mm.pgd_paddr;
+        cores[i].tss.ESP0 = (uint64_t)pcb[i].kstack + KERNEL_STACK_SIZE;
+    }
+    write_program(1, counter, 9);
+    write_program(2, churn, 13);
+
+    smp_run(cores, 2, 200000);
+
+    // without the shootdown, core 0 goes on running and counting in
+    // the physical page given to core 1 by its stale TLB line
+    assert(cores[0].pc.rip == 0x00400200);
+    assert(cores[0].reg.rax == 20000);
+    assert(cores[1].pc.rip == 0x00400300);
+    assert(cores[1].reg.rax == 1);
+
+    free(tables);
+    free(kstack_buf);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestSymmetricMultiprocessing();
+    TestTlbShootdown();
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+// read the data in the address space of process k
+static uint64_t read_guest(int k, uint64_t vaddr)
+{
+    cpu_controls.cr3 = fixture_pcb[k].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[k].mm.asid;
+    tlb_flush_all();
+    return cpu_read64bits_dram(va2pa(vaddr));
+}
+
+static void TestSwapping()
+{
+    printf("Testing softmmu with pages swapped out and in ...\n");
+
+    // 24 data pages are more than the physical memory,
+    // so the pages cached by softmmu are unmapped and reused
+    char assembly[16][2][MAX_INSTRUCTION_CHAR] = {
+        {"mov    $0x7fffffe00000,%rdi"},    // 0
+        {"mov    $0x18,%rcx"},              // 1: 24 pages
+        {"mov    $0x1000,%rdx"},            // 2
+        {"mov    %rcx,(%rdi)"},             // 3: write loop
+        {"add    %rdx,%rdi"},               // 4
+        {"sub    $0x1,%rcx"},               // 5
+        {"jne    0x4000c0"},                // 6
+        {"mov    $0x7fffffe00000,%rdi"},    // 7
+        {"mov    $0x18,%rcx"},              // 8
+        {"mov    $0x0,%rbx"},               // 9
+        {"mov    (%rdi),%rax"},             // 10: read loop
+        {"add    %rax,%rbx"},               // 11
+        {"add    %rdx,%rdi"},               // 12
+        {"sub    $0x1,%rcx"},               // 13
+        {"jne    0x400280"},                // 14
+        {"jmp    0x4003c0"},                // 15: halt
+    };
+    load_processes(assembly, 16, 1);
+
+    int time = 0;
+    while (cpu_pc.rip != 0x004003c0 && time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+
+    assert(cpu_pc.rip == 0x004003c0);
+    assert(cpu_reg.rcx == 0);
+    // 24 + 23 + ... + 1, read back from the swapped pages
+    assert(cpu_reg.rbx == 300);
+    // the last page is the most recently used, never swapped out
+    assert(read_guest(0, 0x7fffffe00000 + 0x17 * 0x1000) == 1);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestAddressSpaces()
+{
+    printf("Testing softmmu with context switching ...\n");
+
+    // both processes add to the counter at the same virtual address,
+    // which must be translated in the address space of each process
+    char assembly[6][2][MAX_INSTRUCTION_CHAR] = {
+        {"mov    $0x7fffffe00000,%rdi",   "mov    $0x7fffffe00000,%rdi"},
+        {"mov    $0x1,%rbx",              "mov    $0x10000,%rbx"},
+        {"mov    (%rdi),%rax",            "mov    (%rdi),%rax"},      // 2: loop
+        {"add    %rbx,%rax",              "add    %rbx,%rax"},
+        {"mov    %rax,(%rdi)",            "mov    %rax,(%rdi)"},
+        {"jmp    0x400080",               "jmp    0x400080"},
+    };
+    load_processes(assembly, 6, 2);
+
+    for (int time = 0; time < 2000; ++ time)
+    {
+        instruction_cycle();
+    }
+
+    uint64_t counter1 = read_guest(0, 0x7fffffe00000);
+    uint64_t counter2 = read_guest(1, 0x7fffffe00000);
+    assert(0 < counter1 && counter1 < 0x10000);
+    assert(0 < counter2 && (counter2 & 0xffff) == 0);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestSwapping();
+    TestAddressSpaces();
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+// read one byte of guest memory, through SRAM cache if it is on
+static uint8_t read_guest_byte(uint64_t vaddr)
+{
+    uint64_t paddr = va2pa(vaddr);
+    return (cpu_read64bits_dram(paddr & ~0x7ul) >> ((paddr & 0x7) * 8)) & 0xff;
+}
+
+static void TestRepeatedStringOperations()
+{
+    printf("Testing rep stos and rep movs across pages ...\n");
+
+    // the unaligned strings cross the page boundaries, the data pages are
+    // mapped on page fault during the string operations, and the timer
+    // interrupts in between
+    char assembly[14][MAX_INSTRUCTION_CHAR] = {
+        "mov    $0x7ffffffe0f04,%rdi",      // 0
+        "mov    $0x40,%rcx",                // 1
+        "mov    $0x1122334455667788,%rax",  // 2
+        "rep    stosq",                     // 3: 512 bytes at 0x..0f04
+        "mov    $0x7ffffffe0f04,%rsi",      // 4
+        "mov    $0x7ffffffe2ffb,%rdi",      // 5
+        "mov    $0x40,%rcx",                // 6
+        "rep    movsq",                     // 7: copy to 0x..2ffb
+        "mov    $0x7ffffffe2ffb,%rsi",      // 8
+        "mov    $0x7ffffffe2ffc,%rdi",      // 9
+        "mov    $0x10,%rcx",                // 10
+        "rep movsb",                        // 11: overlapping by 1 byte
+        "jmp    0x400300",                  // 12: halt
+        "jmp    0x400300",                  // 13
+    };
+
+    load_program(assembly, 14);
+
+    int time = 0;
+    while (cpu_pc.rip != 0x00400000 + 12 * MAX_INSTRUCTION_CHAR &&
+        time < 100)
+    {
+        instruction_cycle();
+        time ++;
+    }
+    assert(cpu_pc.rip == 0x00400000 + 12 * MAX_INSTRUCTION_CHAR);
+
+    assert(cpu_reg.rcx == 0);
+    assert(cpu_reg.rsi == 0x7ffffffe2ffb + 0x10);
+    assert(cpu_reg.rdi == 0x7ffffffe2ffc + 0x10);
+
+    uint64_t pattern = 0x1122334455667788;
+    for (uint64_t i = 0; i < 0x40 * 8; ++ i)
+    {
+        uint8_t expected = (pattern >> ((i % 8) * 8)) & 0xff;
+        assert(read_guest_byte(0x7ffffffe0f04 + i) == expected);
+
+        // the first byte is repeated by the overlapping move
+        if (i <= 0x10)
+        {
+            expected = pattern & 0xff;
+        }
+        assert(read_guest_byte(0x7ffffffe2ffb + i) == expected);
+    }
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+int main()
+{
+    TestRepeatedStringOperations();
+    return 0;
+}
@@ -0,0 +1,371 @@
+/* BCST - Introduction to Computer Systems
+ * Author:      yangminz@outlook.com
+ * Github:      https://github.com/yangminz/bcst_csapp
+ * Bilibili:    https://space.bilibili.com/4564101
+ * Zhihu:       https://www.zhihu.com/people/zhao-yang-min
+ * This project (code repository and videos) is exclusively owned by yangminz
+ * and shall not be used for commercial and profitting purpose
+ * without yangminz's permission.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headers/cpu.h"
+#include "headers/memory.h"
+#include "headers/common.h"
+#include "headers/address.h"
+#include "headers/instruction.h"
+#include "headers/interrupt.h"
+#include "headers/process.h"
+#include "tests/fixture.h"
+
+void map_pte4(pte4_t *pte, uint64_t ppn);
+
+static void TestAsidTagging()
+{
+    printf("Testing TLB lines tagged by ASID ...\n");
+
+    char assembly[1][2][MAX_INSTRUCTION_CHAR] = {
+        {"jmp    0x400000", "jmp    0x400000"},
+    };
+    load_processes(assembly, 1, 2);
+    address_t code_addr = {.address_value = 0x00400000};
+
+    // both translations are cached
+    assert(va2pa(0x00400008) == 0x1008);
+    cpu_controls.cr3 = fixture_pcb[1].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[1].mm.asid;
+    assert(va2pa(0x00400008) == 0x2008);
+
+    // change the mappings without invalidation
+    fixture_tables[0].pt[code_addr.vpn4].ppn = 3;
+    fixture_tables[1].pt[code_addr.vpn4].ppn = 4;
+
+    cpu_controls.cr3 = fixture_pcb[0].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[0].mm.asid;
+    assert(va2pa(0x00400008) == 0x1008);
+    tlb_invalidate_page(1, 0x00400000);
+    assert(va2pa(0x00400008) == 0x3008);
+
+    cpu_controls.cr3 = fixture_pcb[1].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[1].mm.asid;
+    assert(va2pa(0x00400008) == 0x2008);
+    tlb_invalidate_asid(2);
+    assert(va2pa(0x00400008) == 0x4008);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+// run until process k is scheduled
+static void run_until_scheduled(int k)
+{
+    uint64_t top = (uint64_t)fixture_pcb[k].kstack + KERNEL_STACK_SIZE;
+    int time = 0;
+    while (tr_global_tss.ESP0 != top && time < 100)
+    {
+        instruction_cycle();
+        time ++;
+    }
+    assert(tr_global_tss.ESP0 == top);
+}
+
+static void TestAsidSwitching()
+{
+    printf("Testing TLB lines kept on switching processes ...\n");
+
+    char assembly[1][2][MAX_INSTRUCTION_CHAR] = {
+        {"jmp    0x400000", "jmp    0x400000"},
+    };
+    load_processes(assembly, 1, 2);
+    address_t code_addr = {.address_value = 0x00400000};
+    assert(fixture_pcb[0].mm.asid != 0 && fixture_pcb[1].mm.asid != 0 && fixture_pcb[0].mm.asid != fixture_pcb[1].mm.asid);
+
+    // both processes fetch the code through TLB
+    run_until_scheduled(1);
+    run_until_scheduled(0);
+
+    // change the mapping of p1 without invalidation
+    strcpy((char *)&pm[3 * PAGE_SIZE + code_addr.vpo], assembly[0][0]);
+    fixture_tables[0].pt[code_addr.vpn4].ppn = 3;
+
+    // p1 is switched out and in by the timer, its line is kept
+    run_until_scheduled(1);
+    run_until_scheduled(0);
+    assert(va2pa(0x00400008) == 0x1008);
+
+    // the ASIDs are recycled on wrapping, until p2 gets the ASID of p1
+    do
+    {
+        allocate_asid(&fixture_pcb[1]);
+    } while (fixture_pcb[1].mm.asid != fixture_pcb[0].mm.asid);
+    assert(va2pa(0x00400008) == 0x3008);
+
+    // the lines of the shared ASID are flushed on switching
+    run_until_scheduled(1);
+    assert(va2pa(0x00400008) == 0x2008);
+    run_until_scheduled(0);
+    assert(va2pa(0x00400008) == 0x3008);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestSwappingBetweenAsids()
+{
+    printf("Testing TLB invalidation on swapping the pages of processes ...\n");
+
+    // p1 writes 14 pages and p2 writes 2 pages, then they sum them up,
+    // the victims of the page faults are cached in TLB by both ASIDs
+    char assembly[17][2][MAX_INSTRUCTION_CHAR] = {
+        {"mov    $0x7fffffe00000,%rdi",   "mov    $0x7fffffe00000,%rdi"},
+        {"mov    $0xe,%rcx",              "mov    $0x2,%rcx"},
+        {"mov    $0x1000,%rdx",           "mov    $0x1000,%rdx"},
+        {"mov    $0x0,%rbx",              "mov    $0x10000,%rbx"},
+        {"mov    %rcx,(%rdi)",            "mov    %rbx,(%rdi)"},          // 4: write loop
+        {"add    %rdx,%rdi",              "add    %rdx,%rdi"},
+        {"sub    $0x1,%rcx",              "sub    $0x1,%rcx"},
+        {"jne    0x400100",               "jne    0x400100"},
+        {"mov    $0x7fffffe00000,%rdi",   "mov    $0x7fffffe00000,%rdi"},
+        {"mov    $0xe,%rcx",              "mov    $0x2,%rcx"},
+        {"mov    $0x0,%rax",              "mov    $0x0,%rax"},
+        {"mov    (%rdi),%rsi",            "mov    (%rdi),%rsi"},          // 11: read loop
+        {"add    %rsi,%rax",              "add    %rsi,%rax"},
+        {"add    %rdx,%rdi",              "add    %rdx,%rdi"},
+        {"sub    $0x1,%rcx",              "sub    $0x1,%rcx"},
+        {"jne    0x4002c0",               "jne    0x4002c0"},
+        {"jmp    0x400400",               "jmp    0x400400"},             // 16: halt
+    };
+    load_processes(assembly, 17, 2);
+
+    int time = 0;
+    while ((user_rip(0) != 0x00400400 || user_rip(1) != 0x00400400) && time < 10000)
+    {
+        instruction_cycle();
+        time ++;
+    }
+
+    assert(user_rip(0) == 0x00400400 && user_rip(1) == 0x00400400);
+    // 14 + 13 + ... + 1
+    assert(user_reg(0)->rax == 105);
+    assert(user_reg(1)->rax == 0x20000);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+static void TestReferenceAndDirtyBits()
+{
+    printf("Testing reference and dirty bits set by MMU ...\n");
+
+    char assembly[1][2][MAX_INSTRUCTION_CHAR] = {
+        {"jmp    0x400000", "jmp    0x400000"},
+    };
+    load_processes(assembly, 1, 2);
+    address_t code_addr = {.address_value = 0x00400000};
+    pte4_t *pte = &fixture_tables[0].pt[code_addr.vpn4 + 1];
+    map_pte4(pte, 3);
+    assert(pte->reference == 0 && pte->dirty == 0);
+
+    // the TLB fill sets the reference bit
+    assert(va2pa(0x00401008) == 0x3008);
+    assert(pte->reference == 1 && pte->dirty == 0);
+
+    // the TLB hit does not walk
+    pte->reference = 0;
+    assert(va2pa(0x00401010) == 0x3010);
+    assert(pte->reference == 0);
+
+    // the first write through the clean line sets the dirty bit
+    assert(va2pa_write(0x00401008) == 0x3008);
+    assert(pte->reference == 1 && pte->dirty == 1);
+
+    // but not the later writes
+    pte->dirty = 0;
+    assert(va2pa_write(0x00401010) == 0x3010);
+    assert(pte->dirty == 0);
+
+    // the OS clears the bits with the TLB line
+    pte->reference = 0;
+    tlb_invalidate_page(1, 0x00401000);
+    assert(va2pa_write(0x00401008) == 0x3008);
+    assert(pte->reference == 1 && pte->dirty == 1);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+
+#ifdef USE_PAGE_WALK_CACHE
+static void TestPageWalkCache()
+{
+    printf("Testing paging-structure cache on TLB misses ...\n");
+
+    char assembly[1][2][MAX_INSTRUCTION_CHAR] = {
+        {"jmp    0x400000", "jmp    0x400000"},
+    };
+    load_processes(assembly, 1, 2);
+    address_t code_addr = {.address_value = 0x00400000};
+    map_pte4(&fixture_tables[0].pt[code_addr.vpn4 + 1], 3);
+    map_pte4(&fixture_tables[0].pt[code_addr.vpn4 + 2], 4);
+
+    page_walk_stat_t stat, last;
+    page_walk_read_stat(&last);
+
+    // the full walk fills the caches of PGD, PUD and PMD
+    assert(va2pa(0x00400008) == 0x1008);
+    page_walk_read_stat(&stat);
+    assert(stat.walks == last.walks + 1);
+    assert(stat.table_reads == last.table_reads + 4);
+
+    // the next page in the 2MB only reads the PT
+    last = stat;
+    assert(va2pa(0x00401008) == 0x3008);
+    page_walk_read_stat(&stat);
+    assert(stat.hits[2] == last.hits[2] + 1);
+    assert(stat.table_reads == last.table_reads + 1);
+
+    // replace the PT without invalidation, the cached PMD entry is stale
+    static pte4_t new_pt[512];
+    memset(&new_pt, 0, sizeof(new_pt));
+    map_pte4(&new_pt[code_addr.vpn4 + 2], 5);
+    fixture_tables[0].pmd[code_addr.vpn3].paddr = (uint64_t)&new_pt[0];
+
+    assert(va2pa(0x00402008) == 0x4008);
+    tlb_invalidate_page(1, 0x00402000);
+    assert(va2pa(0x00402008) == 0x5008);
+
+    // the lines are tagged by ASID
+    page_walk_read_stat(&last);
+    cpu_controls.cr3 = fixture_pcb[1].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[1].mm.asid;
+    assert(va2pa(0x00400008) == 0x2008);
+    page_walk_read_stat(&stat);
+    assert(stat.hits[0] == last.hits[0] && stat.hits[1] == last.hits[1] && stat.hits[2] == last.hits[2]);
+    assert(stat.table_reads == last.table_reads + 4);
+
+    // flushed with TLB
+    cpu_controls.cr3 = fixture_pcb[0].mm.pgd_paddr;
+    cpu_controls.asid = fixture_pcb[0].mm.asid;
+    tlb_flush_all();
+    page_walk_read_stat(&last);
+    assert(va2pa(0x00402008) == 0x5008);
+    page_walk_read_stat(&stat);
+    assert(stat.table_reads == last.table_reads + 4);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+#endif
+
+#ifdef USE_TLB_HIERARCHY
+static void TestTlbHierarchy()
+{
+    printf("Testing iTLB, dTLB and STLB ...\n");
+
+    char assembly[1][2][MAX_INSTRUCTION_CHAR] = {
+        {"jmp    0x400000", "jmp    0x400000"},
+    };
+    load_processes(assembly, 1, 2);
+    address_t code_addr = {.address_value = 0x00400000};
+    // page k of 0x400000 in ppn k + 3
+    for (int k = 1; k < 5; ++ k)
+    {
+        map_pte4(&fixture_tables[0].pt[code_addr.vpn4 + k], k + 3);
+    }
+
+    tlb_config_t config = {
+        .itlb = {.num_sets = 1, .num_ways = 2, .replacement = TLB_LRU},
+        .dtlb = {.num_sets = 1, .num_ways = 2, .replacement = TLB_LRU},
+        .stlb = {.num_sets = 2, .num_ways = 2, .replacement = TLB_LRU},
+    };
+    tlb_configure(&config);
+    tlb_stat_t stat;
+
+    // the walk fills iTLB and STLB, the data access refills dTLB from STLB
+    assert(va2pa_fetch(0x00400008) == 0x1008);
+    assert(va2pa(0x00400010) == 0x1010);
+    assert(va2pa(0x00400018) == 0x1018);
+    assert(va2pa_fetch(0x00400020) == 0x1020);
+    tlb_read_stat(&stat);
+    assert(stat.itlb.miss == 1 && stat.itlb.hit == 1);
+    assert(stat.dtlb.miss == 1 && stat.dtlb.hit == 1);
+    assert(stat.stlb.miss == 1 && stat.stlb.hit == 1);
+
+    // all the levels are invalidated
+    fixture_tables[0].pt[code_addr.vpn4].ppn = 3;
+    tlb_invalidate_page(1, 0x00400000);
+    assert(va2pa(0x00400008) == 0x3008);
+    assert(va2pa_fetch(0x00400008) == 0x3008);
+
+    // 4 ways of dTLB without STLB: fill A, B, C, D, then use A and fill E
+    // the changed mappings are stale only if the lines are not evicted,
+    // the hit is checked before the miss, which fills and evicts again
+    tlb_replacement_t policies[2] = {TLB_LRU, TLB_PLRU};
+    for (int i = 0; i < 2; ++ i)
+    {
+        config.dtlb.num_ways = 4;
+        config.dtlb.replacement = policies[i];
+        config.stlb.num_sets = 0;
+        tlb_configure(&config);
+        fixture_tables[0].pt[code_addr.vpn4 + 1].ppn = 4;
+        fixture_tables[0].pt[code_addr.vpn4 + 2].ppn = 5;
+
+        for (int k = 0; k < 4; ++ k)
+        {
+            va2pa(0x00400000 + k * PAGE_SIZE);
+        }
+        va2pa(0x00400000);
+        va2pa(0x00404000);
+        tlb_read_stat(&stat);
+        assert(stat.dtlb.miss == 5 && stat.dtlb.hit == 1 && stat.dtlb.eviction == 1);
+
+        fixture_tables[0].pt[code_addr.vpn4 + 1].ppn = 8;
+        fixture_tables[0].pt[code_addr.vpn4 + 2].ppn = 9;
+        if (policies[i] == TLB_LRU)
+        {
+            // B is the least recently used
+            assert(va2pa(0x00402008) == 0x5008);
+            assert(va2pa(0x00401008) == 0x8008);
+        }
+        else
+        {
+            // the tree points to C, away from A and D
+            assert(va2pa(0x00401008) == 0x4008);
+            assert(va2pa(0x00402008) == 0x9008);
+        }
+    }
+
+    // ASID 0 is an address space as the others, not the global flush
+    config.dtlb.num_sets = 4;
+    config.dtlb.num_ways = 1;
+    tlb_configure(&config);
+    for (int k = 0; k < 4; ++ k)
+    {
+        fixture_tables[0].pt[code_addr.vpn4 + k].ppn = k + 3;
+        va2pa(0x00400000 + k * PAGE_SIZE);
+        fixture_tables[0].pt[code_addr.vpn4 + k].ppn = k + 8;
+    }
+    tlb_invalidate_asid(0);
+    assert(va2pa(0x00400008) == 0x3008);
+    // the page is invalidated in its own set only
+    tlb_invalidate_page(1, 0x00402000);
+    assert(va2pa(0x00401008) == 0x4008);
+    assert(va2pa(0x00402008) == 0xa008);
+    tlb_flush_all();
+    assert(va2pa(0x00403008) == 0xb008);
+
+    printf("\033[32;1m\tPass\033[0m\n");
+}
+#endif
+
+int main()
+{
+    TestAsidTagging();
+    TestAsidSwitching();
+    TestSwappingBetweenAsids();
+    TestReferenceAndDirtyBits();
+#ifdef USE_PAGE_WALK_CACHE
+    TestPageWalkCache();
+#endif
+#ifdef USE_TLB_HIERARCHY
+    TestTlbHierarchy();
+#endif
+    return 0;
+}